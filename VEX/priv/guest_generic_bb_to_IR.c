@@ -1276,6 +1276,7 @@ IRSB* bb_to_IR (
          /*IN*/ const UChar*     guest_code,
          /*IN*/ Addr             guest_IP_sbstart,
          /*IN*/ Bool             (*chase_into_ok)(void*,Addr),
+         /*IN*/ Int              (*guess_hot_successor)(void*,Addr,Addr),
          /*IN*/ VexEndness       host_endness,
          /*IN*/ Bool             sigill_diag,
          /*IN*/ VexArch          arch_guest,
@@ -1663,8 +1664,67 @@ IRSB* bb_to_IR (
             update_instr_budget(&instrs_avail, &verbose_mode,
                                 sx_instrs_used, sx_verbose_seen);
             *n_cond_in_trace += 1;
+            break;
          }
-         break;
+
+         // Not an &&-idiom.  If the client knows which way the branch
+         // usually goes, keep extending along that path, leaving the other
+         // one as a side exit.
+         Int hot = -1;
+         if (guess_hot_successor) {
+            hot = guess_hot_successor(
+                     callback_opaque,
+                     (Addr)((Long)guest_IP_sbstart + irsb_be.Be.Cond.deltaSX),
+                     (Addr)((Long)guest_IP_sbstart + irsb_be.Be.Cond.deltaFT));
+         }
+         if (hot != 0 && hot != 1)
+            break;
+         if (irsb_be.Be.Cond.deltaSX == irsb_be.Be.Cond.deltaFT)
+            break;
+         // As for any other chase, the client may not want the hot
+         // successor to be part of this trace.
+         if (!chase_into_ok(callback_opaque,
+                            (Addr)((Long)guest_IP_sbstart
+                                   + (hot == 1 ? irsb_be.Be.Cond.deltaSX
+                                               : irsb_be.Be.Cond.deltaFT))))
+            break;
+
+         // Arrange for the hot successor to be the fall through.
+         if (hot == 1)
+            swap_sx_and_ft(irsb, &irsb_be);
+
+         if (debug_print) {
+            vex_printf("\n-+-+ Hot follow (ext# %d) to 0x%llx -+-+\n\n",
+                       (Int)vge->n_used,
+                       (ULong)((Long)guest_IP_sbstart+ irsb_be.Be.Cond.deltaFT));
+         }
+         Int    hf_instrs_used  = 0;
+         Bool   hf_verbose_seen = False;
+         Addr   hf_base         = 0;
+         UShort hf_len          = 0;
+         IRSB*  hf_bb
+            = disassemble_basic_block_till_stop(
+                 /*OUT*/ &hf_instrs_used, &hf_verbose_seen, &hf_base, &hf_len,
+                 /*MOD*/ emptyIRSB(),
+                 /*IN*/  irsb_be.Be.Cond.deltaFT,
+                 instrs_avail, guest_IP_sbstart, host_endness,
+                 /*sigill_diag=*/False, // See comment above
+                 arch_guest, archinfo_guest, abiinfo_both, guest_word_type,
+                 debug_print, dis_instr_fn, guest_code, offB_GUEST_IP
+              );
+         vassert(hf_instrs_used <= instrs_avail);
+
+         /* The Exit at the end of 'irsb' now goes to the cold successor, and
+            'irsb->next' is the hot one, so appending 'hf_bb' is just as for
+            the unconditional case. */
+         concatenate_irsbs(irsb, hf_bb);
+
+         // Update instrs_used, extents, budget.
+         instrs_used += hf_instrs_used;
+         add_extent(vge, hf_base, hf_len);
+         update_instr_budget(&instrs_avail, &verbose_mode,
+                             hf_instrs_used, hf_verbose_seen);
+         *n_cond_in_trace += 1;
       } // if (be.tag == Be_Cond)
 
       // We don't know any other way to extend the block.  Give up.
@@ -588,6 +588,17 @@ const HChar* showAMD64SseOp ( AMD64SseOp op ) {
       case Asse_UNPCKLQ:  return "punpcklq";
       case Asse_PSHUFB:   return "pshufb";
       case Asse_PMADDUBSW: return "pmaddubsw";
+      case Asse_MUL32:    return "pmulld";
+      case Asse_MAX32S:   return "pmaxsd";
+      case Asse_MAX32U:   return "pmaxud";
+      case Asse_MAX16U:   return "pmaxuw";
+      case Asse_MAX8S:    return "pmaxsb";
+      case Asse_MIN32S:   return "pminsd";
+      case Asse_MIN32U:   return "pminud";
+      case Asse_MIN16U:   return "pminuw";
+      case Asse_MIN8S:    return "pminsb";
+      case Asse_CMPEQ64:  return "pcmpeqq";
+      case Asse_CMPGT64S: return "pcmpgtq";
       case Asse_F32toF16: return "vcvtps2ph(rm_field=$0x4).";
       case Asse_F16toF32: return "vcvtph2ps.";
       default: vpanic("showAMD64SseOp");
@@ -3962,6 +3973,28 @@ Int emit_AMD64Instr ( /*MB_MOD*/Bool* is_profInc,
                              XX(0x0F); XX(0x38); XX(0x00); break;
          case Asse_PMADDUBSW:XX(0x66); XX(rex);
                              XX(0x0F); XX(0x38); XX(0x04); break;
+         case Asse_MUL32:    XX(0x66); XX(rex);
+                             XX(0x0F); XX(0x38); XX(0x40); break;
+         case Asse_MAX32S:   XX(0x66); XX(rex);
+                             XX(0x0F); XX(0x38); XX(0x3D); break;
+         case Asse_MAX32U:   XX(0x66); XX(rex);
+                             XX(0x0F); XX(0x38); XX(0x3F); break;
+         case Asse_MAX16U:   XX(0x66); XX(rex);
+                             XX(0x0F); XX(0x38); XX(0x3E); break;
+         case Asse_MAX8S:    XX(0x66); XX(rex);
+                             XX(0x0F); XX(0x38); XX(0x3C); break;
+         case Asse_MIN32S:   XX(0x66); XX(rex);
+                             XX(0x0F); XX(0x38); XX(0x39); break;
+         case Asse_MIN32U:   XX(0x66); XX(rex);
+                             XX(0x0F); XX(0x38); XX(0x3B); break;
+         case Asse_MIN16U:   XX(0x66); XX(rex);
+                             XX(0x0F); XX(0x38); XX(0x3A); break;
+         case Asse_MIN8S:    XX(0x66); XX(rex);
+                             XX(0x0F); XX(0x38); XX(0x38); break;
+         case Asse_CMPEQ64:  XX(0x66); XX(rex);
+                             XX(0x0F); XX(0x38); XX(0x29); break;
+         case Asse_CMPGT64S: XX(0x66); XX(rex);
+                             XX(0x0F); XX(0x38); XX(0x37); break;
          default: goto bad;
       }
       p = doAMode_R_enc_enc(p, vregEnc3210(i->Ain.SseReRg.dst),
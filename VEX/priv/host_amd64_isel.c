@@ -3368,7 +3368,12 @@ static HReg iselVecExpr_wrk ( ISelEnv* env, const IRExpr* e )
       }
 
       case Iop_CmpNEZ64x2: {
-         /* We can use SSE2 instructions for this. */
+         /* With SSE4.1 (implied by AVX) there is a 64Ix2 comparison. */
+         if (env->hwcaps & VEX_HWCAPS_AMD64_AVX) {
+            op = Asse_CMPEQ64;
+            goto do_CmpNEZ_vector;
+         }
+         /* Otherwise we can use SSE2 instructions for this. */
          /* Ideally, we want to do a 64Ix2 comparison against zero of
             the operand.  Problem is no such insn exists.  Solution
             therefore is to do a 32Ix4 comparison instead, and bitwise-
@@ -3757,28 +3762,46 @@ static HReg iselVecExpr_wrk ( ISelEnv* env, const IRExpr* e )
          return dst;
       }
 
-      case Iop_Mul32x4:    fn = (HWord)h_generic_calc_Mul32x4;
-                           goto do_SseAssistedBinary;
-      case Iop_Max32Sx4:   fn = (HWord)h_generic_calc_Max32Sx4;
-                           goto do_SseAssistedBinary;
-      case Iop_Min32Sx4:   fn = (HWord)h_generic_calc_Min32Sx4;
-                           goto do_SseAssistedBinary;
-      case Iop_Max32Ux4:   fn = (HWord)h_generic_calc_Max32Ux4;
-                           goto do_SseAssistedBinary;
-      case Iop_Min32Ux4:   fn = (HWord)h_generic_calc_Min32Ux4;
-                           goto do_SseAssistedBinary;
-      case Iop_Max16Ux8:   fn = (HWord)h_generic_calc_Max16Ux8;
-                           goto do_SseAssistedBinary;
-      case Iop_Min16Ux8:   fn = (HWord)h_generic_calc_Min16Ux8;
-                           goto do_SseAssistedBinary;
-      case Iop_Max8Sx16:   fn = (HWord)h_generic_calc_Max8Sx16;
-                           goto do_SseAssistedBinary;
-      case Iop_Min8Sx16:   fn = (HWord)h_generic_calc_Min8Sx16;
-                           goto do_SseAssistedBinary;
-      case Iop_CmpEQ64x2:  fn = (HWord)h_generic_calc_CmpEQ64x2;
-                           goto do_SseAssistedBinary;
-      case Iop_CmpGT64Sx2: fn = (HWord)h_generic_calc_CmpGT64Sx2;
-                           goto do_SseAssistedBinary;
+      /* These need SSE4.1 or SSE4.2, which every AVX capable host has.
+         Otherwise use the helpers. */
+      case Iop_Mul32x4:    op = Asse_MUL32;
+                           fn = (HWord)h_generic_calc_Mul32x4;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Max32Sx4:   op = Asse_MAX32S;
+                           fn = (HWord)h_generic_calc_Max32Sx4;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Min32Sx4:   op = Asse_MIN32S;
+                           fn = (HWord)h_generic_calc_Min32Sx4;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Max32Ux4:   op = Asse_MAX32U;
+                           fn = (HWord)h_generic_calc_Max32Ux4;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Min32Ux4:   op = Asse_MIN32U;
+                           fn = (HWord)h_generic_calc_Min32Ux4;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Max16Ux8:   op = Asse_MAX16U;
+                           fn = (HWord)h_generic_calc_Max16Ux8;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Min16Ux8:   op = Asse_MIN16U;
+                           fn = (HWord)h_generic_calc_Min16Ux8;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Max8Sx16:   op = Asse_MAX8S;
+                           fn = (HWord)h_generic_calc_Max8Sx16;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Min8Sx16:   op = Asse_MIN8S;
+                           fn = (HWord)h_generic_calc_Min8Sx16;
+                           goto do_Sse4_or_Assisted;
+      case Iop_CmpEQ64x2:  op = Asse_CMPEQ64;
+                           fn = (HWord)h_generic_calc_CmpEQ64x2;
+                           goto do_Sse4_or_Assisted;
+      case Iop_CmpGT64Sx2: op = Asse_CMPGT64S;
+                           fn = (HWord)h_generic_calc_CmpGT64Sx2;
+                           goto do_Sse4_or_Assisted;
+      do_Sse4_or_Assisted:
+         if (env->hwcaps & VEX_HWCAPS_AMD64_AVX)
+            goto do_SseReRg;
+         goto do_SseAssistedBinary;
+
       case Iop_Perm32x4:   fn = (HWord)h_generic_calc_Perm32x4;
                            goto do_SseAssistedBinary;
       case Iop_QNarrowBin32Sto16Ux8:
@@ -4116,7 +4139,12 @@ static void iselDVecExpr_wrk ( /*OUT*/HReg* rHi, /*OUT*/HReg* rLo,
       }
 
       case Iop_CmpNEZ64x4: {
-         /* We can use SSE2 instructions for this. */
+         /* With SSE4.1 (implied by AVX) there is a 64Ix2 comparison. */
+         if (env->hwcaps & VEX_HWCAPS_AMD64_AVX) {
+            op = Asse_CMPEQ64;
+            goto do_CmpNEZ_vector;
+         }
+         /* Otherwise we can use SSE2 instructions for this. */
          /* Same scheme as Iop_CmpNEZ64x2, except twice as wide
             (obviously).  See comment on Iop_CmpNEZ64x2 for
             explanation of what's going on here. */
@@ -4329,28 +4357,45 @@ static void iselDVecExpr_wrk ( /*OUT*/HReg* rHi, /*OUT*/HReg* rLo,
          return;
       }
 
-      case Iop_Mul32x8:    fn = (HWord)h_generic_calc_Mul32x4;
-                           goto do_SseAssistedBinary;
-      case Iop_Max32Sx8:   fn = (HWord)h_generic_calc_Max32Sx4;
-                           goto do_SseAssistedBinary;
-      case Iop_Min32Sx8:   fn = (HWord)h_generic_calc_Min32Sx4;
-                           goto do_SseAssistedBinary;
-      case Iop_Max32Ux8:   fn = (HWord)h_generic_calc_Max32Ux4;
-                           goto do_SseAssistedBinary;
-      case Iop_Min32Ux8:   fn = (HWord)h_generic_calc_Min32Ux4;
-                           goto do_SseAssistedBinary;
-      case Iop_Max16Ux16:  fn = (HWord)h_generic_calc_Max16Ux8;
-                           goto do_SseAssistedBinary;
-      case Iop_Min16Ux16:  fn = (HWord)h_generic_calc_Min16Ux8;
-                           goto do_SseAssistedBinary;
-      case Iop_Max8Sx32:   fn = (HWord)h_generic_calc_Max8Sx16;
-                           goto do_SseAssistedBinary;
-      case Iop_Min8Sx32:   fn = (HWord)h_generic_calc_Min8Sx16;
-                           goto do_SseAssistedBinary;
-      case Iop_CmpEQ64x4:  fn = (HWord)h_generic_calc_CmpEQ64x2;
-                           goto do_SseAssistedBinary;
-      case Iop_CmpGT64Sx4: fn = (HWord)h_generic_calc_CmpGT64Sx2;
-                           goto do_SseAssistedBinary;
+      /* As for the 128-bit versions. */
+      case Iop_Mul32x8:    op = Asse_MUL32;
+                           fn = (HWord)h_generic_calc_Mul32x4;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Max32Sx8:   op = Asse_MAX32S;
+                           fn = (HWord)h_generic_calc_Max32Sx4;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Min32Sx8:   op = Asse_MIN32S;
+                           fn = (HWord)h_generic_calc_Min32Sx4;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Max32Ux8:   op = Asse_MAX32U;
+                           fn = (HWord)h_generic_calc_Max32Ux4;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Min32Ux8:   op = Asse_MIN32U;
+                           fn = (HWord)h_generic_calc_Min32Ux4;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Max16Ux16:  op = Asse_MAX16U;
+                           fn = (HWord)h_generic_calc_Max16Ux8;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Min16Ux16:  op = Asse_MIN16U;
+                           fn = (HWord)h_generic_calc_Min16Ux8;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Max8Sx32:   op = Asse_MAX8S;
+                           fn = (HWord)h_generic_calc_Max8Sx16;
+                           goto do_Sse4_or_Assisted;
+      case Iop_Min8Sx32:   op = Asse_MIN8S;
+                           fn = (HWord)h_generic_calc_Min8Sx16;
+                           goto do_Sse4_or_Assisted;
+      case Iop_CmpEQ64x4:  op = Asse_CMPEQ64;
+                           fn = (HWord)h_generic_calc_CmpEQ64x2;
+                           goto do_Sse4_or_Assisted;
+      case Iop_CmpGT64Sx4: op = Asse_CMPGT64S;
+                           fn = (HWord)h_generic_calc_CmpGT64Sx2;
+                           goto do_Sse4_or_Assisted;
+      do_Sse4_or_Assisted:
+         if (env->hwcaps & VEX_HWCAPS_AMD64_AVX)
+            goto do_SseReRg;
+         goto do_SseAssistedBinary;
+
       do_SseAssistedBinary: {
          /* RRRufff!  RRRufff code is what we're generating here.  Oh
             well. */
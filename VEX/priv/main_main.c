@@ -619,6 +619,7 @@ IRSB* LibVEX_FrontEnd ( /*MOD*/ VexTranslateArgs* vta,
                      vta->guest_bytes, 
                      vta->guest_bytes_addr,
                      vta->chase_into_ok,
+                     vta->guess_hot_successor,
                      vta->archinfo_host.endness,
                      vta->sigill_diag,
                      vta->arch_guest,
@@ -755,6 +755,16 @@ typedef
 	 NULL. */
       Bool    (*chase_into_ok) ( /*callback_opaque*/void*, Addr );
 
+      /* For a conditional branch which ends the superblock so far and
+         does not form an &&-idiom: which way does it usually go?
+         Return 1 for the branch target (sx), 0 for the fall through
+         (ft), or -1 if unknown, in which case the superblock ends at
+         the branch.  Both addresses will already have been accepted by
+         chase_into_ok.  May be NULL, which is the same as always
+         returning -1. */
+      Int     (*guess_hot_successor) ( /*callback_opaque*/void*,
+                                       Addr sx, Addr ft );
+
       /* OUT: which bits of guest code actually got translated */
       VexGuestExtents* guest_extents;
 
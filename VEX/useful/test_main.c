@@ -205,6 +205,7 @@ int main ( int argc, char** argv )
       vta.guest_bytes_addr = orig_addr;
       vta.callback_opaque = NULL;
       vta.chase_into_ok   = chase_into_not_ok;
+      vta.guess_hot_successor = NULL;
       vta.guest_extents   = &vge;
       vta.host_bytes      = transbuf;
       vta.host_bytes_size = N_TRANSBUF;
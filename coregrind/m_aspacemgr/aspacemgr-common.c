@@ -212,6 +212,18 @@ SysRes ML_(am_do_munmap_NO_NOTIFY)(Addr start, SizeT length)
    return VG_(do_syscall2)(__NR_munmap, (UWord)start, length );
 }
 
+SysRes VG_(am_release_pages)( Addr start, SizeT length )
+{
+   aspacem_assert(VG_IS_PAGE_ALIGNED(start));
+   aspacem_assert(VG_IS_PAGE_ALIGNED(length));
+#  if defined(VGO_linux) || defined(VGO_freebsd)
+   return VG_(do_syscall3)(__NR_madvise, (UWord)start, length,
+                           VKI_MADV_DONTNEED );
+#  else
+   return VG_(mk_SysRes_Error)( VKI_ENOSYS );
+#  endif
+}
+
 #if HAVE_MREMAP
 /* The following are used only to implement mremap(). */
 
@@ -34,6 +34,7 @@
 #include "pub_core_errormgr.h"
 #include "pub_core_execontext.h"
 #include "pub_core_gdbserver.h"
+#include "pub_core_hashtable.h"
 #include "pub_core_libcbase.h"
 #include "pub_core_libcassert.h"
 #include "pub_core_libcfile.h"
@@ -67,15 +68,58 @@
 #define M_COLLECT_NO_ERRORS_AFTER_FOUND 10000000
 
 /* The list of error contexts found, both suppressed and unsuppressed.
-   Initially empty, and grows as errors are detected. */
+   Initially empty, and grows as errors are detected.  Kept in
+   most-recently-used order. */
 static Error* errors = NULL;
 
+/* Hash table indexing 'errors', so that a new error only needs to be
+   compared against the errors having the same hash, rather than
+   against all errors found so far.  The hash covers the error kind,
+   the top of its ExeContext and whatever the tool hashes of the
+   'extra' part (see error_hash).  Each chain is kept in the same
+   relative order as 'errors', so that the first match found in a chain
+   is the same as the first match found when walking 'errors'.
+   errors_htab_size is always a power of 2. */
+#define N_ERRORS_HTAB_INIT 1024
+static Error** errors_htab = NULL;
+static UWord   errors_htab_size = 0;
+static UWord   errors_htab_used = 0;
+
 /* The list of suppression directives, as read from the specified
-   suppressions file.  Note that the list gets rearranged as a result
-   of the searches done by is_suppressible_error(). */
+   suppressions file.  This list is in load order; the order in which
+   suppressions are tried by is_suppressible_error() is given by their
+   'mru' field (see below). */
 static Supp* suppressions = NULL;
 static Bool load_suppressions_called = False;
 
+/* Index of the suppressions, used by is_suppressible_error() to avoid
+   trying suppressions that cannot possibly match.  A suppression whose
+   first frame is a plain (wildcard-free) fun: or obj: name can only
+   match an error whose first frame has exactly that name, so it is put
+   in the chain of the supp_index node for that name.  All other
+   suppressions are in the unindexed_supps chain.  Chains are linked
+   via Supp.inext, and are kept sorted by decreasing 'mru', so that
+   merging the candidate chains visits suppressions in the same order
+   as the single move-to-front list used to. */
+typedef
+   struct _SuppIndexNode {
+      struct _SuppIndexNode* next;
+      UWord         key;     /* hash of ty and name */
+      Int           ty;      /* FunName or ObjName */
+      const HChar*  name;
+      struct _Supp* supps;   /* chain of suppressions, via inext */
+   }
+   SuppIndexNode;
+
+static VgHashTable* supp_index = NULL;
+static Supp*        unindexed_supps = NULL;
+static UWord        n_supp_index_fun = 0;
+static UWord        n_supp_index_obj = 0;
+static UWord        n_supp_unindexed = 0;
+
+/* Incremented each time a suppression is loaded or matches. */
+static UWord supp_mru_clock = 0;
+
 /* Running count of unsuppressed errors detected. */
 static UInt n_errs_found = 0;
 
@@ -104,6 +148,9 @@ static UWord em_errlist_searches = 0;
    searching. */
 static UWord em_errlist_cmps = 0;
 
+/* Stats: number of times the error hash table was resized. */
+static UWord em_errlist_resizes = 0;
+
 /* Stats: number of searches of the suppression list initiated. */
 static UWord em_supplist_searches = 0;
 
@@ -111,6 +158,11 @@ static UWord em_supplist_searches = 0;
    searching. */
 static UWord em_supplist_cmps = 0;
 
+/* Stats: number of suppressions that would have been compared by a
+   search of the whole suppression list, but were skipped thanks to
+   supp_index. */
+static UWord em_supplist_skipped = 0;
+
 /*------------------------------------------------------------*/
 /*--- Error type                                           ---*/
 /*------------------------------------------------------------*/
@@ -126,6 +178,11 @@ static UWord em_supplist_cmps = 0;
 */
 struct _Error {
    struct _Error* next;
+   struct _Error* prev;
+   // Next error in the same errors_htab chain, and the full (unmasked)
+   // hash value of this error.
+   struct _Error* hnext;
+   UWord hash;
    // Unique tag.  This gives the error a unique identity (handle) by
    // which it can be referred to afterwords.  Currently only used for
    // XML printing.
@@ -225,6 +282,8 @@ typedef
    (0..)) for 'skind'. */
 struct _Supp {
    struct _Supp* next;
+   struct _Supp* inext;  // Next in its supp_index or unindexed_supps chain.
+   UWord mru;            // Value of supp_mru_clock when last used/loaded.
    Int count;     // The number of times this error has been suppressed.
    HChar* sname;  // The name by which the suppression is referred to.
 
@@ -314,6 +373,89 @@ static Bool eq_Error ( VgRes res, const Error* e1, const Error* e2 )
    }
 }
 
+/* Hash an error, consistently with eq_Error: any two errors that
+   eq_Error considers equal, at any resolution, must hash equal.  So
+   only the top two frames of the ExeContext are hashed, as that is all
+   that Vg_LowRes compares.  The epoch is not hashed either, as
+   VG_(eq_ExeContext) can consider two stacks in different epochs equal. */
+static UWord error_hash ( const Error* err )
+{
+   UWord  h     = (UWord)err->ekind;
+   Addr*  ips   = VG_(get_ExeContext_StackTrace)(err->where);
+   Int    n_ips = VG_(get_ExeContext_n_ips)(err->where);
+   Int    i;
+
+   for (i = 0; i < n_ips && i < 2; i++) {
+      h ^= ips[i];
+      h = (h << 19) | (h >> (8 * sizeof(UWord) - 19));
+   }
+
+   if (VG_(needs).tool_errors && VG_(tdict).tool_hash_Error != NULL)
+      h ^= VG_TDICT_CALL(tool_hash_Error, err) * 0x9E3779B1UL;
+
+   return h;
+}
+
+static inline UWord errors_htab_bucket ( UWord hash )
+{
+   return (hash ^ (hash >> 16)) & (errors_htab_size - 1);
+}
+
+/* Double the size of errors_htab.  Rebuilt from 'errors', appending to
+   the tail of each chain, so that chains stay in MRU order. */
+static void resize_errors_htab ( void )
+{
+   UWord   i, b;
+   Error*  p;
+   Error** tails;
+
+   errors_htab_size = errors_htab_size == 0
+                         ? N_ERRORS_HTAB_INIT : 2 * errors_htab_size;
+   if (errors_htab != NULL)
+      VG_(free)(errors_htab);
+   errors_htab = VG_(malloc)("errormgr.reh.1",
+                             errors_htab_size * sizeof(Error*));
+   tails       = VG_(malloc)("errormgr.reh.2",
+                             errors_htab_size * sizeof(Error*));
+   for (i = 0; i < errors_htab_size; i++) {
+      errors_htab[i] = NULL;
+      tails[i]       = NULL;
+   }
+   for (p = errors; p != NULL; p = p->next) {
+      b = errors_htab_bucket(p->hash);
+      p->hnext = NULL;
+      if (tails[b] == NULL)
+         errors_htab[b] = p;
+      else
+         tails[b]->hnext = p;
+      tails[b] = p;
+   }
+   VG_(free)(tails);
+   em_errlist_resizes++;
+}
+
+/* Put p at the front of 'errors' and of its errors_htab chain.
+   p must not currently be in either. */
+static void add_error_at_front ( Error* p )
+{
+   UWord b;
+
+   p->prev = NULL;
+   p->next = errors;
+   if (errors != NULL)
+      errors->prev = p;
+   errors = p;
+
+   if (errors_htab_used >= errors_htab_size)
+      resize_errors_htab();    /* also links p, as it is now in 'errors' */
+   else {
+      b = errors_htab_bucket(p->hash);
+      p->hnext = errors_htab[b];
+      errors_htab[b] = p;
+   }
+   errors_htab_used++;
+}
+
 
 /* Helper functions for suppression generation: print a single line of
    a suppression pseudo-stack-trace, either in XML or text mode.  It's
@@ -585,6 +727,8 @@ static void pp_Error ( const Error* err, Bool allow_db_attach, Bool xml )
       dictionary incorrectly. */
    vg_assert(VG_(needs).tool_errors);
 
+   VG_(start_deferred_output)();
+
    if (xml) {
 
       /* Ensure that suppression generation is either completely
@@ -640,6 +784,8 @@ static void pp_Error ( const Error* err, Bool allow_db_attach, Bool xml )
 
    }
 
+   VG_(end_deferred_output)();
+
    do_actions_on_error(err, allow_db_attach);
 }
 
@@ -657,6 +803,9 @@ void construct_error ( Error* err, ThreadId tid, ErrorKind ekind, Addr a,
    /* Core-only parts */
    err->unique   = unique_counter++;
    err->next     = NULL;
+   err->prev     = NULL;
+   err->hnext    = NULL;
+   err->hash     = 0;
    err->supp     = NULL;
    err->count    = 1;
    err->tid      = tid;
@@ -687,6 +836,7 @@ void VG_(maybe_record_error) ( ThreadId tid,
           Error  err;
           Error* p;
           Error* p_prev;
+          UWord  hash, b;
           UInt   extra_size;
           VgRes  exe_res          = Vg_MedRes;
    static Bool   stopping_message = False;
@@ -758,9 +908,16 @@ void VG_(maybe_record_error) ( ThreadId tid,
 
    /* First, see if we've got an error record matching this one. */
    em_errlist_searches++;
-   p       = errors;
+   hash    = error_hash(&err);
+   b       = errors_htab_size == 0 ? 0 : errors_htab_bucket(hash);
+   p       = errors_htab_size == 0 ? NULL : errors_htab[b];
    p_prev  = NULL;
    while (p != NULL) {
+      if (p->hash != hash) {
+         p_prev = p;
+         p      = p->hnext;
+         continue;
+      }
       em_errlist_cmps++;
       if (eq_Error(exe_res, p, &err)) {
          /* Found it. */
@@ -777,16 +934,26 @@ void VG_(maybe_record_error) ( ThreadId tid,
             for it are faster. It also allows to print the last
             error (see VG_(show_last_error). */
          if (p_prev != NULL) {
-            vg_assert(p_prev->next == p);
-            p_prev->next = p->next;
-            p->next      = errors;
-            errors       = p;
-	 }
+            vg_assert(p_prev->hnext == p);
+            p_prev->hnext  = p->hnext;
+            p->hnext       = errors_htab[b];
+            errors_htab[b] = p;
+         }
+         if (p != errors) {
+            vg_assert(p->prev != NULL && p->prev->next == p);
+            p->prev->next = p->next;
+            if (p->next != NULL)
+               p->next->prev = p->prev;
+            p->prev       = NULL;
+            p->next       = errors;
+            errors->prev  = p;
+            errors        = p;
+         }
 
          return;
       }
       p_prev = p;
-      p      = p->next;
+      p      = p->hnext;
    }
 
    /* Didn't see it.  Copy and add. */
@@ -809,6 +976,7 @@ void VG_(maybe_record_error) ( ThreadId tid,
    /* copy main part */
    p = VG_(malloc)("errormgr.mre.1", sizeof(Error));
    *p = err;
+   p->hash = hash;
 
    /* update 'extra' */
    switch (ekind) {
@@ -838,9 +1006,8 @@ void VG_(maybe_record_error) ( ThreadId tid,
       p->extra = new_extra;
    }
 
-   p->next = errors;
    p->supp = is_suppressible_error(&err);
-   errors  = p;
+   add_error_at_front(p);
    if (p->supp == NULL) {
       /* update stats */
       n_err_contexts++;
@@ -918,18 +1085,42 @@ Bool VG_(unique_error) ( ThreadId tid, ErrorKind ekind, Addr a, const HChar* s,
 
 /* Show the used suppressions.  Returns False if no suppression
    got used. */
+static Int cmp_Supp_by_mru ( const void* v1, const void* v2 )
+{
+   const Supp* su1 = *(const Supp* const *)v1;
+   const Supp* su2 = *(const Supp* const *)v2;
+   if (su1->mru > su2->mru) return -1;
+   if (su1->mru < su2->mru) return 1;
+   return 0;
+}
+
 static Bool show_used_suppressions ( void )
 {
    Supp  *su;
+   Supp  **used;
+   UWord n_used, i;
    Bool  any_supp;
 
+   /* Show the used suppressions, most recently used first. */
+   n_used = 0;
+   for (su = suppressions; su != NULL; su = su->next)
+      if (su->count > 0)
+         n_used++;
+   used = VG_(malloc)("errormgr.sus.2", (n_used + 1) * sizeof(Supp*));
+   n_used = 0;
+   for (su = suppressions; su != NULL; su = su->next)
+      if (su->count > 0)
+         used[n_used++] = su;
+   VG_(ssort)(used, n_used, sizeof(Supp*), cmp_Supp_by_mru);
+
+   VG_(start_deferred_output)();
+
    if (VG_(clo_xml))
       VG_(printf_xml)("<suppcounts>\n");
 
    any_supp = False;
-   for (su = suppressions; su != NULL; su = su->next) {
-      if (su->count <= 0)
-         continue;
+   for (i = 0; i < n_used; i++) {
+      su = used[i];
       if (VG_(clo_xml)) {
          VG_(printf_xml)( "  <pair>\n"
                                  "    <count>%d</count>\n"
@@ -968,6 +1159,9 @@ static Bool show_used_suppressions ( void )
    if (VG_(clo_xml))
       VG_(printf_xml)("</suppcounts>\n");
 
+   VG_(end_deferred_output)();
+
+   VG_(free)(used);
    return any_supp;
 }
 
@@ -1006,6 +1200,7 @@ void VG_(show_all_errors) (  Int verbosity, Bool xml )
       Once an error is shown, we add a huge value to its count to filter it
       out.
       After having shown all errors, we reset count to the original value. */
+   VG_(start_deferred_output)();
    for (i = 0; i < n_err_contexts; i++) {
       n_min = (1 << 30) - 1;
       p_min = NULL;
@@ -1038,6 +1233,7 @@ void VG_(show_all_errors) (  Int verbosity, Bool xml )
 
       p_min->count = p_min->count + (1 << 30);
    }
+   VG_(end_deferred_output)();
 
    /* reset the counts, otherwise a 2nd call does not show anything anymore */
    for (p = errors; p != NULL; p = p->next) {
@@ -1074,6 +1270,7 @@ void VG_(show_last_error) ( void )
 void VG_(show_error_counts_as_XML) ( void )
 {
    Error* err;
+   VG_(start_deferred_output)();
    VG_(printf_xml)("<errorcounts>\n");
    for (err = errors; err != NULL; err = err->next) {
       if (err->supp != NULL)
@@ -1087,6 +1284,7 @@ void VG_(show_error_counts_as_XML) ( void )
    }
    VG_(printf_xml)("</errorcounts>\n");
    VG_(printf_xml)("\n");
+   VG_(end_deferred_output)();
 }
 
 
@@ -1270,6 +1468,70 @@ static Bool tool_name_present(const HChar *name, const HChar *names)
    return found;
 }
 
+static UWord supp_index_hash ( Int ty, const HChar* name )
+{
+   UWord h = (UWord)ty;
+   while (*name) {
+      h = (h << 5) + h + (UChar)*name;
+      name++;
+   }
+   return h;
+}
+
+static Word cmp_SuppIndexNode ( const void* node1, const void* node2 )
+{
+   const SuppIndexNode* n1 = node1;
+   const SuppIndexNode* n2 = node2;
+   if (n1->ty != n2->ty)
+      return 1;
+   return VG_(strcmp)(n1->name, n2->name);
+}
+
+/* Returns the supp_index node for ty and name, or NULL if there is no
+   suppression indexed under this name. */
+static SuppIndexNode* lookup_supp_index ( Int ty, const HChar* name )
+{
+   SuppIndexNode key;
+   key.key  = supp_index_hash(ty, name);
+   key.ty   = ty;
+   key.name = name;
+   return VG_(HT_gen_lookup)(supp_index, &key, cmp_SuppIndexNode);
+}
+
+/* Add a newly loaded suppression at the head of the supp_index chain
+   or of unindexed_supps.  It becomes the most recently used. */
+static void index_suppression ( Supp* supp )
+{
+   const SuppLoc* first = &supp->callers[0];
+   Supp**         chain;
+
+   supp->mru = ++supp_mru_clock;
+
+   if ((first->ty == FunName || first->ty == ObjName)
+       && first->name_is_simple_str) {
+      SuppIndexNode* node = lookup_supp_index(first->ty, first->name);
+      if (node == NULL) {
+         node = VG_(malloc)("errormgr.idxs.1", sizeof(SuppIndexNode));
+         node->key   = supp_index_hash(first->ty, first->name);
+         node->ty    = first->ty;
+         node->name  = first->name;
+         node->supps = NULL;
+         VG_(HT_add_node)(supp_index, node);
+      }
+      if (first->ty == FunName)
+         n_supp_index_fun++;
+      else
+         n_supp_index_obj++;
+      chain = &node->supps;
+   } else {
+      n_supp_unindexed++;
+      chain = &unindexed_supps;
+   }
+
+   supp->inext = *chain;
+   *chain = supp;
+}
+
 /* Read suppressions from the file specified in 
    VG_(clo_suppressions)[clo_suppressions_i]
    and place them in the suppressions list.  If there's any difficulty
@@ -1460,6 +1722,7 @@ static void load_one_suppressions_file ( Int clo_suppressions_i )
 
       supp->next = suppressions;
       suppressions = supp;
+      index_suppression(supp);
    }
    VG_(free)(buf);
    VG_(close)(fd);
@@ -1491,6 +1754,11 @@ void VG_(load_suppressions) ( void )
 {
    Int i;
    suppressions = NULL;
+   if (supp_index != NULL)
+      VG_(HT_destruct)(supp_index, VG_(free));
+   supp_index = VG_(HT_construct)("errormgr.supp_index");
+   unindexed_supps  = NULL;
+   n_supp_index_fun = n_supp_index_obj = n_supp_unindexed = 0;
    load_suppressions_called = True;
    for (i = 0; i < VG_(sizeXA)(VG_(clo_suppressions)); i++) {
       if (VG_(clo_verbosity) > 1) {
@@ -1959,8 +2227,15 @@ Bool supp_matches_error(const Supp* su, const Error* err)
 */
 static Supp* is_suppressible_error ( const Error* err )
 {
-   Supp* su;
-   Supp* su_prev;
+   /* The candidate chains: the chains for the fun and obj names of the
+      first frame of err, and the unindexed suppressions. */
+#  define N_CHAINS 3
+   Supp*  chain_cur[N_CHAINS];
+   Supp** chain_head[N_CHAINS];
+   Supp*  chain_prev[N_CHAINS];
+   Supp*  su;
+   Int    c, best;
+   UWord  n_candidates = 0;
 
    IPtoFunOrObjCompleter ip2fo;
    /* Conceptually, ip2fo contains an array of function names and an array of
@@ -1994,32 +2269,77 @@ static Supp* is_suppressible_error ( const Error* err )
    ip2fo.names_szB = 0;
    ip2fo.names_free = 0;
 
-   /* See if the error context matches any suppression. */
+   /* Find the candidate chains.  Getting the names of the first frame
+      is not wasted work: nearly every suppression starts with a fun:
+      or obj: line, so they would be needed by the first match attempt
+      anyway. */
+   for (c = 0; c < N_CHAINS; c++)
+      chain_head[c] = NULL;
+   if (n_supp_index_fun + n_supp_index_obj > 0) {
+      SuppIndexNode* node;
+      expandInput(&ip2fo, 0);
+      if (n_supp_index_fun > 0) {
+         node = lookup_supp_index(FunName, foComplete(&ip2fo, 0, True));
+         if (node != NULL)
+            chain_head[0] = &node->supps;
+      }
+      if (n_supp_index_obj > 0) {
+         node = lookup_supp_index(ObjName, foComplete(&ip2fo, 0, False));
+         if (node != NULL)
+            chain_head[1] = &node->supps;
+      }
+   }
+   chain_head[2] = &unindexed_supps;
+   for (c = 0; c < N_CHAINS; c++) {
+      chain_cur[c]  = chain_head[c] == NULL ? NULL : *chain_head[c];
+      chain_prev[c] = NULL;
+   }
+
+   /* See if the error context matches any suppression.  The chains are
+      merged by decreasing 'mru', which is the order in which a search
+      of all suppressions would have tried them. */
    if (DEBUG_ERRORMGR || VG_(debugLog_getLevel)() >= 4)
      VG_(dmsg)("errormgr matching begin\n");
-   su_prev = NULL;
-   for (su = suppressions; su != NULL; su = su->next) {
+   while (True) {
+      best = -1;
+      for (c = 0; c < N_CHAINS; c++) {
+         if (chain_cur[c] != NULL
+             && (best == -1 || chain_cur[c]->mru > chain_cur[best]->mru))
+            best = c;
+      }
+      if (best == -1)
+         break;
+      su = chain_cur[best];
+      n_candidates++;
       em_supplist_cmps++;
       if (supp_matches_error(su, err) 
           && supp_matches_callers(&ip2fo, su)) {
          /* got a match.  */
          /* Inform the tool that err is suppressed by su. */
          (void)VG_TDICT_CALL(tool_update_extra_suppression_use, err, su);
-         /* Move this entry to the head of the list
-            in the hope of making future searches cheaper. */
-         if (su_prev) {
-            vg_assert(su_prev->next == su);
-            su_prev->next = su->next;
-            su->next = suppressions;
-            suppressions = su;
+         /* Make this entry the most recently used one, and move it to
+            the head of its chain, in the hope of making future
+            searches cheaper. */
+         su->mru = ++supp_mru_clock;
+         if (chain_prev[best] != NULL) {
+            vg_assert(chain_prev[best]->inext == su);
+            chain_prev[best]->inext = su->inext;
+            su->inext = *chain_head[best];
+            *chain_head[best] = su;
          }
+         em_supplist_skipped += n_supp_index_fun + n_supp_index_obj
+                                + n_supp_unindexed - n_candidates;
          clearIPtoFunOrObjCompleter(su, &ip2fo);
          return su;
       }
-      su_prev = su;
+      chain_prev[best] = su;
+      chain_cur[best]  = su->inext;
    }
+   em_supplist_skipped += n_supp_index_fun + n_supp_index_obj
+                          + n_supp_unindexed - n_candidates;
    clearIPtoFunOrObjCompleter(NULL, &ip2fo);
    return NULL;      /* no matches */
+#  undef N_CHAINS
 }
 
 /* Show accumulated error-list and suppression-list search stats. 
@@ -2030,10 +2350,20 @@ void VG_(print_errormgr_stats) ( void )
       " errormgr: %'lu supplist searches, %'lu comparisons during search\n",
       em_supplist_searches, em_supplist_cmps
    );
+   VG_(dmsg)(
+      " errormgr: %'lu supps indexed by fun, %'lu by obj, %'lu unindexed, "
+      "%'lu comparisons avoided\n",
+      n_supp_index_fun, n_supp_index_obj, n_supp_unindexed,
+      em_supplist_skipped
+   );
    VG_(dmsg)(
       " errormgr: %'lu errlist searches, %'lu comparisons during search\n",
       em_errlist_searches, em_errlist_cmps
    );
+   VG_(dmsg)(
+      " errormgr: %'lu errlist entries, %'lu hash buckets, %'lu resizes\n",
+      errors_htab_used, errors_htab_size, em_errlist_resizes
+   );
 }
 
 /*--------------------------------------------------------------------*/
@@ -485,7 +485,7 @@ Bool VG_(is_watched)(PointKind kind, Addr addr, Int szB)
 }
 
 /* Returns the reason for which gdbserver instrumentation is needed */
-static VgVgdb VG_(gdbserver_instrumentation_needed) (const VexGuestExtents* vge)
+VgVgdb VG_(gdbserver_instrumentation_needed) (const VexGuestExtents* vge)
 {
    GS_Address* g;
    int e;
@@ -665,6 +665,10 @@ static void call_gdbserver ( ThreadId tid , CallReason reason)
    int stepping;
    Addr saved_pc;
 
+   /* gdb may redirect the log output, and will want to see anything
+      reported so far. */
+   VG_(flush_deferred_output)();
+
    dlog(1,
         "entering call_gdbserver %s ... pid %d tid %u status %s "
         "sched_jmpbuf_valid %d\n",
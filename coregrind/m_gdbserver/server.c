@@ -31,6 +31,7 @@
 #include "pub_core_syswrap.h"      // VG_(show_open_fds)
 #include "pub_core_scheduler.h"
 #include "pub_core_transtab.h"
+#include "pub_core_transcache.h"
 #include "pub_core_debuginfo.h"
 #include "pub_core_addrinfo.h"
 #include "pub_core_aspacemgr.h"
@@ -169,9 +170,11 @@ void VG_(print_all_stats) (Bool memory_stats, Bool tool_stats)
 
    VG_(print_translation_stats)();
    VG_(print_tt_tc_stats)();
+   VG_(transcache_print_stats)();
    VG_(print_scheduler_stats)();
    VG_(print_ExeContext_stats)( False /* with_stacktraces */ );
    VG_(print_errormgr_stats)();
+   VG_(print_deferred_output_stats)();
    if (tool_stats && VG_(needs).print_stats) {
       VG_TDICT_CALL(tool_print_stats);
    }
@@ -296,6 +296,8 @@ static void exit_wrk( Int status, Bool gdbserver_call_allowed)
    static Bool exit_called = False;
    // avoid recursive exit during gdbserver call.
 
+   VG_(flush_deferred_output)();
+
    if (gdbserver_call_allowed && !exit_called) {
       const ThreadId atid = 1; // Arbitrary tid used to call/terminate gdbsrv.
       exit_called = True;
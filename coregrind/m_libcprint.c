@@ -342,6 +342,31 @@ void VG_(print_preamble)(Bool logging_to_fd)
 OutputSink VG_(log_output_sink) = {  2, VgLogTo_Fd, NULL }; /* 2 = stderr */
 OutputSink VG_(xml_output_sink) = { -1, VgLogTo_Fd, NULL }; /* disabled */
 
+/* Output sent to the sinks between VG_(start_deferred_output) and
+   VG_(end_deferred_output) is held back in deferred_buf, so that
+   printing an error, or a run of errors, costs a single write rather
+   than one per line (XML errors are written a few words at a time).
+   The held back output is written out before any other output, and
+   before anything else can observe the sinks: at each client system
+   call, at the end of each timeslice, on entry to the gdbserver and
+   at exit.  Output to gdb (fd -2) is never held back.
+
+   The buffer holds output for one sink at a time, so that output
+   going to the log and XML sinks, which may be the same file, stays
+   in order. */
+
+#define DEFERRED_BUF_SZB 16384
+
+static HChar       deferred_buf[DEFERRED_BUF_SZB];
+static Int         deferred_used = 0;
+static OutputSink* deferred_sink = NULL;
+static Int         deferring     = 0; /* nesting depth */
+
+static ULong stats__sends          = 0;
+static ULong stats__deferred_sends = 0;
+static ULong stats__writes         = 0;
+static ULong stats__full_flushes   = 0;
+
 static void revert_sink_to_stderr ( OutputSink *sink )
 {
    sink->fd = 2; /* stderr */
@@ -448,9 +473,12 @@ static Bool reopen_sink_if_needed(const HChar *clo_fname_unexpanded,
 
 void VG_(logging_atfork_child)(ThreadId tid)
 {
+   /* Anything held back belongs to the parent. */
+   deferred_used = 0;
+
    /* If --child-silent-after-fork=yes was specified, set the output file
       descriptors to 'impossible' values. This is noticed by
-      send_bytes_to_logging_sink(), which duly stops writing any further
+      write_to_logging_sink(), which duly stops writing any further
       output. */
    if (VG_(clo_child_silent_after_fork)) {
       if (VG_(log_output_sink).type != VgLogTo_Socket) {
@@ -584,9 +612,9 @@ void VG_(init_log_xml_sinks)(VgLogTo log_to, VgLogTo xml_to,
    }
 }
 
-/* Do the low-level send of a message to the logging sink. */
+/* Do the low-level write of a message to the logging sink. */
 static
-void send_bytes_to_logging_sink ( OutputSink* sink, const HChar* msg, Int nbytes )
+void write_to_logging_sink ( OutputSink* sink, const HChar* msg, Int nbytes )
 {
    if (sink->type == VgLogTo_Socket) {
       Int rc = VG_(write_socket)( sink->fd, msg, nbytes );
@@ -610,6 +638,66 @@ void send_bytes_to_logging_sink ( OutputSink* sink, const HChar* msg, Int nbytes
 }
 
 
+static void flush_deferred_output ( void )
+{
+   stats__writes++;
+   write_to_logging_sink( deferred_sink, deferred_buf, deferred_used );
+   deferred_used = 0;
+}
+
+void VG_(flush_deferred_output) ( void )
+{
+   if (UNLIKELY(deferred_used > 0))
+      flush_deferred_output();
+}
+
+void VG_(start_deferred_output) ( void )
+{
+   deferring++;
+}
+
+void VG_(end_deferred_output) ( void )
+{
+   vg_assert(deferring > 0);
+   deferring--;
+}
+
+void VG_(print_deferred_output_stats) ( void )
+{
+   VG_(dmsg)(
+      " libcprint: %'llu sends, %'llu deferred, %'llu writes, "
+      "%'llu flushes on full buffer\n",
+      stats__sends, stats__deferred_sends, stats__writes,
+      stats__full_flushes
+   );
+}
+
+/* Send a message to the logging sink, or hold it back if output is
+   being deferred. */
+static
+void send_bytes_to_logging_sink ( OutputSink* sink, const HChar* msg, Int nbytes )
+{
+   stats__sends++;
+   if (deferring > 0 && sink->fd >= 0 && nbytes <= DEFERRED_BUF_SZB) {
+      if (deferred_used > 0
+          && (deferred_sink != sink
+              || deferred_used + nbytes > DEFERRED_BUF_SZB)) {
+         if (deferred_sink == sink)
+            stats__full_flushes++;
+         flush_deferred_output();
+      }
+      VG_(memcpy)(&deferred_buf[deferred_used], msg, nbytes);
+      deferred_used += nbytes;
+      deferred_sink = sink;
+      stats__deferred_sends++;
+      return;
+   }
+   VG_(flush_deferred_output)();
+   stats__writes++;
+   write_to_logging_sink( sink, msg, nbytes );
+}
+
+
 /* ---------------------------------------------------------------------
    printf() and friends
    ------------------------------------------------------------------ */
@@ -1083,6 +1171,7 @@ UInt VG_(message) ( VgMsgKind kind, const HChar* format, ... )
 
 static void revert_to_stderr ( void )
 {
+   VG_(flush_deferred_output)();
    revert_sink_to_stderr(&VG_(log_output_sink));
 }
 
@@ -63,6 +63,7 @@
 #include "pub_core_translate.h"     // For VG_(translate)
 #include "pub_core_trampoline.h"
 #include "pub_core_transtab.h"
+#include "pub_core_transcache.h"
 #include "pub_core_inner.h"
 #if defined(ENABLE_INNER_CLIENT_REQUEST)
 #include "pub_core_clreq.h"
@@ -214,6 +215,12 @@ static void usage_NORETURN ( int need_help )
 "           more sectors may increase performance, but use more memory.\n"
 "    --avg-transtab-entry-size=<number> avg size in bytes of a translated\n"
 "           basic block [0, meaning use tool provided default]\n"
+"    --fast-cache-sets=<number> nr of sets of the fast translation lookup\n"
+"           cache, a power of 2 (amd64 only) [%d]\n"
+"    --translation-cache=<dir> save translations in <dir> at exit, and\n"
+"           reuse them in later runs of the same code [none]\n"
+"    --hot-trace-threshold=<number> retranslate code run this many times,\n"
+"           following its most frequent paths [0, meaning never]\n"
 "    --aspace-minaddr=0xPP     avoid mapping memory below 0xPP [guessed]\n"
 "    --valgrind-stacksize=<number> size of valgrind (host) thread's stack\n"
 "                               (in bytes) ["
@@ -359,6 +366,7 @@ static void usage_NORETURN ( int need_help )
                   VG_(clo_vgdb_poll)         /* int */,
                   VG_(vgdb_prefix_default)() /* char* */,
                   N_SECTORS_DEFAULT          /* int */,
+                  VG_TT_FAST_SETS            /* int */,
                   MAX_THREADS_DEFAULT        /* int */
                );
    if (need_help > 1 && VG_(details).name) {
@@ -681,6 +689,21 @@ static void process_option (Clo_Mode mode,
    else if VG_BINT_CLO(arg, "--avg-transtab-entry-size",
                        VG_(clo_avg_transtab_entry_size),
                        50, 5000) {}
+   else if VG_BINT_CLO(arg, "--fast-cache-sets",
+                       VG_(clo_fast_cache_sets),
+                       1 << VG_TT_FAST_MIN_BITS, 1 << VG_TT_FAST_MAX_BITS) {
+      if ((VG_(clo_fast_cache_sets) & (VG_(clo_fast_cache_sets) - 1)) != 0)
+         VG_(fmsg_bad_option)(arg, "Value must be a power of 2\n");
+#     if !defined(VG_TT_FAST_TUNABLE)
+      if (VG_(clo_fast_cache_sets) != VG_TT_FAST_SETS)
+         VG_(fmsg_bad_option)(arg,
+            "The fast cache size cannot be changed on this platform\n");
+#     endif
+   }
+   else if VG_STR_CLO(arg, "--translation-cache",
+                      VG_(clo_translation_cache)) {}
+   else if VG_BINT_CLO(arg, "--hot-trace-threshold",
+                       VG_(clo_hot_trace_threshold), 0, 1 << 30) {}
    else if VG_BINT_CLOM(cloPD, arg, "--merge-recursive-frames",
                         VG_(clo_merge_recursive_frames), 0,
                         VG_DEEPEST_BACKTRACE) {}
@@ -1028,6 +1051,10 @@ void main_process_cmd_line_options( void )
          "Can't use --gen-suppressions= with %s\n"
          "because it doesn't generate errors.\n", VG_(details).name);
    }
+   if (VG_(clo_hot_trace_threshold) > 0 && VG_(clo_profyle_sbs)) {
+      VG_(fmsg_bad_option)("--hot-trace-threshold",
+         "Can't use --hot-trace-threshold= with --profile-flags=\n");
+   }
    if ((VG_(clo_exit_on_first_error)) &&
        (VG_(clo_error_exitcode)==0)) {
       VG_(fmsg_bad_option)("--exit-on-first-error=yes",
@@ -2318,6 +2345,9 @@ void shutdown_actions_NORETURN( ThreadId tid,
 
    VG_(sanity_check_general)( True /*include expensive checks*/ );
 
+   /* Save the translations made, for the next run. */
+   VG_(transcache_save)();
+
    if (VG_(clo_stats))
       VG_(print_all_stats)(VG_(clo_verbosity) >= 1, /* Memory stats */
                            False /* tool prints stats in the tool fini */);
@@ -61,6 +61,9 @@ static void cc_analyse_alloc_arena ( ArenaId aid ); /* fwds */
 
 #define N_MALLOC_LISTS     112    // do not change this
 
+// Number of ULongs needed for one bit per freelist.
+#define N_FREELIST_WORDS   ((N_MALLOC_LISTS + 63) / 64)
+
 // The amount you can ask for is limited only by sizeof(SizeT)...
 #define MAX_PSZB              (~((SizeT)0x0))
 
@@ -207,6 +210,10 @@ typedef
       // Smaller size superblocks are splittable and can be reclaimed when all
       // their blocks are freed.
       Block*       freelist[N_MALLOC_LISTS];
+      // Bit n is set iff freelist[n] is non-empty, so that
+      // VG_(arena_malloc) can find the first non-empty list big enough
+      // for a request without looking at each of the lists in turn.
+      ULong        freelist_nonempty[N_FREELIST_WORDS];
       // A dynamically expanding, ordered array of (pointers to)
       // superblocks in the arena.  If this array is expanded, which
       // is rare, the previous space it occupies is simply abandoned.
@@ -599,6 +606,7 @@ void arena_init ( ArenaId aid, const HChar* name, SizeT rz_szB,
    a->min_sblock_szB = min_sblock_szB;
    a->min_unsplittable_sblock_szB = min_unsplittable_sblock_szB;
    for (i = 0; i < N_MALLOC_LISTS; i++) a->freelist[i] = NULL;
+   for (i = 0; i < N_FREELIST_WORDS; i++) a->freelist_nonempty[i] = 0;
 
    a->sblocks                  = & a->sblocks_initial[0];
    a->sblocks_size             = SBLOCKS_SIZE_INITIAL;
@@ -1387,12 +1395,19 @@ static void sanity_check_malloc_arena ( ArenaId aid )
 
    /* Second, traverse each list, checking that the back pointers make
       sense, counting blocks encountered, and checking that each block
-      is an appropriate size for this list. */
+      is an appropriate size for this list.  Also check that the
+      non-empty bit for each list is right. */
    blockctr_li = 0;
    for (listno = 0; listno < N_MALLOC_LISTS; listno++) {
       list_min_pszB = listNo_to_pszB_min(listno);
       list_max_pszB = listNo_to_pszB_max(listno);
       b = a->freelist[listno];
+      if ((b != NULL)
+          != ((a->freelist_nonempty[listno / 64] >> (listno % 64)) & 1)) {
+         VG_(printf)( "sanity_check_malloc_arena: list %u: "
+                      "BAD NON-EMPTY BIT\n", listno );
+         BOMB;
+      }
       if (b == NULL) continue;
       while (True) {
          b_prev = b;
@@ -1633,6 +1648,7 @@ void mkFreeBlock ( Arena* a, Block* b, SizeT bszB, UInt b_lno )
       set_prev_b(b, b);
       set_next_b(b, b);
       a->freelist[b_lno] = b;
+      a->freelist_nonempty[b_lno / 64] |= 1ULL << (b_lno % 64);
    } else {
       Block* b_prev = get_prev_b(a->freelist[b_lno]);
       Block* b_next = a->freelist[b_lno];
@@ -1699,6 +1715,7 @@ void unlinkBlock ( Arena* a, Block* b, UInt listno )
       // Only one element in the list; treat it specially.
       vg_assert(get_next_b(b) == b);
       a->freelist[listno] = NULL;
+      a->freelist_nonempty[listno / 64] &= ~(1ULL << (listno % 64));
    } else {
       Block* b_prev = get_prev_b(b);
       Block* b_next = get_next_b(b);
@@ -1711,6 +1728,26 @@ void unlinkBlock ( Arena* a, Block* b, UInt listno )
    set_next_b(b, NULL);
 }
 
+// Find the first non-empty list numbered lno or above.  Returns
+// N_MALLOC_LISTS if there is none.
+static __inline__
+UInt first_nonempty_list ( const Arena* a, UInt lno )
+{
+   UInt  w;
+   ULong bits;
+
+   if (lno >= N_MALLOC_LISTS)
+      return N_MALLOC_LISTS;
+   w    = lno / 64;
+   bits = a->freelist_nonempty[w] & (~0ULL << (lno % 64));
+   while (bits == 0) {
+      if (++w == N_FREELIST_WORDS)
+         return N_MALLOC_LISTS;
+      bits = a->freelist_nonempty[w];
+   }
+   return w * 64 + __builtin_ctzll(bits);
+}
+
 
 /*------------------------------------------------------------*/
 /*--- Core-visible functions.                              ---*/
@@ -1768,28 +1805,17 @@ void* VG_(arena_malloc) ( ArenaId aid, const HChar* cc, SizeT req_pszB )
    vg_assert(cc);
 
    // Scan through all the big-enough freelists for a block.
-   //
-   // Nb: this scanning might be expensive in some cases.  Eg. if you
-   // allocate lots of small objects without freeing them, but no
-   // medium-sized objects, it will repeatedly scanning through the whole
-   // list, and each time not find any free blocks until the last element.
-   //
-   // If this becomes a noticeable problem... the loop answers the question
-   // "where is the first nonempty list above me?"  And most of the time,
-   // you ask the same question and get the same answer.  So it would be
-   // good to somehow cache the results of previous searches.
-   // One possibility is an array (with N_MALLOC_LISTS elements) of
-   // shortcuts.  shortcut[i] would give the index number of the nearest
-   // larger list above list i which is non-empty.  Then this loop isn't
-   // necessary.  However, we'd have to modify some section [ .. i-1] of the
-   // shortcut array every time a list [i] changes from empty to nonempty or
-   // back.  This would require care to avoid pathological worst-case
-   // behaviour.
-   //
-   for (lno = pszB_to_listNo(req_pszB); lno < N_MALLOC_LISTS; lno++) {
+   // Empty lists are skipped using a->freelist_nonempty, since in
+   // programs that allocate lots of small objects but few medium-sized
+   // ones, most of the lists above the requested one are empty, and
+   // walking over them one by one is a noticeable part of every
+   // allocation.
+   for (lno = first_nonempty_list(a, pszB_to_listNo(req_pszB));
+        lno < N_MALLOC_LISTS;
+        lno = first_nonempty_list(a, lno+1)) {
       UWord nsearches_this_level = 0;
       b = a->freelist[lno];
-      if (NULL == b) continue;   // If this list is empty, try the next one.
+      vg_assert(b != NULL);
       while (True) {
          stats__nsearches++;
          nsearches_this_level++;
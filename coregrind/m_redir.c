@@ -1367,6 +1367,7 @@ void VG_(redir_initialise) ( void )
 
    /* If we're using memcheck, use these intercepts right from
       the start, otherwise ld.so makes a lot of noise. */
+#undef GLIBC_MANDATORY_STRLEN_REDIRECT /*LOCALHACK*/
    if (0==VG_(strcmp)("Memcheck", VG_(details).name)) {
 
       add_hardwired_spec(
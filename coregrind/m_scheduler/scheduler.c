@@ -263,6 +263,24 @@ void maybe_show_sb_profile ( void )
    }
 }
 
+/* For making hot traces, if the user asks for them.  Looking for hot
+   translations means scanning the whole translation table, so only do
+   it every so often. */
+static
+void maybe_retranslate_hot_SBs ( ThreadId tid )
+{
+   /* DO NOT MAKE NON-STATIC */
+   static ULong bbs_done_lastcheck = 0;
+   /* */
+   vg_assert(VG_(clo_hot_trace_threshold) > 0);
+   Long delta = (Long)(bbs_done - bbs_done_lastcheck);
+   vg_assert(delta >= 0);
+   if ((ULong)delta >= 1000000) {
+      bbs_done_lastcheck = bbs_done;
+      VG_(retranslate_hot_SBs)(tid, bbs_done);
+   }
+}
+
 static
 const HChar* name_of_sched_event ( UInt event )
 {
@@ -1386,6 +1404,9 @@ VgSchedReturnCode VG_(scheduler) ( ThreadId tid )
 	 /* 3 Aug 06: doing sys__nsleep works but crashes some apps.
             sys_yield also helps the problem, whilst not crashing apps. */
 
+	 /* Don't keep errors reported in this slice waiting. */
+	 VG_(flush_deferred_output)();
+
 	 VG_(release_BigLock)(tid, VgTs_Yielding, 
                                    "VG_(scheduler):timeslice");
 	 /* ------------ now we don't have The Lock ------------ */
@@ -1745,6 +1766,14 @@ VgSchedReturnCode VG_(scheduler) ( ThreadId tid )
 
       if (UNLIKELY(VG_(clo_profyle_sbs)) && VG_(clo_profyle_interval) > 0)
          maybe_show_sb_profile();
+
+      if (UNLIKELY(VG_(clo_hot_trace_threshold) > 0))
+         maybe_retranslate_hot_SBs(tid);
+
+      /* A tool may have asked for all translations to be discarded,
+         which could not be done while it was running. */
+      if (UNLIKELY(VG_(pending_discard_all_who) != NULL))
+         VG_(discard_pending_translations)();
    }
 
    if (VG_(clo_trace_sched))
@@ -1678,6 +1678,8 @@ void VG_(kill_self)(Int sigNo)
    vki_sigaction_toK_t   sa, origsa2;
    vki_sigaction_fromK_t origsa;   
 
+   VG_(flush_deferred_output)();
+
    sa.ksa_handler = VKI_SIG_DFL;
    sa.sa_flags = 0;
 #  if !defined(VGO_darwin) && !defined(VGO_freebsd) && \
@@ -129,6 +129,7 @@ DECL_TEMPLATE(linux, sys_io_cancel);
 DECL_TEMPLATE(linux, sys_ioprio_set);
 DECL_TEMPLATE(linux, sys_ioprio_get);
 
+DECL_TEMPLATE(linux, sys_madvise);
 DECL_TEMPLATE(linux, sys_mbind);
 DECL_TEMPLATE(linux, sys_set_mempolicy);
 DECL_TEMPLATE(linux, sys_get_mempolicy);
@@ -268,6 +268,31 @@ ML_(notify_core_and_tool_of_mprotect) ( Addr a, SizeT len, Int prot )
 
 
 #if HAVE_MREMAP
+/* Tell the tool that the mapping [old_addr, old_addr+old_len) was
+   moved to new_addr and resized to new_len. */
+static
+void notify_tool_of_mremap_move( Addr old_addr, SizeT old_len,
+                                 Addr new_addr, SizeT new_len,
+                                 Bool rr, Bool ww, Bool xx )
+{
+   SizeT len = old_len < new_len ? old_len : new_len;
+
+   if (VG_(tdict).track_move_mem_remap) {
+      VG_TRACK( move_mem_remap, old_addr, new_addr, len );
+      if (new_len > old_len)
+         VG_TRACK( new_mem_mmap, new_addr+old_len, new_len-old_len,
+                   rr, ww, xx, 0/*di_handle*/ );
+      if (old_len > new_len)
+         VG_TRACK( die_mem_munmap, old_addr+new_len, old_len-new_len );
+   } else {
+      VG_TRACK( copy_mem_remap, old_addr, new_addr, len );
+      if (new_len > old_len)
+         VG_TRACK( new_mem_mmap, new_addr+old_len, new_len-old_len,
+                   rr, ww, xx, 0/*di_handle*/ );
+      VG_TRACK( die_mem_munmap, old_addr, old_len );
+   }
+}
+
 /* Expand (or shrink) an existing mapping, potentially moving it at
    the same time (controlled by the MREMAP_MAYMOVE flag).  Nightmare.
 */
@@ -276,8 +301,6 @@ SysRes do_mremap( Addr old_addr, SizeT old_len,
                   Addr new_addr, SizeT new_len,
                   UWord flags, ThreadId tid )
 {
-#  define MIN_SIZET(_aa,_bb) (_aa) < (_bb) ? (_aa) : (_bb)
-
    Bool      ok, d;
    NSegment const* old_seg;
    Addr      advised;
@@ -403,13 +426,9 @@ SysRes do_mremap( Addr old_addr, SizeT old_len,
       ok = VG_(am_relocate_nooverlap_client)
               ( &d, old_addr, old_len, new_addr, new_len );
       if (ok) {
-         VG_TRACK( copy_mem_remap, old_addr, new_addr, 
-                                   MIN_SIZET(old_len,new_len) );
-         if (new_len > old_len)
-            VG_TRACK( new_mem_mmap, new_addr+old_len, new_len-old_len,
-                      old_seg->hasR, old_seg->hasW, old_seg->hasX,
-                      0/*di_handle*/ );
-         VG_TRACK(die_mem_munmap, old_addr, old_len);
+         notify_tool_of_mremap_move( old_addr, old_len, new_addr, new_len,
+                                     old_seg->hasR, old_seg->hasW,
+                                     old_seg->hasX );
          if (d) {
             VG_(discard_translations)( old_addr, old_len, "do_remap(1)" );
             VG_(discard_translations)( new_addr, new_len, "do_remap(2)" );
@@ -459,12 +478,8 @@ SysRes do_mremap( Addr old_addr, SizeT old_len,
       ok = VG_(am_relocate_nooverlap_client)
               ( &d, old_addr, old_len, advised, new_len );
       if (ok) {
-         VG_TRACK( copy_mem_remap, old_addr, advised, 
-                                   MIN_SIZET(old_len,new_len) );
-         if (new_len > old_len)
-            VG_TRACK( new_mem_mmap, advised+old_len, new_len-old_len,
-                      oldR, oldW, oldX, 0/*di_handle*/ );
-         VG_TRACK(die_mem_munmap, old_addr, old_len);
+         notify_tool_of_mremap_move( old_addr, old_len, advised, new_len,
+                                     oldR, oldW, oldX );
          if (d) {
             VG_(discard_translations)( old_addr, old_len, "do_remap(4)" );
             VG_(discard_translations)( advised, new_len, "do_remap(5)" );
@@ -522,8 +537,6 @@ SysRes do_mremap( Addr old_addr, SizeT old_len,
    return VG_(mk_SysRes_Error)( VKI_EINVAL );
   eNOMEM:
    return VG_(mk_SysRes_Error)( VKI_ENOMEM );
-
-#  undef MIN_SIZET
 }
 #endif /* HAVE_MREMAP */
 
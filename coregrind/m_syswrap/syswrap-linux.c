@@ -2664,6 +2664,27 @@ POST(sys_io_cancel)
    POST_MEM_WRITE( ARG3, sizeof(struct vki_io_event) );
 }
 
+/* ---------------------------------------------------------------------
+   madvise wrapper
+   ------------------------------------------------------------------ */
+
+PRE(sys_madvise)
+{
+   *flags |= SfMayBlock;
+   PRINT("sys_madvise ( %#" FMT_REGWORD "x, %" FMT_REGWORD "u, %ld )",
+                        ARG1, ARG2, SARG3);
+   PRE_REG_READ3(long, "madvise",
+                 unsigned long, start, vki_size_t, length, int, advice);
+}
+POST(sys_madvise)
+{
+   /* On Linux, MADV_DONTNEED drops the pages of the range, which are
+      then read again from the file or as zeroes.  The length is
+      rounded up to whole pages. */
+   if (ARG3 == VKI_MADV_DONTNEED && ARG2 > 0)
+      VG_TRACK( discard_mem_madvise, ARG1, VG_PGROUNDUP(ARG2) );
+}
+
 /* ---------------------------------------------------------------------
    *_mempolicy wrappers
    ------------------------------------------------------------------ */
@@ -2096,6 +2096,10 @@ void VG_(client_syscall) ( ThreadId tid, UInt trc )
 
    tst = VG_(get_ThreadState)(tid);
 
+   /* Errors reported before the syscall must be visible by the time
+      it happens, especially if it writes to the same file. */
+   VG_(flush_deferred_output)();
+
    /* BEGIN ensure root thread's stack is suitably mapped */
    /* In some rare circumstances, we may do the syscall without the
       bottom page of the stack being mapped, because the stack pointer
@@ -860,7 +860,7 @@ static SyscallTableEntry syscall_table[] = {
    GENXY(__NR_getdents64,        sys_getdents64),        // 202
    LINX_(__NR_pivot_root,        sys_pivot_root),        // 203
    LINXY(__NR_fcntl64,           sys_fcntl64),           // 204
-   GENX_(__NR_madvise,           sys_madvise),           // 205
+   LINXY(__NR_madvise,           sys_madvise),           // 205
    GENXY(__NR_mincore,           sys_mincore),           // 206
    LINX_(__NR_gettid,            sys_gettid),            // 207
 //..    LINX_(__NR_tkill,             sys_tkill),             // 208 */Linux
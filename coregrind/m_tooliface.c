@@ -97,7 +97,8 @@ VgNeeds VG_(needs) = {
    .var_info	         = False,
    .malloc_replacement   = False,
    .xml_output           = False,
-   .final_IR_tidy_pass   = False
+   .final_IR_tidy_pass   = False,
+   .cacheable_translations = False
 };
 
 /* static */
@@ -244,7 +245,8 @@ void VG_(needs_tool_errors)(
    const HChar* (*name) (const Error*),
    SizeT (*get_xtra_si)(const Error*,/*OUT*/HChar*,Int),
    SizeT (*print_xtra_su)(const Supp*,/*OUT*/HChar*,Int),
-   void (*update_xtra_su)(const Error*, const Supp*)
+   void (*update_xtra_su)(const Error*, const Supp*),
+   UWord (*hash)      (const Error*)
 )
 {
    VG_(needs).tool_errors = True;
@@ -260,6 +262,7 @@ void VG_(needs_tool_errors)(
    VG_(tdict).tool_get_extra_suppression_info   = get_xtra_si;
    VG_(tdict).tool_print_extra_suppression_use  = print_xtra_su;
    VG_(tdict).tool_update_extra_suppression_use = update_xtra_su;
+   VG_(tdict).tool_hash_Error                   = hash;
 }
 
 void VG_(needs_command_line_options)(
@@ -382,6 +385,11 @@ void VG_(needs_final_IR_tidy_pass)(
    VG_(tdict).tool_final_IR_tidy_pass = final_tidy;
 }
 
+void VG_(needs_cacheable_translations)( void )
+{
+   VG_(needs).cacheable_translations = True;
+}
+
 /*--------------------------------------------------------------------*/
 /* Tracked events.  Digit 'n' on DEFn is the REGPARMness. */
 
@@ -406,6 +414,8 @@ DEF0(track_new_mem_brk,           Addr, SizeT, UInt)
 DEF0(track_new_mem_mmap,          Addr, SizeT, Bool, Bool, Bool, ULong)
 
 DEF0(track_copy_mem_remap,        Addr, Addr, SizeT)
+DEF0(track_move_mem_remap,        Addr, Addr, SizeT)
+DEF0(track_discard_mem_madvise,   Addr, SizeT)
 DEF0(track_change_mem_mprotect,   Addr, SizeT, Bool, Bool, Bool)
 DEF0(track_die_mem_stack_signal,  Addr, SizeT)
 DEF0(track_die_mem_brk,           Addr, SizeT)
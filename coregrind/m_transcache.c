@@ -0,0 +1,511 @@
+
+/*--------------------------------------------------------------------*/
+/*--- Persistent translation cache.                 m_transcache.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "pub_core_basics.h"
+#include "pub_core_vki.h"
+#include "pub_core_aspacemgr.h"
+#include "pub_core_clientstate.h"   // VG_(args_for_valgrind)
+#include "pub_core_debuglog.h"
+#include "pub_core_hashtable.h"
+#include "pub_core_libcassert.h"
+#include "pub_core_libcbase.h"
+#include "pub_core_libcfile.h"
+#include "pub_core_libcprint.h"
+#include "pub_core_libcproc.h"      // VG_(getpid)
+#include "pub_core_machine.h"       // VG_(machine_get_VexArchInfo)
+#include "pub_core_mallocfree.h"
+#include "pub_core_options.h"
+#include "pub_core_tooliface.h"
+#include "pub_core_xarray.h"
+#include "pub_core_transcache.h"    // self
+
+/* Overview
+   ~~~~~~~~
+   With --translation-cache=<dir>, the translations made during a run
+   are written at exit to a file in <dir>, and the next run with the
+   same tool, Valgrind build, host CPU and options loads them and hands
+   them to VG_(translate) instead of translating again.
+
+   Host code made by Vex is not relocatable with respect to the guest
+   code: it contains guest addresses.  It is however independent of
+   where it is placed in the translation cache, and the only other
+   absolute addresses it contains are those of the dispatcher and of
+   helper functions, which are fixed for a given tool executable.  So a
+   saved translation is valid in a later run iff the same guest bytes
+   are found at the same guest address.  Each entry therefore records
+   a hash of the guest bytes of its extents, which is checked before
+   the entry is used.  Entries whose code is not found again (e.g.
+   because of address space randomisation) are just not used.
+
+   Translations are saved unchained, so chaining is redone as usual
+   after they are put in the transtab.  Translations intersecting a
+   range given to VG_(discard_translations) (munmap, self-modifying
+   code, client requests) are forgotten. */
+
+#define TC_MAGIC    "VGTRCACH"
+#define TC_VERSION  1
+
+typedef
+   struct {
+      HChar magic[8];
+      UInt  version;
+      UInt  n_entries;
+      ULong config_hash;
+   }
+   TCFileHeader;
+
+/* Followed on disk by te.code_len bytes of code, padded to 8 bytes. */
+typedef
+   struct {
+      ULong           guest_hash;
+      TransCacheEntry te;          /* te.code is not meaningful on disk */
+   }
+   TCFileEntry;
+
+typedef
+   struct _TCNode {
+      struct _TCNode* next;
+      UWord           key;         /* te.nraddr */
+      ULong           guest_hash;
+      Bool            owns_code;   /* te.code was allocated for this node */
+      TransCacheEntry te;
+   }
+   TCNode;
+
+/* 0: not yet initialised, 1: enabled, -1: disabled */
+static Int          tc_state = 0;
+static HChar*       tc_filename = NULL;
+static ULong        tc_config_hash = 0;
+static VgHashTable* tc_table = NULL;
+static UChar*       tc_image = NULL;   /* loaded file contents */
+
+/* All entries ever in tc_table are within [tc_min_addr, tc_max_addr]. */
+static Addr tc_min_addr = ~(Addr)0;
+static Addr tc_max_addr = 0;
+
+/* Stats */
+static UWord n_tc_loaded    = 0;
+static UWord n_tc_hits      = 0;
+static UWord n_tc_stale     = 0;
+static UWord n_tc_added     = 0;
+static UWord n_tc_discarded = 0;
+static UWord n_tc_saved     = 0;
+
+/*------------------------------------------------------------*/
+/*--- Hashing                                              ---*/
+/*------------------------------------------------------------*/
+
+static inline ULong fnv_start ( void )
+{
+   return 0xcbf29ce484222325ULL;
+}
+
+static inline ULong fnv_bytes ( ULong h, const UChar* p, SizeT n )
+{
+   SizeT i;
+   for (i = 0; i < n; i++) {
+      h ^= p[i];
+      h *= 0x100000001b3ULL;
+   }
+   return h;
+}
+
+static ULong fnv_string ( ULong h, const HChar* s )
+{
+   return fnv_bytes(h, (const UChar*)s, VG_(strlen)(s) + 1);
+}
+
+/* Hash the guest bytes of vge, or return False if some extent is not
+   (or no longer) readable client memory. */
+static Bool hash_guest_bytes ( const VexGuestExtents* vge,
+                               /*OUT*/ULong* hash )
+{
+   UInt  i;
+   ULong h = fnv_start();
+
+   for (i = 0; i < vge->n_used; i++) {
+      if (vge->len[i] > 0
+          && !VG_(am_is_valid_for_client)(vge->base[i], vge->len[i],
+                                          VKI_PROT_READ))
+         return False;
+      h = fnv_bytes(h, (const UChar*)&vge->base[i], sizeof(Addr));
+      h = fnv_bytes(h, (const UChar*)(Addr)vge->base[i], vge->len[i]);
+   }
+   *hash = h;
+   return True;
+}
+
+/* Options that only affect Valgrind's own output, and so can differ
+   between runs sharing a cache file. */
+static Bool arg_is_output_only ( const HChar* arg )
+{
+   return VG_(strncmp)(arg, "--log-", 6) == 0
+          || VG_(strncmp)(arg, "--xml-", 6) == 0
+          || VG_(strncmp)(arg, "--translation-cache=", 20) == 0
+          || VG_STREQ(arg, "-q") || VG_STREQ(arg, "--quiet")
+          || VG_STREQ(arg, "-v") || VG_STREQ(arg, "--verbose")
+          || VG_(strncmp)(arg, "--stats=", 8) == 0;
+}
+
+/* Hash of everything, other than the guest code, that can affect the
+   code produced by VG_(translate): the tool executable, the host CPU
+   and the options. */
+static Bool compute_config_hash ( /*OUT*/ULong* hash )
+{
+   struct vg_stat st;
+   VexArch        arch;
+   VexArchInfo    archinfo;
+   Word           i;
+   ULong          h = fnv_start();
+   SysRes         sr;
+
+   sr = VG_(stat)("/proc/self/exe", &st);
+   if (sr_isError(sr))
+      return False;
+   h = fnv_bytes(h, (const UChar*)&st.ino,   sizeof(st.ino));
+   h = fnv_bytes(h, (const UChar*)&st.size,  sizeof(st.size));
+   h = fnv_bytes(h, (const UChar*)&st.mtime, sizeof(st.mtime));
+   h = fnv_bytes(h, (const UChar*)&st.mtime_nsec, sizeof(st.mtime_nsec));
+
+   h = fnv_string(h, VERSION);
+   h = fnv_string(h, VG_(clo_toolname));
+
+   VG_(machine_get_VexArchInfo)(&arch, &archinfo);
+   h = fnv_bytes(h, (const UChar*)&arch, sizeof(arch));
+   h = fnv_bytes(h, (const UChar*)&archinfo.hwcaps,
+                 sizeof(archinfo.hwcaps));
+   h = fnv_bytes(h, (const UChar*)&archinfo.endness,
+                 sizeof(archinfo.endness));
+
+   for (i = 0; i < VG_(sizeXA)(VG_(args_for_valgrind)); i++) {
+      const HChar* arg = *(HChar**)VG_(indexXA)(VG_(args_for_valgrind), i);
+      if (!arg_is_output_only(arg))
+         h = fnv_string(h, arg);
+   }
+
+   *hash = h;
+   return True;
+}
+
+/*------------------------------------------------------------*/
+/*--- The table of saved translations                      ---*/
+/*------------------------------------------------------------*/
+
+static void free_TCNode ( void* v )
+{
+   TCNode* node = v;
+   if (node->owns_code)
+      VG_(free)((void*)(Addr)node->te.code);
+   VG_(free)(node);
+}
+
+static void add_TCNode ( TCNode* node )
+{
+   UInt    i;
+   TCNode* old = VG_(HT_remove)(tc_table, node->key);
+   if (old)
+      free_TCNode(old);
+   VG_(HT_add_node)(tc_table, node);
+   for (i = 0; i < node->te.vge.n_used; i++) {
+      if (node->te.vge.base[i] < tc_min_addr)
+         tc_min_addr = node->te.vge.base[i];
+      if (node->te.vge.base[i] + node->te.vge.len[i] > tc_max_addr)
+         tc_max_addr = node->te.vge.base[i] + node->te.vge.len[i];
+   }
+}
+
+/* Load the cache file, if there is a valid one.  Any problem with the
+   file just means starting with an empty cache. */
+static void load_cache_file ( void )
+{
+   SysRes        sr;
+   Int           fd;
+   Long          size;
+   SizeT         off;
+   UInt          i;
+   TCFileHeader* hdr;
+
+   sr = VG_(open)(tc_filename, VKI_O_RDONLY, 0);
+   if (sr_isError(sr))
+      return;
+   fd   = sr_Res(sr);
+   size = VG_(fsize)(fd);
+   if (size < (Long)sizeof(TCFileHeader)) {
+      VG_(close)(fd);
+      return;
+   }
+   tc_image = VG_(malloc)("transcache.load.1", size);
+   if (VG_(read)(fd, tc_image, size) != size) {
+      VG_(close)(fd);
+      VG_(free)(tc_image);
+      tc_image = NULL;
+      return;
+   }
+   VG_(close)(fd);
+
+   hdr = (TCFileHeader*)tc_image;
+   if (VG_(memcmp)(hdr->magic, TC_MAGIC, 8) != 0
+       || hdr->version != TC_VERSION
+       || hdr->config_hash != tc_config_hash) {
+      VG_(debugLog)(1, "transcache", "ignoring stale cache file %s\n",
+                    tc_filename);
+      VG_(free)(tc_image);
+      tc_image = NULL;
+      return;
+   }
+
+   off = sizeof(TCFileHeader);
+   for (i = 0; i < hdr->n_entries; i++) {
+      TCFileEntry fe;
+      TCNode*     node;
+
+      if (off + sizeof(TCFileEntry) > size)
+         break;
+      VG_(memcpy)(&fe, tc_image + off, sizeof(TCFileEntry));
+      off += sizeof(TCFileEntry);
+      if (fe.te.code_len == 0 || fe.te.code_len >= 60000
+          || fe.te.vge.n_used < 1 || fe.te.vge.n_used > 3
+          || off + fe.te.code_len > size)
+         break;
+
+      node = VG_(malloc)("transcache.load.2", sizeof(TCNode));
+      node->key        = fe.te.nraddr;
+      node->guest_hash = fe.guest_hash;
+      node->owns_code  = False;
+      node->te         = fe.te;
+      node->te.code    = tc_image + off;
+      add_TCNode(node);
+      n_tc_loaded++;
+
+      off += VG_ROUNDUP(fe.te.code_len, 8);
+   }
+
+   VG_(debugLog)(1, "transcache", "loaded %lu translations from %s\n",
+                 n_tc_loaded, tc_filename);
+}
+
+/* Returns True if the translation cache is in use, initialising it
+   first if needed. */
+static Bool tc_enabled ( void )
+{
+   const HChar* dir;
+
+   if (LIKELY(tc_state != 0))
+      return tc_state > 0;
+
+   tc_state = -1;
+   dir = VG_(clo_translation_cache);
+   if (dir == NULL)
+      return False;
+   if (!VG_(needs).cacheable_translations) {
+      VG_(umsg)("Warning: tool %s does not support --translation-cache; "
+                "ignoring it\n", VG_(clo_toolname));
+      return False;
+   }
+   if (!compute_config_hash(&tc_config_hash)) {
+      VG_(umsg)("Warning: cannot identify the tool executable; "
+                "ignoring --translation-cache\n");
+      return False;
+   }
+
+   tc_filename = VG_(malloc)("transcache.init.1",
+                             VG_(strlen)(dir) + VG_(strlen)(VG_(clo_toolname))
+                             + 64);
+   VG_(sprintf)(tc_filename, "%s/vgtc-%s-%016llx", dir, VG_(clo_toolname),
+                tc_config_hash);
+   tc_table = VG_(HT_construct)("transcache.table");
+   tc_state = 1;
+
+   load_cache_file();
+   return True;
+}
+
+const TransCacheEntry* VG_(transcache_lookup) ( Addr nraddr )
+{
+   TCNode* node;
+   ULong   hash;
+
+   if (!tc_enabled())
+      return NULL;
+
+   node = VG_(HT_lookup)(tc_table, nraddr);
+   if (node == NULL)
+      return NULL;
+
+   if (!hash_guest_bytes(&node->te.vge, &hash) || hash != node->guest_hash) {
+      /* The guest code has changed since the translation was made. */
+      node = VG_(HT_remove)(tc_table, nraddr);
+      free_TCNode(node);
+      n_tc_stale++;
+      return NULL;
+   }
+
+   n_tc_hits++;
+   return &node->te;
+}
+
+void VG_(transcache_add) ( const TransCacheEntry* te )
+{
+   TCNode* node;
+   UChar*  code;
+   ULong   hash;
+
+   if (!tc_enabled())
+      return;
+
+   if (!hash_guest_bytes(&te->vge, &hash))
+      return;
+
+   code = VG_(malloc)("transcache.add.1", te->code_len);
+   VG_(memcpy)(code, te->code, te->code_len);
+
+   node = VG_(malloc)("transcache.add.2", sizeof(TCNode));
+   node->key        = te->nraddr;
+   node->guest_hash = hash;
+   node->owns_code  = True;
+   node->te         = *te;
+   node->te.code    = code;
+   add_TCNode(node);
+   n_tc_added++;
+}
+
+void VG_(transcache_discard) ( Addr guest_start, ULong range )
+{
+   TCNode* node;
+   UInt    i;
+
+   if (tc_state <= 0 || range == 0)
+      return;
+   if (guest_start > tc_max_addr || guest_start + range <= tc_min_addr)
+      return;
+
+   VG_(HT_ResetIter)(tc_table);
+   while ((node = VG_(HT_Next)(tc_table))) {
+      for (i = 0; i < node->te.vge.n_used; i++) {
+         if (node->te.vge.base[i] < guest_start + range
+             && guest_start < node->te.vge.base[i] + node->te.vge.len[i])
+            break;
+      }
+      if (i < node->te.vge.n_used) {
+         VG_(HT_remove_at_Iter)(tc_table);
+         free_TCNode(node);
+         n_tc_discarded++;
+      }
+   }
+}
+
+/*------------------------------------------------------------*/
+/*--- Saving                                               ---*/
+/*------------------------------------------------------------*/
+
+static Bool write_all ( Int fd, const void* buf, SizeT n )
+{
+   const UChar* p = buf;
+   while (n > 0) {
+      Int chunk = n > 0x100000 ? 0x100000 : (Int)n;
+      Int w     = VG_(write)(fd, p, chunk);
+      if (w <= 0)
+         return False;
+      p += w;
+      n -= w;
+   }
+   return True;
+}
+
+void VG_(transcache_save) ( void )
+{
+   static const UChar zeroes[8] = { 0 };
+   TCFileHeader hdr;
+   TCNode*      node;
+   HChar*       tmpname;
+   SysRes       sr;
+   Int          fd;
+   Bool         ok;
+
+   if (tc_state <= 0)
+      return;
+   if (n_tc_added == 0 && n_tc_stale == 0 && n_tc_discarded == 0)
+      return;    /* file is already up to date */
+
+   /* Write to a temporary file and rename it, so that concurrent runs
+      never see a partially written file. */
+   tmpname = VG_(malloc)("transcache.save.1", VG_(strlen)(tc_filename) + 32);
+   VG_(sprintf)(tmpname, "%s.tmp%d", tc_filename, VG_(getpid)());
+   sr = VG_(open)(tmpname, VKI_O_CREAT|VKI_O_TRUNC|VKI_O_WRONLY,
+                  VKI_S_IRUSR|VKI_S_IWUSR);
+   if (sr_isError(sr)) {
+      VG_(umsg)("Warning: cannot create translation cache file %s\n",
+                tmpname);
+      VG_(free)(tmpname);
+      return;
+   }
+   fd = sr_Res(sr);
+
+   VG_(memcpy)(hdr.magic, TC_MAGIC, 8);
+   hdr.version     = TC_VERSION;
+   hdr.n_entries   = VG_(HT_count_nodes)(tc_table);
+   hdr.config_hash = tc_config_hash;
+   ok = write_all(fd, &hdr, sizeof(hdr));
+
+   VG_(HT_ResetIter)(tc_table);
+   while (ok && (node = VG_(HT_Next)(tc_table))) {
+      TCFileEntry fe;
+      VG_(memset)(&fe, 0, sizeof(fe));
+      fe.guest_hash = node->guest_hash;
+      fe.te         = node->te;
+      fe.te.code    = NULL;
+      ok = write_all(fd, &fe, sizeof(fe))
+           && write_all(fd, node->te.code, node->te.code_len)
+           && write_all(fd, zeroes,
+                        VG_ROUNDUP(node->te.code_len, 8) - node->te.code_len);
+      n_tc_saved++;
+   }
+   VG_(close)(fd);
+
+   if (ok && VG_(rename)(tmpname, tc_filename) == 0) {
+      VG_(debugLog)(1, "transcache", "saved %lu translations to %s\n",
+                    n_tc_saved, tc_filename);
+   } else {
+      VG_(umsg)("Warning: cannot write translation cache file %s\n",
+                tc_filename);
+      VG_(unlink)(tmpname);
+   }
+   VG_(free)(tmpname);
+}
+
+void VG_(transcache_print_stats) ( void )
+{
+   if (tc_state <= 0)
+      return;
+   VG_(message)(Vg_DebugMsg,
+                "transcache: %'lu loaded, %'lu used, %'lu stale, "
+                "%'lu added, %'lu discarded, %'lu saved\n",
+                n_tc_loaded, n_tc_hits, n_tc_stale,
+                n_tc_added, n_tc_discarded, n_tc_saved);
+}
+
+/*--------------------------------------------------------------------*/
+/*--- end                                                          ---*/
+/*--------------------------------------------------------------------*/
@@ -48,6 +48,7 @@
 
 #include "pub_core_translate.h"
 #include "pub_core_transtab.h"
+#include "pub_core_transcache.h"
 #include "pub_core_dispatch.h" // VG_(run_innerloop__dispatch_{un}profiled)
                                // VG_(run_a_noredir_translation__return_point)
 
@@ -68,6 +69,7 @@ static ULong n_TRACE_total_constructed              = 0;
 static ULong n_TRACE_total_guest_insns              = 0;
 static ULong n_TRACE_total_uncond_branches_followed = 0;
 static ULong n_TRACE_total_cond_branches_followed   = 0;
+static ULong n_hot_traces                           = 0;
 
 static ULong n_SP_updates_new_fast            = 0;
 static ULong n_SP_updates_new_generic_known   = 0;
@@ -89,6 +91,9 @@ void VG_(print_translation_stats) ( void )
        n_TRACE_total_guest_insns, n_TRACE_total_constructed,
        n_TRACE_total_uncond_branches_followed,
        n_TRACE_total_cond_branches_followed);
+   if (VG_(clo_hot_trace_threshold) > 0)
+      VG_(message)(Vg_DebugMsg, "translate: %'llu hot traces made\n",
+                   n_hot_traces);
    UInt n_SP_updates = n_SP_updates_new_fast + n_SP_updates_new_generic_known
                      + n_SP_updates_die_fast + n_SP_updates_die_generic_known
                      + n_SP_updates_generic_unknown;
@@ -212,12 +217,18 @@ static void update_SP_aliases(Long delta)
 /* Given a guest IP, get an origin tag for a 1-element stack trace,
    and wrap it up in an IR atom that can be passed as the origin-tag
    value for a stack-adjustment helper function. */
+/* Set when the translation being made contains something that is only
+   meaningful in this run, and so must not be given to m_transcache. */
+static Bool translation_is_run_specific = False;
+
 static IRExpr* mk_ecu_Expr ( Addr guest_IP )
 {
    UInt ecu;
    ExeContext* ec
       = VG_(make_depth_1_ExeContext_from_Addr)( guest_IP );
    vg_assert(ec);
+   /* ECUs are only valid in this run. */
+   translation_is_run_specific = True;
    ecu = VG_(get_ECU_from_ExeContext)( ec );
    vg_assert(VG_(is_plausible_ECU)(ecu));
    /* This is always safe to do, since ecu is only 32 bits, and
@@ -238,18 +249,23 @@ IRSB* tool_instrument_then_gdbserver_if_needed ( VgCallbackClosure* closureV,
                                                  IRType             gWordTy, 
                                                  IRType             hWordTy )
 {
-   return VG_(instrument_for_gdbserver_if_needed)
-      (VG_(tdict).tool_instrument (closureV,
-                                   sb_in,
-                                   layout,
-                                   vge,
-                                   vai,
-                                   gWordTy,
-                                   hWordTy),
+   IRSB* sb_tool = VG_(tdict).tool_instrument (closureV,
+                                               sb_in,
+                                               layout,
+                                               vge,
+                                               vai,
+                                               gWordTy,
+                                               hWordTy);
+   IRSB* sb_out = VG_(instrument_for_gdbserver_if_needed)
+      (sb_tool,
        layout,
        vge,
        gWordTy,
-       hWordTy);                                   
+       hWordTy);
+   /* Breakpoints and single stepping are specific to this run. */
+   if (sb_out != sb_tool)
+      translation_is_run_specific = True;
+   return sb_out;
 }
 
 /* For tools that want to know about SP changes, this pass adds
@@ -806,6 +822,11 @@ static Bool translations_allowable_from_seg ( NSegment const* seg, Addr addr )
    VexTranslateArgs::needs_self_check for more details about the
    return convention. */
 
+/* The results of the last call to needs_self_check, recorded for
+   m_transcache. */
+static UInt               last_self_check_bitset;
+static VexRegisterUpdates last_self_check_px;
+
 static UInt needs_self_check ( void* closureV,
                                /*MAYBE_MOD*/VexRegisterUpdates* pxControl,
                                const VexGuestExtents* vge )
@@ -930,6 +951,9 @@ static UInt needs_self_check ( void* closureV,
 
    }
 
+   last_self_check_bitset = bitset;
+   last_self_check_px     = *pxControl;
+
    /* Update running PX stats, as it is difficult without these to
       check that the system is behaving as expected. */
    switch (*pxControl) {
@@ -1005,6 +1029,44 @@ static Bool chase_into_ok ( void* closureV, Addr addr )
 }
 
 
+/* Set while VG_(retranslate_hot_SBs) is making a hot trace. */
+static Bool making_hot_trace = False;
+
+/* Entry count of the translation at addr, as a guide to how often
+   control reaches addr.  The translation being replaced has been
+   discarded already, but we know it is hot. */
+static ULong hot_trace_entry_count ( const VgCallbackClosure* closure,
+                                     Addr addr )
+{
+   ULong count = 0;
+   if (addr == closure->nraddr)
+      return VG_(clo_hot_trace_threshold);
+   if (!VG_(get_SB_entry_count)( addr, &count ))
+      return 0;
+   return count;
+}
+
+/* This is a callback passed to LibVEX_Translate when making a hot
+   trace.  It tells Vex which way to extend the superblock at a
+   conditional branch, by comparing how often each of the two
+   successors has been entered.  Follow one only if it is clearly the
+   more frequent. */
+static Int guess_hot_successor ( void* closureV, Addr sx, Addr ft )
+{
+   VgCallbackClosure* closure = (VgCallbackClosure*)closureV;
+   ULong n_sx = hot_trace_entry_count( closure, sx );
+   ULong n_ft = hot_trace_entry_count( closure, ft );
+
+   if (0) VG_(printf)("hot trace 0x%lx: sx 0x%lx %llu, ft 0x%lx %llu\n",
+                      closure->nraddr, sx, n_sx, ft, n_ft);
+   if (n_sx > 2 * n_ft)
+      return 1;
+   if (n_ft > 2 * n_sx)
+      return 0;
+   return -1;
+}
+
+
 /* --------------- helpers for with-TOC platforms --------------- */
 
 /* NOTE: with-TOC platforms are: ppc64-linux. */
@@ -1480,6 +1542,57 @@ typedef
    }
    T_Kind;
 
+/* Try to use a translation of NRADDR saved by an earlier run, instead
+   of making a new one.  The saved translation is only used if it would
+   be identical to the one VG_(translate) would make now: same
+   redirection, same self-check decisions and same chasing decisions,
+   and no gdbserver instrumentation needed.  Returns True if the saved
+   translation was added to the transtab. */
+static Bool add_translation_from_transcache ( ThreadId tid,
+                                              Addr nraddr, Addr addr,
+                                              T_Kind kind )
+{
+   const TransCacheEntry* te;
+   VgCallbackClosure      closure;
+   VexRegisterUpdates     px;
+   UInt                   i;
+
+   te = VG_(transcache_lookup)( nraddr );
+   if (te == NULL || te->addr != addr || te->kind != kind)
+      return False;
+
+   closure.tid    = tid;
+   closure.nraddr = nraddr;
+   closure.readdr = addr;
+
+   px = VG_(clo_vex_control).iropt_register_updates_default;
+   if (needs_self_check( &closure, &px, &te->vge ) != te->sc_bitset
+       || px != te->px)
+      return False;
+
+   for (i = 1; i < te->vge.n_used; i++) {
+      if (!chase_into_ok( &closure, te->vge.base[i] ))
+         return False;
+   }
+
+   if (VG_(clo_vgdb) != Vg_VgdbNo
+       && VG_(gdbserver_instrumentation_needed)( &te->vge ) != Vg_VgdbNo)
+      return False;
+
+   for (i = 0; i < te->vge.n_used; i++) {
+      VG_(am_set_segment_hasT)( te->vge.base[i] );
+   }
+
+   VG_(add_to_transtab)( &te->vge,
+                         nraddr,
+                         (Addr)te->code,
+                         te->code_len,
+                         te->sc_bitset != 0,
+                         te->offs_profInc,
+                         te->n_guest_instrs );
+   return True;
+}
+
 /* Translate the basic block beginning at NRADDR, and add it to the
    translation cache & translation table.  Unless
    DEBUGGING_TRANSLATION is true, in which case the call is being done
@@ -1649,6 +1762,14 @@ Bool VG_(translate) ( ThreadId tid,
       verbosity = VG_(clo_trace_flags);
    }
 
+   /* Maybe an earlier run already made this translation.  Not if a hot
+      trace is wanted instead of it, though. */
+   if (!debugging_translation && verbosity == 0 && kind != T_NoRedir
+       && !making_hot_trace
+       && VG_(clo_translation_cache) != NULL
+       && add_translation_from_transcache( tid, nraddr, addr, kind ))
+      return True;
+
    /* Figure out which preamble-mangling callback to send. */
    preamble_fn = NULL;
    if (kind == T_Redir_Replace)
@@ -1770,6 +1891,7 @@ Bool VG_(translate) ( ThreadId tid,
    vta.guest_bytes      = (UChar*)addr;
    vta.guest_bytes_addr = addr;
    vta.chase_into_ok    = chase_into_ok;
+   vta.guess_hot_successor = making_hot_trace ? guess_hot_successor : NULL;
    vta.guest_extents    = &vge;
    vta.host_bytes       = tmpbuf;
    vta.host_bytes_size  = N_TMPBUF;
@@ -1802,7 +1924,10 @@ Bool VG_(translate) ( ThreadId tid,
    vta.preamble_function = preamble_fn;
    vta.traceflags        = verbosity;
    vta.sigill_diag       = VG_(clo_sigill_diag);
-   vta.addProfInc        = VG_(clo_profyle_sbs) && kind != T_NoRedir;
+   vta.addProfInc        = (VG_(clo_profyle_sbs)
+                            || (VG_(clo_hot_trace_threshold) > 0
+                                && !making_hot_trace))
+                           && kind != T_NoRedir;
 
    /* Set up the dispatch continuation-point info.  If this is a
       no-redir translation then it cannot be chained, and the chain-me
@@ -1833,6 +1958,7 @@ Bool VG_(translate) ( ThreadId tid,
       = VG_(fnptr_to_fnentry)( &VG_(disp_cp_xassisted) );
 
    /* Sheesh.  Finally, actually _do_ the translation! */
+   translation_is_run_specific = False;
    tres = LibVEX_Translate ( &vta );
 
    vg_assert(tres.status == VexTransOK);
@@ -1872,6 +1998,26 @@ Bool VG_(translate) ( ThreadId tid,
                                 tres.n_sc_extents > 0,
                                 tres.offs_profInc,
                                 tres.n_guest_instrs );
+
+          /* Hot traces follow the branch profile of this run, and
+             have no entry counter: a later run must count the entries
+             of the translation they replaced, not reuse them. */
+          if (VG_(clo_translation_cache) != NULL
+              && verbosity == 0 && !translation_is_run_specific
+              && !making_hot_trace) {
+             TransCacheEntry te;
+             te.nraddr         = nraddr;
+             te.addr           = addr;
+             te.kind           = kind;
+             te.sc_bitset      = last_self_check_bitset;
+             te.px             = last_self_check_px;
+             te.offs_profInc   = tres.offs_profInc;
+             te.n_guest_instrs = tres.n_guest_instrs;
+             te.code_len       = tmpbuf_used;
+             te.vge            = vge;
+             te.code           = &tmpbuf[0];
+             VG_(transcache_add)( &te );
+          }
       } else {
           vg_assert(tres.offs_profInc == -1); /* -1 == unset */
           VG_(add_to_unredir_transtab)( &vge,
@@ -1884,6 +2030,34 @@ Bool VG_(translate) ( ThreadId tid,
    return True;
 }
 
+
+/* Make hot traces for translations which have been entered at least
+   --hot-trace-threshold times.  Each such translation is discarded
+   and made again, this time extending the superblock along the more
+   frequently taken side of conditional branches, as far as the usual
+   limits on superblock size allow. */
+void VG_(retranslate_hot_SBs) ( ThreadId tid, ULong bbs_done )
+{
+#  define N_HOT_PER_CALL 16
+   Addr hot[N_HOT_PER_CALL];
+   UInt i, n_hot;
+
+   vg_assert(VG_(clo_hot_trace_threshold) > 0);
+   n_hot = VG_(get_hot_SBs)( VG_(clo_hot_trace_threshold),
+                             hot, N_HOT_PER_CALL );
+   for (i = 0; i < n_hot; i++) {
+      VG_(discard_SB)( hot[i] );
+      making_hot_trace = True;
+      Bool ok = VG_(translate)( tid, hot[i], False, 0, bbs_done, True );
+      making_hot_trace = False;
+      if (ok) {
+         VG_(mark_SB_hot)( hot[i] );
+         n_hot_traces++;
+      }
+   }
+#  undef N_HOT_PER_CALL
+}
+
 /*--------------------------------------------------------------------*/
 /*--- end                                                          ---*/
 /*--------------------------------------------------------------------*/
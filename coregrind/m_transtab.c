@@ -38,6 +38,7 @@
 #include "pub_core_options.h"
 #include "pub_core_tooliface.h"  // For VG_(details).avg_translation_sizeB
 #include "pub_core_transtab.h"
+#include "pub_core_transcache.h" // VG_(transcache_discard)
 #include "pub_core_aspacemgr.h"
 #include "pub_core_mallocfree.h" // VG_(out_of_memory_NORETURN)
 #include "pub_core_xarray.h"
@@ -171,9 +172,12 @@ typedef
                itself and computed once when the translation is created.
                Count is an entry count for the translation and is
                incremented by 1 every time the translation is used, if we
-               are profiling. */
+               are profiling, or looking for hot traces.  Hot is set
+               for hot traces, which are not counted and are never
+               made again. */
             ULong    count;
             UShort   weight;
+            Bool     hot;
          } prof; // if status == InUse
          TTEno next_empty_tte; // if status != InUse
       } usage;
@@ -484,8 +488,17 @@ typedef
    }
    FastCacheSet;
 */
+#if defined(VG_TT_FAST_TUNABLE)
+/*global*/ FastCacheSet* VG_(tt_fast) = NULL;
+#else
 /*global*/ __attribute__((aligned(64)))
            FastCacheSet VG_(tt_fast)[VG_TT_FAST_SETS];
+#endif
+/*global*/ UInt  VG_(tt_fast_bits) = VG_TT_FAST_BITS;
+/*global*/ UWord VG_(tt_fast_mask) = VG_TT_FAST_MASK;
+
+/* Nr of fast cache sets provided via command line parameter. */
+UInt VG_(clo_fast_cache_sets) = VG_TT_FAST_SETS;
 
 /* Make sure we're not used before initialisation. */
 static Bool init_done = False;
@@ -493,9 +506,11 @@ static Bool init_done = False;
 
 /*------------------ STATS DECLS ------------------*/
 
-/* Number of fast-cache updates and flushes done. */
-static ULong n_fast_flushes = 0;
-static ULong n_fast_updates = 0;
+/* Number of fast-cache updates and flushes done, and number of valid
+   entries evicted from the fast-cache by updates. */
+static ULong n_fast_flushes  = 0;
+static ULong n_fast_updates  = 0;
+static ULong n_fast_evictions = 0;
 
 /* Number of full lookups done. */
 static ULong n_full_lookups = 0;
@@ -1463,7 +1478,7 @@ static inline HTTno HASH_TT ( Addr key )
 /* Invalidate the fast cache VG_(tt_fast). */
 static void invalidateFastCache ( void )
 {
-   for (UWord j = 0; j < VG_TT_FAST_SETS; j++) {
+   for (UWord j = 0; j <= VG_(tt_fast_mask); j++) {
       FastCacheSet* set = &VG_(tt_fast)[j];
       set->guest0 = TRANSTAB_BOGUS_GUEST_ADDR;
       set->guest1 = TRANSTAB_BOGUS_GUEST_ADDR;
@@ -1511,6 +1526,8 @@ static void setFastCacheEntry ( Addr guest, ULong* tcptr )
       new entry at the MRU position. */
    UWord setNo = (UInt)VG_TT_FAST_HASH(guest);
    FastCacheSet* set = &VG_(tt_fast)[setNo];
+   if (set->guest3 != TRANSTAB_BOGUS_GUEST_ADDR)
+      n_fast_evictions++;
    set->host3  = set->host2;
    set->guest3 = set->guest2;
    set->host2  = set->host1;
@@ -1833,6 +1850,7 @@ void VG_(add_to_transtab)( const VexGuestExtents* vge,
    TTEntryH__init(&sectors[y].ttH[tteix]);
    sectors[y].ttC[tteix].tcptr  = tcptr;
    sectors[y].ttC[tteix].usage.prof.count  = 0;
+   sectors[y].ttC[tteix].usage.prof.hot    = False;
 
    sectors[y].ttC[tteix].usage.prof.weight
       = False
@@ -2196,6 +2214,9 @@ void VG_(discard_translations) ( Addr guest_start, ULong range,
    if (range == 0)
       return;
 
+   /* Saved translations of the range must not be used again either. */
+   VG_(transcache_discard)(guest_start, range);
+
    VexArch     arch_host = VexArch_INVALID;
    VexArchInfo archinfo_host;
    VG_(bzero_inline)(&archinfo_host, sizeof(archinfo_host));
@@ -2311,6 +2332,29 @@ void VG_(discard_translations) ( Addr guest_start, ULong range,
    }
 }
 
+/* Discard just the translation whose entry point is guest_addr, if
+   there is one.  Unlike VG_(discard_translations), other translations
+   of the same guest code are left alone. */
+void VG_(discard_SB) ( Addr guest_addr )
+{
+   SECno sno;
+   TTEno tteno;
+   Addr  ga_deleted = TRANSTAB_BOGUS_GUEST_ADDR;
+
+   if (!VG_(search_transtab)( NULL, &sno, &tteno, guest_addr, False ))
+      return;
+
+   VexArch     arch_host = VexArch_INVALID;
+   VexArchInfo archinfo_host;
+   VG_(bzero_inline)(&archinfo_host, sizeof(archinfo_host));
+   VG_(machine_get_VexArchInfo)( &arch_host, &archinfo_host );
+   VexEndness endness_host = archinfo_host.endness;
+
+   delete_tte( &ga_deleted, &sectors[sno], sno, tteno,
+               arch_host, endness_host );
+   invalidateFastCacheEntry( guest_addr );
+}
+
 /* Whether or not tools may discard translations. */
 Bool  VG_(ok_to_discard_translations) = False;
 
@@ -2323,6 +2367,21 @@ void VG_(discard_translations_safely) ( Addr  start, SizeT len,
    VG_(discard_translations)(start, len, who);
 }
 
+const HChar* VG_(pending_discard_all_who) = NULL;
+
+void VG_(discard_all_translations_soon) ( const HChar* who )
+{
+   VG_(pending_discard_all_who) = who;
+}
+
+void VG_(discard_pending_translations) ( void )
+{
+   const HChar* who = VG_(pending_discard_all_who);
+   vg_assert(who != NULL);
+   VG_(pending_discard_all_who) = NULL;
+   VG_(discard_translations)(0, (ULong)(-1ll), who);
+}
+
 /*------------------------------------------------------------*/
 /*--- AUXILIARY: the unredirected TT/TC                    ---*/
 /*------------------------------------------------------------*/
@@ -2518,9 +2577,11 @@ void VG_(init_tt_tc) ( void )
    /* check fast cache entries really are 8 words long */
    vg_assert(sizeof(Addr) == sizeof(void*));
    vg_assert(sizeof(FastCacheSet) == 8 * sizeof(Addr));
+#  if !defined(VG_TT_FAST_TUNABLE)
    /* check fast cache entries are packed back-to-back with no spaces */
    vg_assert(sizeof( VG_(tt_fast) ) 
              == VG_TT_FAST_SETS * sizeof(FastCacheSet));
+#  endif
    /* check fast cache entries have the layout that the handwritten assembly
       fragments assume. */
    vg_assert(sizeof(FastCacheSet) == (1 << VG_FAST_CACHE_SET_BITS));
@@ -2541,6 +2602,31 @@ void VG_(init_tt_tc) ( void )
    vg_assert(offsetof(FastCacheSet,guest3) == 6 * sizeof(Addr));
    vg_assert(offsetof(FastCacheSet,host3)  == 7 * sizeof(Addr));
 
+   /* Set up the fast cache with the requested number of sets.  The
+      number of sets was checked to be a power of 2 in the allowed
+      range, and on targets where the size is fixed, to be the
+      default, when parsing the command line. */
+   VG_(tt_fast_bits) = 0;
+   while ((1U << VG_(tt_fast_bits)) < VG_(clo_fast_cache_sets))
+      VG_(tt_fast_bits)++;
+   vg_assert((1U << VG_(tt_fast_bits)) == VG_(clo_fast_cache_sets));
+   vg_assert(VG_(tt_fast_bits) >= VG_TT_FAST_MIN_BITS
+             && VG_(tt_fast_bits) <= VG_TT_FAST_MAX_BITS);
+   VG_(tt_fast_mask) = VG_(clo_fast_cache_sets) - 1;
+#  if defined(VG_TT_FAST_TUNABLE)
+   {
+      SizeT  szB  = VG_(clo_fast_cache_sets) * sizeof(FastCacheSet);
+      SysRes sres = VG_(am_mmap_anon_float_valgrind)( szB );
+      if (sr_isError(sres)) {
+         VG_(out_of_memory_NORETURN)("VG_(init_tt_tc)(fast cache)", szB);
+         /*NOTREACHED*/
+      }
+      VG_(tt_fast) = (FastCacheSet*)(Addr)sr_Res(sres);
+   }
+#  else
+   vg_assert(VG_(tt_fast_bits) == VG_TT_FAST_BITS);
+#  endif
+
    /* check fast cache is aligned as we requested.  Not fatal if it
       isn't, but we might as well make sure. */
    vg_assert(VG_IS_64_ALIGNED( ((Addr) & VG_(tt_fast)[0]) ));
@@ -2680,8 +2766,10 @@ void VG_(print_tt_tc_stats) ( void )
       "    tt/tc: %'llu tt lookups requiring %'llu probes\n",
       n_full_lookups, n_lookup_probes );
    VG_(message)(Vg_DebugMsg,
-      "    tt/tc: %'llu fast-cache updates, %'llu flushes\n",
-      n_fast_updates, n_fast_flushes );
+      "    tt/tc: %'llu fast-cache updates, %'llu evictions, %'llu flushes"
+      " (%'lu sets)\n",
+      n_fast_updates, n_fast_evictions, n_fast_flushes,
+      VG_(tt_fast_mask) + 1 );
 
    VG_(message)(Vg_DebugMsg,
                 " transtab: new        %'llu "
@@ -2787,6 +2875,55 @@ ULong VG_(get_SB_profile) ( SBProfEntry tops[], UInt n_tops )
    return score_total;
 }
 
+/*------------------------------------------------------------*/
+/*--- Finding hot translations.                            ---*/
+/*------------------------------------------------------------*/
+
+Bool VG_(get_SB_entry_count) ( Addr guest_addr, /*OUT*/ULong* count )
+{
+   SECno sno;
+   TTEno tteno;
+   if (!VG_(search_transtab)( NULL, &sno, &tteno, guest_addr, False ))
+      return False;
+   const TTEntryC* tteC = &sectors[sno].ttC[tteno];
+   /* Hot traces are not counted, but were hot when made. */
+   *count = tteC->usage.prof.hot ? VG_(clo_hot_trace_threshold)
+                                 : tteC->usage.prof.count;
+   return True;
+}
+
+UInt VG_(get_hot_SBs) ( ULong threshold, /*OUT*/Addr res[], UInt n_res )
+{
+   SECno sno;
+   TTEno i;
+   UInt  n = 0;
+
+   vg_assert(threshold > 0);
+   for (sno = 0; sno < n_sectors; sno++) {
+      if (sectors[sno].tc == NULL)
+         continue;
+      for (i = 0; i < N_TTES_PER_SECTOR; i++) {
+         if (sectors[sno].ttH[i].status != InUse)
+            continue;
+         const TTEntryC* tteC = &sectors[sno].ttC[i];
+         if (tteC->usage.prof.hot || tteC->usage.prof.count < threshold)
+            continue;
+         res[n++] = tteC->entry;
+         if (n == n_res)
+            return n;
+      }
+   }
+   return n;
+}
+
+void VG_(mark_SB_hot) ( Addr guest_addr )
+{
+   SECno sno;
+   TTEno tteno;
+   if (VG_(search_transtab)( NULL, &sno, &tteno, guest_addr, False ))
+      sectors[sno].ttC[tteno].usage.prof.hot = True;
+}
+
 /*--------------------------------------------------------------------*/
 /*--- end                                                          ---*/
 /*--------------------------------------------------------------------*/
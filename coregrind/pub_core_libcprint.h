@@ -66,6 +66,19 @@ extern void VG_(print_preamble)(Bool logging_to_fd);
 
 extern void VG_(logging_atfork_child)(ThreadId tid);
 
+/* Output sent to the log and XML sinks between these two calls is
+   held back and written out in large chunks.  Calls may be nested.
+   Used while printing errors. */
+extern void VG_(start_deferred_output) ( void );
+extern void VG_(end_deferred_output) ( void );
+
+/* Write out any held back output.  This must be done before anything
+   outside Valgrind can see the sinks, eg. before each client system
+   call, and is cheap when there is nothing to write. */
+extern void VG_(flush_deferred_output) ( void );
+
+extern void VG_(print_deferred_output_stats) ( void );
+
 /* Get the elapsed wallclock time since startup into buf which has size
    bufsize. The function will assert if bufsize is not large enough.
    Upon return, buf will contain the zero-terminated wallclock time as
@@ -183,6 +183,10 @@ extern UChar VG_(clo_profyle_flags);
    profiling results only at the end of the run. */
 extern ULong VG_(clo_profyle_interval);
 
+/* Remake as a hot trace each translation entered at least this many
+   times.  default: zero (== never) */
+extern ULong VG_(clo_hot_trace_threshold);
+
 /* DEBUG: if tracing codegen, be quiet until after this bb */
 extern Int   VG_(clo_trace_notbelow);
 /* DEBUG: if tracing codegen, be quiet after this bb  */
@@ -336,6 +340,14 @@ extern UInt VG_(clo_num_transtab_sectors);
    provided default. */
 extern UInt VG_(clo_avg_transtab_entry_size);
 
+/* Number of sets of the fast translation lookup cache VG_(tt_fast). */
+extern UInt VG_(clo_fast_cache_sets);
+
+/* Directory in which translations are saved at exit and from which
+   they are reloaded by later runs, or NULL if no translation cache is
+   to be used. */
+extern const HChar* VG_(clo_translation_cache);
+
 /* Only client requested fixed mapping can be done below 
    VG_(clo_aspacem_minAddr). */
 extern Addr VG_(clo_aspacem_minAddr);
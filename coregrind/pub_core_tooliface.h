@@ -93,6 +93,7 @@ typedef
       Bool malloc_replacement;
       Bool xml_output;
       Bool final_IR_tidy_pass;
+      Bool cacheable_translations;
    } 
    VgNeeds;
 
@@ -130,6 +131,7 @@ typedef struct {
    SizeT (*tool_get_extra_suppression_info)  (const Error*,/*OUT*/HChar*,Int);
    SizeT (*tool_print_extra_suppression_use) (const Supp*,/*OUT*/HChar*,Int);
    void  (*tool_update_extra_suppression_use) (const Error*, const Supp*);
+   UWord (*tool_hash_Error)                  (const Error*);
 
    // VG_(needs).superblock_discards
    void (*tool_discard_superblock_info)(Addr, VexGuestExtents);
@@ -186,6 +188,8 @@ typedef struct {
    void (*track_new_mem_mmap)        (Addr, SizeT, Bool, Bool, Bool, ULong);
 
    void (*track_copy_mem_remap)      (Addr src, Addr dst, SizeT);
+   void (*track_move_mem_remap)      (Addr src, Addr dst, SizeT);
+   void (*track_discard_mem_madvise) (Addr, SizeT);
    void (*track_change_mem_mprotect) (Addr, SizeT, Bool, Bool, Bool);
    void (*track_die_mem_stack_signal)(Addr, SizeT);
    void (*track_die_mem_brk)         (Addr, SizeT);
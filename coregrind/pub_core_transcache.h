@@ -0,0 +1,81 @@
+
+/*--------------------------------------------------------------------*/
+/*--- Persistent translation cache.          pub_core_transcache.h ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Valgrind, a dynamic binary instrumentation
+   framework.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, see <http://www.gnu.org/licenses/>.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#ifndef __PUB_CORE_TRANSCACHE_H
+#define __PUB_CORE_TRANSCACHE_H
+
+//--------------------------------------------------------------------
+// PURPOSE: This module saves translations to a file at exit, when
+// --translation-cache=<dir> is given, and gives them back to
+// m_translate in later runs, so that unchanged guest code does not
+// have to be translated again.
+//--------------------------------------------------------------------
+
+#include "pub_core_basics.h"
+#include "libvex.h"                   // VexGuestExtents
+
+/* A translation as produced by VG_(translate), with everything needed
+   to give it to VG_(add_to_transtab) again.  'code' is the unchained
+   host code: chaining is done as usual, once the translation is in
+   the transtab. */
+typedef
+   struct {
+      Addr            nraddr;         /* non-redirected guest address */
+      Addr            addr;           /* guest address translated */
+      UInt            kind;           /* translation kind, see m_translate */
+      UInt            sc_bitset;      /* extents with a self check */
+      UInt            px;             /* VexRegisterUpdates used */
+      Int             offs_profInc;
+      UInt            n_guest_instrs;
+      UInt            code_len;
+      VexGuestExtents vge;
+      const UChar*    code;
+   }
+   TransCacheEntry;
+
+/* Returns the saved translation for nraddr, provided the guest code
+   it was made from is still the same, or NULL.  The caller must still
+   check that the rest of the entry is valid for the current state of
+   the run (redirections, self-check requirements, ...). */
+extern const TransCacheEntry* VG_(transcache_lookup) ( Addr nraddr );
+
+/* Record a translation just made by VG_(translate), to be saved at
+   exit.  Replaces any saved translation for the same nraddr. */
+extern void VG_(transcache_add) ( const TransCacheEntry* te );
+
+/* Forget the saved translations intersecting the given guest range.
+   Called by VG_(discard_translations). */
+extern void VG_(transcache_discard) ( Addr guest_start, ULong range );
+
+/* Write the saved translations to the cache file. */
+extern void VG_(transcache_save) ( void );
+
+extern void VG_(transcache_print_stats) ( void );
+
+#endif   // __PUB_CORE_TRANSCACHE_H
+
+/*--------------------------------------------------------------------*/
+/*--- end                                                          ---*/
+/*--------------------------------------------------------------------*/
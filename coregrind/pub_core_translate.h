@@ -44,6 +44,8 @@ Bool VG_(translate) ( ThreadId tid,
                       ULong    bbs_done,
                       Bool     allow_redirection );
 
+extern void VG_(retranslate_hot_SBs) ( ThreadId tid, ULong bbs_done );
+
 extern void VG_(print_translation_stats) ( void );
 
 #endif   // __PUB_CORE_TRANSLATE_H
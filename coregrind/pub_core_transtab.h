@@ -59,8 +59,18 @@ typedef
 STATIC_ASSERT(sizeof(Addr) == sizeof(UWord));
 STATIC_ASSERT(sizeof(FastCacheSet) == sizeof(Addr) * 8);
 
+#if defined(VG_TT_FAST_TUNABLE)
+extern FastCacheSet* VG_(tt_fast);
+#else
 extern __attribute__((aligned(64)))
        FastCacheSet VG_(tt_fast) [VG_TT_FAST_SETS];
+#endif
+
+/* The number of bits of the set number and the corresponding mask.
+   These are VG_TT_FAST_BITS and VG_TT_FAST_MASK unless changed by
+   --fast-cache-sets. */
+extern UInt  VG_(tt_fast_bits);
+extern UWord VG_(tt_fast_mask);
 
 #define TRANSTAB_BOGUS_GUEST_ADDR ((Addr)1)
 
@@ -68,16 +78,16 @@ extern __attribute__((aligned(64)))
 static inline UWord VG_TT_FAST_HASH ( Addr guest ) {
    // There's no minimum insn alignment on these targets.
    UWord merged = ((UWord)guest) >> 0;
-   merged = (merged >> VG_TT_FAST_BITS) ^ merged;
-   return merged & VG_TT_FAST_MASK;
+   merged = (merged >> VG_(tt_fast_bits)) ^ merged;
+   return merged & VG_(tt_fast_mask);
 }
 
 #elif defined(VGA_s390x) || defined(VGA_arm) || defined(VGA_nanomips)
 static inline UWord VG_TT_FAST_HASH ( Addr guest ) {
    // Instructions are 2-byte aligned.
    UWord merged = ((UWord)guest) >> 1;
-   merged = (merged >> VG_TT_FAST_BITS) ^ merged;
-   return merged & VG_TT_FAST_MASK;
+   merged = (merged >> VG_(tt_fast_bits)) ^ merged;
+   return merged & VG_(tt_fast_mask);
 }
 
 #elif defined(VGA_ppc32) || defined(VGA_ppc64be) || defined(VGA_ppc64le) \
@@ -86,8 +96,8 @@ static inline UWord VG_TT_FAST_HASH ( Addr guest ) {
 static inline UWord VG_TT_FAST_HASH ( Addr guest ) {
    // Instructions are 4-byte aligned.
    UWord merged = ((UWord)guest) >> 2;
-   merged = (merged >> VG_TT_FAST_BITS) ^ merged;
-   return merged & VG_TT_FAST_MASK;
+   merged = (merged >> VG_(tt_fast_bits)) ^ merged;
+   return merged & VG_(tt_fast_mask);
 }
 
 #else
@@ -199,6 +209,8 @@ extern Bool VG_(search_transtab) ( /*OUT*/Addr*  res_hcode,
 extern void VG_(discard_translations) ( Addr  start, ULong range,
                                         const HChar* who );
 
+extern void VG_(discard_SB) ( Addr guest_addr );
+
 extern void VG_(print_tt_tc_stats) ( void );
 
 extern UInt VG_(get_bbs_translated) ( void );
@@ -225,9 +237,30 @@ typedef struct _SBProfEntry {
 
 extern ULong VG_(get_SB_profile) ( SBProfEntry tops[], UInt n_tops );
 
+// Hot trace support (--hot-trace-threshold).  Entry counts are
+// maintained as for SB profiling, but are never reset.
+
+// Get the entry count of the translation for guest_addr, if any.
+extern Bool VG_(get_SB_entry_count) ( Addr guest_addr, /*OUT*/ULong* count );
+
+// Find up to n_res translations not yet marked as hot whose entry count
+// is at least threshold.  Returns how many were placed in res[].
+extern UInt VG_(get_hot_SBs) ( ULong threshold, /*OUT*/Addr res[],
+                               UInt n_res );
+
+// Mark the translation for guest_addr as hot, so that VG_(get_hot_SBs)
+// does not return it again.
+extern void VG_(mark_SB_hot) ( Addr guest_addr );
+
 //  Exported variables
 extern Bool  VG_(ok_to_discard_translations);
 
+/* Non-NULL if VG_(discard_all_translations_soon) was called, in which
+   case the scheduler must call VG_(discard_pending_translations) before
+   running client code again. */
+extern const HChar* VG_(pending_discard_all_who);
+extern void VG_(discard_pending_translations) ( void );
+
 #endif   // __PUB_CORE_TRANSTAB_H
 
 /*--------------------------------------------------------------------*/
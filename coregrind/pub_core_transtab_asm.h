@@ -72,12 +72,27 @@
    (address ^ (address >>u VG_TT_FAST_BITS))[VG_TT_FAST_BITS-1+1 : 0+1]'.
 
    On s390x the rightmost bit of an instruction address is zero, so the arm32
-   scheme is used. */
+   scheme is used.
+
+   On amd64, the number of sets can be changed with
+   --fast-cache-sets.  VG_TT_FAST_BITS, VG_TT_FAST_SETS and VG_TT_FAST_MASK
+   are then only the defaults: the cache is allocated at startup, and the
+   dispatchers use the run time values VG_(tt_fast), VG_(tt_fast_bits) and
+   VG_(tt_fast_mask).  On the other targets, VG_(tt_fast) is a statically
+   allocated array, and the dispatchers use the constants. */
 
 #define VG_TT_FAST_BITS 13
 #define VG_TT_FAST_SETS (1 << VG_TT_FAST_BITS)
 #define VG_TT_FAST_MASK ((VG_TT_FAST_SETS) - 1)
 
+#if defined(VGA_amd64)
+#  define VG_TT_FAST_TUNABLE 1
+#endif
+
+// Bounds for --fast-cache-sets, as log2 of the number of sets.
+#define VG_TT_FAST_MIN_BITS 8
+#define VG_TT_FAST_MAX_BITS 20
+
 // Log2(sizeof(FastCacheSet)).  This is needed in the handwritten assembly.
 
 #if defined(VGA_amd64) || defined(VGA_arm64) \
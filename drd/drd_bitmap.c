@@ -103,6 +103,9 @@ void DRD_(bm_init)(struct bitmap* const bm)
       bm->cache[i].bm2 = 0;
    }
    bm->oset = VG_(OSetGen_EmptyClone)(s_bm2_set_template);
+   bm->marked = NULL;
+   bm->marked_count = 0;
+   bm->marked_size = 0;
 
    s_bitmap_creation_count++;
 }
@@ -111,6 +114,8 @@ void DRD_(bm_init)(struct bitmap* const bm)
 void DRD_(bm_cleanup)(struct bitmap* const bm)
 {
    VG_(OSetGen_Destroy)(bm->oset);
+   if (bm->marked)
+      VG_(free)(bm->marked);
 }
 
 /**
@@ -955,10 +960,7 @@ Bool DRD_(bm_equal)(struct bitmap* const lhs, struct bitmap* const rhs)
 
    for ( ; (bm2l = VG_(OSetGen_Next)(lhs->oset)) != 0; )
    {
-      while (bm2l
-             && ! DRD_(bm_has_any_access)(lhs,
-                                          make_address(bm2l->addr, 0),
-                                          make_address(bm2l->addr + 1, 0)))
+      while (bm2l && bm2_is_empty(bm2l))
       {
          bm2l = VG_(OSetGen_Next)(lhs->oset);
       }
@@ -972,14 +974,9 @@ Bool DRD_(bm_equal)(struct bitmap* const lhs, struct bitmap* const rhs)
          if (bm2r == 0)
             return False;
       }
-      while (! DRD_(bm_has_any_access)(rhs,
-                                       make_address(bm2r->addr, 0),
-                                       make_address(bm2r->addr + 1, 0)));
+      while (bm2_is_empty(bm2r));
 
       tl_assert(bm2r);
-      tl_assert(DRD_(bm_has_any_access)(rhs,
-                                        make_address(bm2r->addr, 0),
-                                        make_address(bm2r->addr + 1, 0)));
 
       if (bm2l != bm2r
           && (bm2l->addr != bm2r->addr
@@ -992,24 +989,27 @@ Bool DRD_(bm_equal)(struct bitmap* const lhs, struct bitmap* const rhs)
    do
    {
       bm2r = VG_(OSetGen_Next)(rhs->oset);
-   } while (bm2r && ! DRD_(bm_has_any_access)(rhs,
-                                              make_address(bm2r->addr, 0),
-                                              make_address(bm2r->addr + 1, 0)));
+   } while (bm2r && bm2_is_empty(bm2r));
    if (bm2r)
-   {
-      tl_assert(DRD_(bm_has_any_access)(rhs,
-                                        make_address(bm2r->addr, 0),
-                                        make_address(bm2r->addr + 1, 0)));
       return False;
-   }
    return True;
 }
 
 void DRD_(bm_swap)(struct bitmap* const bm1, struct bitmap* const bm2)
 {
    OSet* const tmp = bm1->oset;
+   struct bitmap2** const tmp_marked = bm1->marked;
+   const UInt tmp_marked_count = bm1->marked_count;
+   const UInt tmp_marked_size = bm1->marked_size;
+
    bm1->oset = bm2->oset;
    bm2->oset = tmp;
+   bm1->marked = bm2->marked;
+   bm1->marked_count = bm2->marked_count;
+   bm1->marked_size = bm2->marked_size;
+   bm2->marked = tmp_marked;
+   bm2->marked_count = tmp_marked_count;
+   bm2->marked_size = tmp_marked_size;
 }
 
 /** Merge bitmaps *lhs and *rhs into *lhs. */
@@ -1043,17 +1043,18 @@ void DRD_(bm_merge2)(struct bitmap* const lhs, struct bitmap* const rhs)
    }
 }
 
-/** Clear bitmap2::recalc. */
+/**
+ * Clear bitmap2::recalc. Only the second-level bitmaps recorded in
+ * bitmap::marked[] have to be visited since DRD_(bm_mark)() is the only
+ * function that sets bitmap2::recalc.
+ */
 void DRD_(bm_unmark)(struct bitmap* bm)
 {
-   struct bitmap2* bm2;
+   UInt i;
 
-   for (VG_(OSetGen_ResetIter)(bm->oset);
-        (bm2 = VG_(OSetGen_Next)(bm->oset)) != 0;
-        )
-   {
-      bm2->recalc = False;
-   }
+   for (i = 0; i < bm->marked_count; i++)
+      bm->marked[i]->recalc = False;
+   bm->marked_count = 0;
 }
 
 /**
@@ -1073,7 +1074,7 @@ Bool DRD_(bm_is_marked)(struct bitmap* bm, const Addr a)
  * at least one access.
  *
  * @note Any new second-level bitmaps inserted in bml by this function are
- *       uninitialized.
+ *       empty.
  */
 void DRD_(bm_mark)(struct bitmap* bml, struct bitmap* bmr)
 {
@@ -1085,22 +1086,26 @@ void DRD_(bm_mark)(struct bitmap* bml, struct bitmap* bmr)
         )
    {
       bm2l = bm2_lookup_or_insert(bml, bm2r->addr);
+      if (bm2l->recalc)
+         continue;
       bm2l->recalc = True;
+      if (bml->marked_count == bml->marked_size)
+      {
+         bml->marked_size = bml->marked_size ? 2 * bml->marked_size : 64;
+         bml->marked = VG_(realloc)("drd.bitmap.bm.1", bml->marked,
+                                    bml->marked_size * sizeof(bml->marked[0]));
+      }
+      bml->marked[bml->marked_count++] = bm2l;
    }
 }
 
 /** Clear all second-level bitmaps for which bitmap2::recalc == True. */
 void DRD_(bm_clear_marked)(struct bitmap* bm)
 {
-   struct bitmap2* bm2;
+   UInt i;
 
-   for (VG_(OSetGen_ResetIter)(bm->oset);
-        (bm2 = VG_(OSetGen_Next)(bm->oset)) != 0;
-        )
-   {
-      if (bm2->recalc)
-         bm2_clear(bm2);
-   }
+   for (i = 0; i < bm->marked_count; i++)
+      bm2_clear(bm->marked[i]);
 }
 
 /** Merge the second level bitmaps from *rhs into *lhs for which recalc == True. */
@@ -1117,6 +1122,27 @@ void DRD_(bm_merge2_marked)(struct bitmap* const lhs, struct bitmap* const rhs)
 
    s_bitmap_merge_count++;
 
+   /*
+    * Walk whichever of the two sets is smaller: the marked second-level
+    * bitmaps of *lhs (the delta) or all second-level bitmaps of *rhs.
+    */
+   if (lhs->marked_count < VG_(OSetGen_Size)(rhs->oset))
+   {
+      UInt i;
+
+      for (i = 0; i < lhs->marked_count; i++)
+      {
+         bm2l = lhs->marked[i];
+         bm2r = VG_(OSetGen_Lookup)(rhs->oset, &bm2l->addr);
+         if (bm2r)
+         {
+            tl_assert(bm2l != bm2r);
+            bm2_merge(bm2l, bm2r);
+         }
+      }
+      return;
+   }
+
    VG_(OSetGen_ResetIter)(rhs->oset);
 
    for ( ; (bm2r = VG_(OSetGen_Next)(rhs->oset)) != 0; )
@@ -1133,20 +1159,18 @@ void DRD_(bm_merge2_marked)(struct bitmap* const lhs, struct bitmap* const rhs)
 /** Remove all marked second-level bitmaps that do not contain any access. */
 void DRD_(bm_remove_cleared_marked)(struct bitmap* bm)
 {
-   struct bitmap2* bm2;
+   UInt i, j;
 
-   VG_(OSetGen_ResetIter)(bm->oset);
-   for ( ; (bm2 = VG_(OSetGen_Next)(bm->oset)) != 0; )
+   for (i = j = 0; i < bm->marked_count; i++)
    {
-      const UWord a1 = bm2->addr;
-      if (bm2->recalc
-          && ! DRD_(bm_has_any_access(bm, make_address(a1, 0),
-                                      make_address(a1 + 1, 0))))
-      {
-         bm2_remove(bm, a1);
-         VG_(OSetGen_ResetIterAt)(bm->oset, &a1);
-      }
+      struct bitmap2* const bm2 = bm->marked[i];
+
+      if (bm2_is_empty(bm2))
+         bm2_remove(bm, bm2->addr);
+      else
+         bm->marked[j++] = bm2;
    }
+   bm->marked_count = j;
 }
 
 /**
@@ -1183,20 +1207,23 @@ int DRD_(bm_has_races)(struct bitmap* const lhs, struct bitmap* const rhs)
       bm1l = &bm2l->bm1;
       bm1r = &bm2r->bm1;
 
+      /*
+       * Compute the RW / WR / WW pattern for a whole UWord at once and only
+       * look at the individual addresses for which that pattern is non-zero.
+       */
       for (k = 0; k < BITMAP1_UWORD_COUNT; k++)
       {
+         UWord races = (bm1r->bm0_w[k] & (bm1l->bm0_r[k] | bm1l->bm0_w[k]))
+                       | (bm1l->bm0_w[k] & bm1r->bm0_r[k]);
          unsigned b;
-         for (b = 0; b < BITS_PER_UWORD; b++)
+
+         for (b = 0; races; b++, races >>= 1)
          {
-            UWord const access_mask
-               = ((bm1l->bm0_r[k] & bm0_mask(b)) ? LHS_R : 0)
-               | ((bm1l->bm0_w[k] & bm0_mask(b)) ? LHS_W : 0)
-               | ((bm1r->bm0_r[k] & bm0_mask(b)) ? RHS_R : 0)
-               | ((bm1r->bm0_w[k] & bm0_mask(b)) ? RHS_W : 0);
-            Addr const a = make_address(bm2l->addr, k * BITS_PER_UWORD | b);
-            if (HAS_RACE(access_mask) && ! DRD_(is_suppressed)(a, a + 1))
+            if (races & 1)
             {
-               return 1;
+               Addr const a = make_address(bm2l->addr, k * BITS_PER_UWORD | b);
+               if (! DRD_(is_suppressed)(a, a + 1))
+                  return 1;
             }
          }
       }
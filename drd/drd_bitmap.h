@@ -540,6 +540,18 @@ bm2_lookup_exclusive(struct bitmap* const bm, const UWord a1)
    return bm2;
 }
 
+/** Return True if and only if no access has been recorded in bm2. */
+static __inline__
+Bool bm2_is_empty(const struct bitmap2* const bm2)
+{
+   UWord any = 0;
+   unsigned k;
+
+   for (k = 0; k < BITMAP1_UWORD_COUNT; k++)
+      any |= bm2->bm1.bm0_r[k] | bm2->bm1.bm0_w[k];
+   return any == 0;
+}
+
 /** Clear the content of the second-level bitmap. */
 static __inline__
 void bm2_clear(struct bitmap2* const bm2)
@@ -556,7 +568,8 @@ void bm2_clear(struct bitmap2* const bm2)
  * @param bm bitmap pointer.
  * @param a1 client address shifted right by ADDR_LSB_BITS.
  *
- * @note bitmap2::recalc isn't initialized here on purpose.
+ * @note Only bitmap2::recalc is initialized here: DRD_(bm_unmark)() relies on
+ *       bitmap2::recalc == True implying membership of bitmap::marked[].
  */
 static __inline__
 struct bitmap2* bm2_insert(struct bitmap* const bm, const UWord a1)
@@ -571,6 +584,7 @@ struct bitmap2* bm2_insert(struct bitmap* const bm, const UWord a1)
 
    bm2 = VG_(OSetGen_AllocNode)(bm->oset, sizeof(*bm2));
    bm2->addr = a1;
+   bm2->recalc = False;
    VG_(OSetGen_Insert)(bm->oset, bm2);
 
    bm_update_cache(bm, a1, bm2);
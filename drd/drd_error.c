@@ -640,5 +640,6 @@ void DRD_(register_error_handlers)(void)
                           drd_get_error_name,
                           drd_get_extra_suppression_info,
                           drd_print_extra_suppression_use,
-                          drd_update_extra_suppresion_use);
+                          drd_update_extra_suppresion_use,
+                          NULL/*hash_Error*/);
 }
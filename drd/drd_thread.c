@@ -1512,9 +1512,15 @@ static void thread_compute_conflict_set(struct bitmap** conflict_set,
          if (j != tid && DRD_(IsValidDrdThreadId)(j)) {
             Segment* q;
 
-            for (q = DRD_(g_threadinfo)[j].sg_last; q; q = q->thr_prev) {
-               if (!DRD_(vc_lte)(&q->vc, &p->vc)
-                   && !DRD_(vc_lte)(&p->vc, &q->vc)) {
+            /*
+             * The vector clocks of the segments of a thread increase
+             * monotonically, so once a segment has been found that happens
+             * before p, all older segments of thread j happen before p too.
+             */
+            for (q = DRD_(g_threadinfo)[j].sg_last;
+                 q && !DRD_(vc_lte)(&q->vc, &p->vc);
+                 q = q->thr_prev) {
+               if (!DRD_(vc_lte)(&p->vc, &q->vc)) {
                   if (s_trace_conflict_set) {
                      HChar* str;
 
@@ -68,6 +68,10 @@ struct bitmap
 {
    struct bm_cache_elem cache[DRD_BITMAP_N_CACHE_ELEM];
    OSet*                oset;
+   /* Second-level bitmaps for which bitmap2::recalc == True. */
+   struct bitmap2**     marked;
+   UInt                 marked_count;
+   UInt                 marked_size;
 };
 
 
@@ -69,6 +69,8 @@ HChar* HG_(strdup) ( const HChar* cc, const HChar* s )
 
 Bool  HG_(clo_track_lockorders) = True;
 
+Bool  HG_(clo_lockorders_by_block) = False;
+
 Bool  HG_(clo_cmp_race_err_addrs) = False;
 
 UWord HG_(clo_history_level) = 2;
@@ -82,6 +84,8 @@ Bool  HG_(clo_delta_stacktrace) = False;
 
 UWord HG_(clo_conflict_cache_size) = 2000000;
 
+ULong HG_(clo_conflict_cache_mem) = 0;
+
 UWord HG_(clo_sanity_flags) = 0;
 
 Bool  HG_(clo_free_is_write) = False;
@@ -65,6 +65,12 @@ static inline Bool HG_(is_sane_ThreadId) ( ThreadId coretid ) {
    annoying. */
 extern Bool HG_(clo_track_lockorders);
 
+/* When checking lock orders, treat all the locks in a same heap block
+   (e.g. an array of locks) as a single lock.  This keeps the lock
+   order graph small when a program uses very many such locks, at the
+   cost of not checking the order between locks of the same block. */
+extern Bool HG_(clo_lockorders_by_block);
+
 /* When comparing race errors for equality, should the race address be
    taken into account?  For users, no, but for verification purposes
    (regtesting) this is sometimes important. */
@@ -107,6 +113,15 @@ extern Bool  HG_(clo_delta_stacktrace);
    amd 10 million.  Default is 1 million. */
 extern UWord HG_(clo_conflict_cache_size);
 
+/* When doing "full" history collection, an optional memory budget (in
+   bytes) for the conflicting-access history.  0 means unset, in which
+   case only --conflict-cache-size applies.  When set, the budget is
+   split between the previous-access map (whose size is then derived
+   from it, overriding --conflict-cache-size) and a compact second tier
+   holding accesses evicted from that map, so that far older conflicting
+   accesses can still be reported. */
+extern ULong HG_(clo_conflict_cache_mem);
+
 /* Sanity check level.  This is an or-ing of
    SCE_{THREADS,LOCKS,BIGRANGE,ACCESS,LAOG}. */
 extern UWord HG_(clo_sanity_flags);
@@ -162,6 +162,7 @@ typedef
       SO*           hbso;      /* associated SO */
       Addr          guestaddr; /* Guest address of lock */
       LockKind      kind;      /* what kind of lock this is */
+      UWord         laog_node; /* lock order graph node, 0 if none yet */
       /* USEFUL-DYNAMIC */
       Bool          heldW; 
       WordBag*      heldBy; /* bag of threads that hold this lock */
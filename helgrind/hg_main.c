@@ -213,6 +213,7 @@ static Lock* mk_LockN ( LockKind kind, Addr guestaddr ) {
    lock->hbso             = libhb_so_alloc();
    lock->guestaddr        = guestaddr;
    lock->kind             = kind;
+   lock->laog_node        = 0;
    lock->heldW            = False;
    lock->heldBy           = NULL;
    tl_assert(HG_(is_sane_LockN)(lock));
@@ -3505,11 +3506,14 @@ void evh__HG_RTLD_BIND_CLEAR(ThreadId tid, Int flags)
 /*--- Lock acquisition order monitoring                      ---*/
 /*--------------------------------------------------------------*/
 
-/* FIXME: here are some optimisations still to do in
-          laog__pre_thread_acquires_lock.
-
-   The graph is structured so that if L1 --*--> L2 then L1 must be
-   acquired before L2.
+/* The graph is structured so that if L1 --*--> L2 then L1 must be
+   acquired before L2.  Its nodes are normally the locks themselves.
+   With --lockorders-by-block=yes, all the locks in a same heap block
+   (typically an array of locks) share a single node, so that the
+   graph does not grow with the number of locks in such arrays.  The
+   order in which locks sharing a node are acquired is then not
+   checked.  The node of a lock is recorded in its .laog_node when it
+   is first acquired.
 
    The common case is that some thread T holds (eg) L1 L2 and L3 and
    is repeatedly acquiring and releasing Ln, and there is no ordering
@@ -3521,25 +3525,41 @@ void evh__HG_RTLD_BIND_CLEAR(ThreadId tid, Int flags)
    (2) adds edges {L1,L2,L3} --> Ln to laog, which are already present
        (because they already got added the first time T acquired Ln).
 
-   Hence cache these two events:
-
-   (1) Cache result of the query from last time.  Invalidate the cache
-       any time any edges are added to or deleted from laog.
-
-   (2) Cache these add-edge requests and ignore them if said edges
-       have already been added to laog.  Invalidate the cache any time
-       any edges are deleted from laog.
+   (2) is cheap, as adding an element already present in a WordSet
+   returns the same WordSet.  To make (1) cheap, and as long as laog
+   has no cycle, each node carries its position .ord in a topological
+   order of laog: for each edge X --> Y, X.ord < Y.ord.  Hence
+   Ln --*--> Li is only possible if Ln.ord < Li.ord, and a search only
+   needs to visit the nodes ordered before the last such Li.  In the
+   common case, there is no such Li, and no search is done at all.
+
+   The order is maintained incrementally as edges are added, following
+   Pearce and Kelly, "A Dynamic Topological Sort Algorithm for Directed
+   Acyclic Graphs" (2006).  Adding an edge consistent with the current
+   order costs nothing.  Otherwise, only the nodes ordered between the
+   two ends of the new edge and connected to them are visited and
+   renumbered.
+
+   An edge closing a cycle (i.e. for which a lock order error has just
+   been reported) is still added to laog, but there is then no
+   topological order, and searches visit everything reachable, as they
+   did before.  Once enough locks have been deleted, a full
+   topological sort is tried again.
 */
 
 typedef
    struct {
       WordSetID inns; /* in univ_laog */
       WordSetID outs; /* in univ_laog */
+      Word      ord;  /* position in the topological order */
+      UWord     mark; /* == laog_mark if visited by the current search */
+      UWord     nLocks;  /* if isBlock, nr of locks having this node */
+      Bool      isBlock; /* True: a heap block address, False: a Lock* */
    }
    LAOGLinks;
 
 /* lock order acquisition graph */
-static WordFM* laog = NULL; /* WordFM Lock* LAOGLinks* */
+static WordFM* laog = NULL; /* WordFM node LAOGLinks* */
 
 /* EXPOSITION ONLY: for each edge in 'laog', record the two places
    where that edge was created, so that we can show the user later if
@@ -3567,6 +3587,51 @@ static Word cmp_LAOGLinkExposition ( UWord llx1W, UWord llx2W ) {
 static WordFM* laog_exposition = NULL; /* WordFM LAOGLinkExposition* NULL */
 /* end EXPOSITION ONLY */
 
+/* True if laog has no cycle, in which case the .ord fields are a
+   topological order of laog. */
+static Bool  laog_is_dag = True;
+/* Bounds of the .ord in use, so that a node can be moved to the
+   front or the end of the order. */
+static Word  laog_ord_lo = 0;
+static Word  laog_ord_hi = 0;
+/* Incremented for each search, see LAOGLinks.mark. */
+static UWord laog_mark = 0;
+/* Nr of nodes deleted since the last (failed) topological sort. */
+static UWord laog_n_dels_since_sort = 0;
+
+/* Work arrays for the searches, kept to avoid reallocating them. */
+static XArray* laog_stack   = NULL; /* of node */
+static XArray* laog_targets = NULL; /* of (node, Lock*) pairs */
+static XArray* laog_deltaF  = NULL; /* of LAOGLinks* */
+static XArray* laog_deltaB  = NULL; /* of LAOGLinks* */
+static XArray* laog_ords    = NULL; /* of Word */
+
+static UWord stats__laog_searches = 0;
+static UWord stats__laog_searches_avoided = 0;
+static UWord stats__laog_reorders = 0;
+static UWord stats__laog_reordered_nodes = 0;
+static UWord stats__laog_sorts = 0;
+
+static Int cmp_LAOGLinks_by_ord ( const void* l1V, const void* l2V ) {
+   const LAOGLinks* l1 = *(LAOGLinks* const*)l1V;
+   const LAOGLinks* l2 = *(LAOGLinks* const*)l2V;
+   if (l1->ord < l2->ord) return -1;
+   if (l1->ord > l2->ord) return  1;
+   return 0;
+}
+
+static Int cmp_Word ( const void* w1V, const void* w2V ) {
+   Word w1 = *(const Word*)w1V;
+   Word w2 = *(const Word*)w2V;
+   if (w1 < w2) return -1;
+   if (w1 > w2) return  1;
+   return 0;
+}
+
+static inline void laog__resetXA ( XArray* xa ) {
+   VG_(dropTailXA)( xa, VG_(sizeXA)( xa ) );
+}
+
 
 __attribute__((noinline))
 static void laog__init ( void )
@@ -3580,29 +3645,44 @@ static void laog__init ( void )
 
    laog_exposition = VG_(newFM)( HG_(zalloc), "hg.laog__init.2", HG_(free), 
                                  cmp_LAOGLinkExposition );
+
+   laog_stack   = VG_(newXA)( HG_(zalloc), "hg.laog__init.3",
+                              HG_(free), sizeof(UWord) );
+   laog_targets = VG_(newXA)( HG_(zalloc), "hg.laog__init.4",
+                              HG_(free), 2 * sizeof(UWord) );
+   laog_deltaF  = VG_(newXA)( HG_(zalloc), "hg.laog__init.5",
+                              HG_(free), sizeof(LAOGLinks*) );
+   laog_deltaB  = VG_(newXA)( HG_(zalloc), "hg.laog__init.6",
+                              HG_(free), sizeof(LAOGLinks*) );
+   laog_ords    = VG_(newXA)( HG_(zalloc), "hg.laog__init.7",
+                              HG_(free), sizeof(Word) );
+   VG_(setCmpFnXA)( laog_deltaF, cmp_LAOGLinks_by_ord );
+   VG_(setCmpFnXA)( laog_deltaB, cmp_LAOGLinks_by_ord );
+   VG_(setCmpFnXA)( laog_ords, cmp_Word );
 }
 
 static void laog__show ( const HChar* who ) {
    UWord i, ws_size;
    UWord* ws_words;
-   Lock* me;
+   UWord me;
    LAOGLinks* links;
-   VG_(printf)("laog (requested by %s) {\n", who);
+   VG_(printf)("laog (requested by %s, %s) {\n", who,
+               laog_is_dag ? "ordered" : "cyclic");
    VG_(initIterFM)( laog );
-   me = NULL;
+   me = 0;
    links = NULL;
-   while (VG_(nextIterFM)( laog, (UWord*)&me,
-                                 (UWord*)&links )) {
+   while (VG_(nextIterFM)( laog, &me, (UWord*)&links )) {
       tl_assert(me);
       tl_assert(links);
-      VG_(printf)("   node %p:\n", me);
+      VG_(printf)("   node %#lx%s ord %ld:\n", me,
+                  links->isBlock ? " (block)" : "", links->ord);
       HG_(getPayloadWS)( &ws_words, &ws_size, univ_laog, links->inns );
       for (i = 0; i < ws_size; i++)
          VG_(printf)("      inn %#lx\n", ws_words[i] );
       HG_(getPayloadWS)( &ws_words, &ws_size, univ_laog, links->outs );
       for (i = 0; i < ws_size; i++)
          VG_(printf)("      out %#lx\n", ws_words[i] );
-      me = NULL;
+      me = 0;
       links = NULL;
    }
    VG_(doneIterFM)( laog );
@@ -3672,8 +3752,11 @@ static void univ_laog_do_GC ( void ) {
    // (e.g. clo options to control the percentage increase or fixed increased),
    // we should do it here, eg.
    //     next_gc_univ_laog = prev_next_gc_univ_laog + VG_(clo_laog_gc_fixed);
-   // Currently, we just hard-code the solution 3 above.
-   next_gc_univ_laog = prev_next_gc_univ_laog + 1;
+   // Currently, we just hard-code the solution 3 above, plus a small
+   // fraction of the number of laog nodes: each gc visits all of them,
+   // so with many thousands of locks, a gc for each new set made the
+   // cost of adding edges grow with the size of the graph.
+   next_gc_univ_laog = prev_next_gc_univ_laog + 1 + VG_(sizeFM)( laog ) / 64;
 
    if (VG_(clo_stats))
       VG_(message)
@@ -3682,13 +3765,230 @@ static void univ_laog_do_GC ( void ) {
           (Int)univ_laog_cardinality, (Int)seen, next_gc_univ_laog);
 }
 
+static LAOGLinks* laog__links ( UWord node ) {
+   UWord      keyW;
+   LAOGLinks* links;
+   keyW  = 0;
+   links = NULL;
+   if (VG_(lookupFM)( laog, &keyW, (UWord*)&links, node )) {
+      tl_assert(links);
+      tl_assert(keyW == node);
+      return links;
+   } else {
+      return NULL;
+   }
+}
+
+/* Returns the links of node, first adding node to laog without any
+   edge, at the end of the topological order, if it is not there.
+   Nodes for heap blocks are only ever added by laog__node_of. */
+static LAOGLinks* laog__get_or_add_links ( UWord node, Bool isBlock ) {
+   LAOGLinks* links = laog__links( node );
+   if (!links) {
+      links = HG_(zalloc)("hg.lae.1", sizeof(LAOGLinks));
+      links->inns    = HG_(emptyWS)( univ_laog );
+      links->outs    = HG_(emptyWS)( univ_laog );
+      links->ord     = ++laog_ord_hi;
+      links->isBlock = isBlock;
+      VG_(addToFM)( laog, node, (UWord)links );
+   }
+   return links;
+}
+
+static Bool laog__find_containing_block ( /*OUT*/Addr* payload,
+                                          Addr a ); /* fwds */
+
+/* Returns the laog node of lk, choosing it if lk has none yet. */
+static UWord laog__node_of ( Lock* lk ) {
+   Addr payload;
+   if (LIKELY(lk->laog_node != 0))
+      return lk->laog_node;
+   if (HG_(clo_lockorders_by_block)
+       && laog__find_containing_block( &payload, lk->guestaddr )) {
+      LAOGLinks* links = laog__get_or_add_links( payload, True );
+      links->nLocks++;
+      lk->laog_node = payload;
+   } else {
+      lk->laog_node = (UWord)lk;
+   }
+   return lk->laog_node;
+}
+
+/* The Lock of a node, or NULL if it is a heap block. */
+static Lock* laog__lock_of ( UWord node, const LAOGLinks* links ) {
+   return links->isBlock ? NULL : (Lock*)node;
+}
+
+/* The guest address identifying a node in laog_exposition. */
+static Addr laog__ga_of ( UWord node, const LAOGLinks* links ) {
+   return links->isBlock ? (Addr)node : ((Lock*)node)->guestaddr;
+}
+
+/* Push the successors (or predecessors) of a node on laog_stack. */
+static void laog__push_links ( WordSetID ws /* univ_laog */ ) {
+   UWord  i, ws_size;
+   UWord* ws_words;
+   HG_(getPayloadWS)( &ws_words, &ws_size, univ_laog, ws );
+   for (i = 0; i < ws_size; i++)
+      (void) VG_(addToXA)( laog_stack, &ws_words[i] );
+}
+
+static UWord laog__pop ( void ) {
+   Word  ssz  = VG_(sizeXA)( laog_stack );
+   UWord here = *(UWord*) VG_(indexXA)( laog_stack, ssz-1 );
+   VG_(dropTailXA)( laog_stack, 1 );
+   return here;
+}
+
+/* Collect in 'delta' the nodes whose .ord is between lb and ub, and
+   that can be reached from 'start' by following either out edges
+   ('forwards') or in edges.  Returns False if a forwards search from
+   the destination (with .ord lb) of a new edge reaches its source
+   (with .ord ub), i.e. if the new edge closes a cycle. */
+static Bool laog__collect ( UWord start, Bool forwards, Word lb, Word ub,
+                            XArray* delta /* of LAOGLinks* */ )
+{
+   laog_mark++;
+   laog__resetXA( laog_stack );
+   laog__resetXA( delta );
+   (void) VG_(addToXA)( laog_stack, &start );
+   while (VG_(sizeXA)( laog_stack ) > 0) {
+      UWord      here  = laog__pop();
+      LAOGLinks* links = laog__links( here );
+      tl_assert(links);
+      if (links->mark == laog_mark)
+         continue;
+      if (forwards && links->ord == ub)
+         return False;
+      if (links->ord < lb || links->ord > ub)
+         continue;
+      links->mark = laog_mark;
+      (void) VG_(addToXA)( delta, &links );
+      laog__push_links( forwards ? links->outs : links->inns );
+   }
+   return True;
+}
+
+/* The edge src --> dst has just been added.  Update the topological
+   order if src is not before dst. */
+__attribute__((noinline))
+static void laog__order_edge ( UWord src, LAOGLinks* srcL,
+                               UWord dst, LAOGLinks* dstL ) {
+   Word lb, ub, i, nF, nB;
 
+   if (!laog_is_dag || srcL->ord < dstL->ord)
+      return;
+
+   /* Cheap cases: src has no predecessor and can be moved to the
+      front, or dst has no successor and can be moved to the end. */
+   if (HG_(isEmptyWS)( univ_laog, srcL->inns )) {
+      srcL->ord = --laog_ord_lo;
+      return;
+   }
+   if (HG_(isEmptyWS)( univ_laog, dstL->outs )) {
+      dstL->ord = ++laog_ord_hi;
+      return;
+   }
+
+   /* Find the nodes reachable from dst, and those reaching src, in
+      the part of the order which is affected.  Then give the .ord of
+      all these to the nodes reaching src first, and to the nodes
+      reachable from dst next, keeping their relative order. */
+   stats__laog_reorders++;
+   lb = dstL->ord;
+   ub = srcL->ord;
+   if (!laog__collect( dst, True, lb, ub, laog_deltaF )) {
+      laog_is_dag = False;
+      laog_n_dels_since_sort = 0;
+      return;
+   }
+   laog__collect( src, False, lb, ub, laog_deltaB );
+
+   VG_(sortXA)( laog_deltaF );
+   VG_(sortXA)( laog_deltaB );
+   nF = VG_(sizeXA)( laog_deltaF );
+   nB = VG_(sizeXA)( laog_deltaB );
+   laog__resetXA( laog_ords );
+   for (i = 0; i < nB; i++)
+      (void) VG_(addToXA)( laog_ords,
+                &(*(LAOGLinks**)VG_(indexXA)( laog_deltaB, i ))->ord );
+   for (i = 0; i < nF; i++)
+      (void) VG_(addToXA)( laog_ords,
+                &(*(LAOGLinks**)VG_(indexXA)( laog_deltaF, i ))->ord );
+   VG_(sortXA)( laog_ords );
+   for (i = 0; i < nB; i++)
+      (*(LAOGLinks**)VG_(indexXA)( laog_deltaB, i ))->ord
+         = *(Word*)VG_(indexXA)( laog_ords, i );
+   for (i = 0; i < nF; i++)
+      (*(LAOGLinks**)VG_(indexXA)( laog_deltaF, i ))->ord
+         = *(Word*)VG_(indexXA)( laog_ords, nB + i );
+   stats__laog_reordered_nodes += nF + nB;
+}
+
+/* Try to find a topological order for the whole of laog, which is
+   only possible if laog has no cycle (anymore). */
 __attribute__((noinline))
-static void laog__add_edge ( Lock* src, Lock* dst ) {
-   UWord      keyW;
+static void laog__sort ( void ) {
+   UWord      node, i, ws_size;
+   UWord*     ws_words;
    LAOGLinks* links;
+   Word       ord = 0;
+
+   stats__laog_sorts++;
+   laog_n_dels_since_sort = 0;
+
+   /* Kahn's algorithm, using laog_stack as a queue, and .mark to count
+      the predecessors of each node not yet ordered. */
+   laog__resetXA( laog_stack );
+   VG_(initIterFM)( laog );
+   while (VG_(nextIterFM)( laog, &node, (UWord*)&links )) {
+      HG_(getPayloadWS)( &ws_words, &ws_size, univ_laog, links->inns );
+      links->mark = ws_size;
+      if (ws_size == 0)
+         (void) VG_(addToXA)( laog_stack, &node );
+   }
+   VG_(doneIterFM)( laog );
+
+   for (i = 0; i < VG_(sizeXA)( laog_stack ); i++) {
+      UWord j;
+      node  = *(UWord*) VG_(indexXA)( laog_stack, i );
+      links = laog__links( node );
+      links->ord = ord++;
+      HG_(getPayloadWS)( &ws_words, &ws_size, univ_laog, links->outs );
+      for (j = 0; j < ws_size; j++) {
+         LAOGLinks* succL = laog__links( ws_words[j] );
+         tl_assert(succL->mark > 0);
+         if (--succL->mark == 0)
+            (void) VG_(addToXA)( laog_stack, &ws_words[j] );
+      }
+   }
+
+   laog_is_dag = VG_(sizeXA)( laog_stack ) == VG_(sizeFM)( laog );
+   if (laog_is_dag) {
+      laog_ord_lo = 0;
+      laog_ord_hi = ord - 1;
+   }
+
+   /* laog_mark is never 0, so this marks all nodes as not visited. */
+   VG_(initIterFM)( laog );
+   while (VG_(nextIterFM)( laog, NULL, (UWord*)&links ))
+      links->mark = 0;
+   VG_(doneIterFM)( laog );
+}
+
+
+/* Add the edge src --> dst.  If not NULL, srcLk and dstLk are the
+   locks for which it is added, and are used to record where the
+   order was established. */
+__attribute__((noinline))
+static void laog__add_edge ( UWord src, UWord dst,
+                             Lock* srcLk, Lock* dstLk ) {
+   LAOGLinks* srcL;
+   LAOGLinks* dstL;
+   WordSetID  outs_new, inns_new;
    Bool       presentF, presentR;
-   if (0) VG_(printf)("laog__add_edge %p %p\n", src, dst);
+   if (0) VG_(printf)("laog__add_edge %#lx %#lx\n", src, dst);
+   tl_assert(src != dst);
 
    /* Take the opportunity to sanity check the graph.  Record in
       presentF if there is already a src->dst mapping in this node's
@@ -3698,44 +3998,26 @@ static void laog__add_edge ( Lock* src, Lock* dst ) {
       to decide whether or not to update the link details mapping.  We
       can compute presentF and presentR essentially for free, so may
       as well do this always. */
-   presentF = presentR = False;
 
    /* Update the out edges for src */
-   keyW  = 0;
-   links = NULL;
-   if (VG_(lookupFM)( laog, &keyW, (UWord*)&links, (UWord)src )) {
-      WordSetID outs_new;
-      tl_assert(links);
-      tl_assert(keyW == (UWord)src);
-      outs_new = HG_(addToWS)( univ_laog, links->outs, (UWord)dst );
-      presentF = outs_new == links->outs;
-      links->outs = outs_new;
-   } else {
-      links = HG_(zalloc)("hg.lae.1", sizeof(LAOGLinks));
-      links->inns = HG_(emptyWS)( univ_laog );
-      links->outs = HG_(singletonWS)( univ_laog, (UWord)dst );
-      VG_(addToFM)( laog, (UWord)src, (UWord)links );
-   }
+   srcL = laog__get_or_add_links( src, False );
+   outs_new = HG_(addToWS)( univ_laog, srcL->outs, dst );
+   presentF = outs_new == srcL->outs;
+   srcL->outs = outs_new;
+
    /* Update the in edges for dst */
-   keyW  = 0;
-   links = NULL;
-   if (VG_(lookupFM)( laog, &keyW, (UWord*)&links, (UWord)dst )) {
-      WordSetID inns_new;
-      tl_assert(links);
-      tl_assert(keyW == (UWord)dst);
-      inns_new = HG_(addToWS)( univ_laog, links->inns, (UWord)src );
-      presentR = inns_new == links->inns;
-      links->inns = inns_new;
-   } else {
-      links = HG_(zalloc)("hg.lae.2", sizeof(LAOGLinks));
-      links->inns = HG_(singletonWS)( univ_laog, (UWord)src );
-      links->outs = HG_(emptyWS)( univ_laog );
-      VG_(addToFM)( laog, (UWord)dst, (UWord)links );
-   }
+   dstL = laog__get_or_add_links( dst, False );
+   inns_new = HG_(addToWS)( univ_laog, dstL->inns, src );
+   presentR = inns_new == dstL->inns;
+   dstL->inns = inns_new;
 
    tl_assert( (presentF && presentR) || (!presentF && !presentR) );
 
-   if (!presentF && src->acquired_at && dst->acquired_at) {
+   if (!presentF)
+      laog__order_edge( src, srcL, dst, dstL );
+
+   if (!presentF && srcLk && srcLk->acquired_at
+       && dstLk && dstLk->acquired_at) {
       LAOGLinkExposition expo;
       /* If this edge is entering the graph, and we have acquired_at
          information for both src and dst, record those acquisition
@@ -3743,9 +4025,9 @@ static void laog__add_edge ( Lock* src, Lock* dst ) {
          ordering, we can show the user the two places in which the
          required src-dst ordering was previously established. */
       if (0) VG_(printf)("acquire edge %#lx %#lx\n",
-                         src->guestaddr, dst->guestaddr);
-      expo.src_ga = src->guestaddr;
-      expo.dst_ga = dst->guestaddr;
+                         srcLk->guestaddr, dstLk->guestaddr);
+      expo.src_ga = laog__ga_of( src, srcL );
+      expo.dst_ga = laog__ga_of( dst, dstL );
       expo.src_ec = NULL;
       expo.dst_ec = NULL;
       tl_assert(laog_exposition);
@@ -3754,10 +4036,10 @@ static void laog__add_edge ( Lock* src, Lock* dst ) {
       } else {
          LAOGLinkExposition* expo2 = HG_(zalloc)("hg.lae.3", 
                                                sizeof(LAOGLinkExposition));
-         expo2->src_ga = src->guestaddr;
-         expo2->dst_ga = dst->guestaddr;
-         expo2->src_ec = src->acquired_at;
-         expo2->dst_ec = dst->acquired_at;
+         expo2->src_ga = expo.src_ga;
+         expo2->dst_ga = expo.dst_ga;
+         expo2->src_ec = srcLk->acquired_at;
+         expo2->dst_ec = dstLk->acquired_at;
          VG_(addToFM)( laog_exposition, (UWord)expo2, (UWord)NULL );
       }
    }
@@ -3766,35 +4048,28 @@ static void laog__add_edge ( Lock* src, Lock* dst ) {
       univ_laog_do_GC();
 }
 
+
 __attribute__((noinline))
-static void laog__del_edge ( Lock* src, Lock* dst ) {
-   UWord      keyW;
-   LAOGLinks* links;
-   if (0) VG_(printf)("laog__del_edge enter %p %p\n", src, dst);
+static void laog__del_edge ( UWord src, UWord dst ) {
+   LAOGLinks* srcL;
+   LAOGLinks* dstL;
+   if (0) VG_(printf)("laog__del_edge enter %#lx %#lx\n", src, dst);
    /* Update the out edges for src */
-   keyW  = 0;
-   links = NULL;
-   if (VG_(lookupFM)( laog, &keyW, (UWord*)&links, (UWord)src )) {
-      tl_assert(links);
-      tl_assert(keyW == (UWord)src);
-      links->outs = HG_(delFromWS)( univ_laog, links->outs, (UWord)dst );
-   }
+   srcL = laog__links( src );
+   if (srcL)
+      srcL->outs = HG_(delFromWS)( univ_laog, srcL->outs, dst );
    /* Update the in edges for dst */
-   keyW  = 0;
-   links = NULL;
-   if (VG_(lookupFM)( laog, &keyW, (UWord*)&links, (UWord)dst )) {
-      tl_assert(links);
-      tl_assert(keyW == (UWord)dst);
-      links->inns = HG_(delFromWS)( univ_laog, links->inns, (UWord)src );
-   }
+   dstL = laog__links( dst );
+   if (dstL)
+      dstL->inns = HG_(delFromWS)( univ_laog, dstL->inns, src );
 
    /* Remove the exposition of src,dst (if present) */
-   {
+   if (srcL && dstL) {
       LAOGLinkExposition *fm_expo;
       
       LAOGLinkExposition expo;
-      expo.src_ga = src->guestaddr;
-      expo.dst_ga = dst->guestaddr;
+      expo.src_ga = laog__ga_of( src, srcL );
+      expo.dst_ga = laog__ga_of( dst, dstL );
       expo.src_ec = NULL;
       expo.dst_ec = NULL;
 
@@ -3811,64 +4086,52 @@ static void laog__del_edge ( Lock* src, Lock* dst ) {
 }
 
 __attribute__((noinline))
-static WordSetID /* in univ_laog */ laog__succs ( Lock* lk ) {
-   UWord      keyW;
-   LAOGLinks* links;
-   keyW  = 0;
-   links = NULL;
-   if (VG_(lookupFM)( laog, &keyW, (UWord*)&links, (UWord)lk )) {
-      tl_assert(links);
-      tl_assert(keyW == (UWord)lk);
-      return links->outs;
-   } else {
-      return HG_(emptyWS)( univ_laog );
-   }
+static WordSetID /* in univ_laog */ laog__succs ( UWord node ) {
+   LAOGLinks* links = laog__links( node );
+   return links ? links->outs : HG_(emptyWS)( univ_laog );
 }
 
 __attribute__((noinline))
-static WordSetID /* in univ_laog */ laog__preds ( Lock* lk ) {
-   UWord      keyW;
-   LAOGLinks* links;
-   keyW  = 0;
-   links = NULL;
-   if (VG_(lookupFM)( laog, &keyW, (UWord*)&links, (UWord)lk )) {
-      tl_assert(links);
-      tl_assert(keyW == (UWord)lk);
-      return links->inns;
-   } else {
-      return HG_(emptyWS)( univ_laog );
-   }
+static WordSetID /* in univ_laog */ laog__preds ( UWord node ) {
+   LAOGLinks* links = laog__links( node );
+   return links ? links->inns : HG_(emptyWS)( univ_laog );
 }
 
 __attribute__((noinline))
 static void laog__sanity_check ( const HChar* who ) {
    UWord i, ws_size;
    UWord* ws_words;
-   Lock* me;
+   UWord me;
    LAOGLinks* links;
    VG_(initIterFM)( laog );
-   me = NULL;
+   me = 0;
    links = NULL;
    if (0) VG_(printf)("laog sanity check\n");
-   while (VG_(nextIterFM)( laog, (UWord*)&me,
-                                 (UWord*)&links )) {
+   while (VG_(nextIterFM)( laog, &me, (UWord*)&links )) {
       tl_assert(me);
       tl_assert(links);
+      if (links->isBlock != (links->nLocks > 0))
+         goto bad;
+      if (laog_is_dag
+          && (links->ord < laog_ord_lo || links->ord > laog_ord_hi))
+         goto bad;
       HG_(getPayloadWS)( &ws_words, &ws_size, univ_laog, links->inns );
       for (i = 0; i < ws_size; i++) {
          if ( ! HG_(elemWS)( univ_laog, 
-                             laog__succs( (Lock*)ws_words[i] ), 
-                             (UWord)me ))
+                             laog__succs( ws_words[i] ), 
+                             me ))
             goto bad;
       }
       HG_(getPayloadWS)( &ws_words, &ws_size, univ_laog, links->outs );
       for (i = 0; i < ws_size; i++) {
          if ( ! HG_(elemWS)( univ_laog, 
-                             laog__preds( (Lock*)ws_words[i] ), 
-                             (UWord)me ))
+                             laog__preds( ws_words[i] ), 
+                             me ))
+            goto bad;
+         if (laog_is_dag && links->ord >= laog__links( ws_words[i] )->ord)
             goto bad;
       }
-      me = NULL;
+      me = 0;
       links = NULL;
    }
    VG_(doneIterFM)( laog );
@@ -3880,22 +4143,20 @@ static void laog__sanity_check ( const HChar* who ) {
    tl_assert(0);
 }
 
-/* If there is a path in laog from 'src' to any of the elements in
-   'dst', return an arbitrarily chosen element of 'dst' reachable from
-   'src'.  If no path exist from 'src' to any element in 'dst', return
-   NULL. */
+/* If there is a path in laog from the node of 'lk' to the node of
+   any of the locks in 'dsts', return an arbitrarily chosen such lock.
+   Locks sharing the node of 'lk' are ignored.  If no path exists,
+   return NULL. */
 __attribute__((noinline))
 static
-Lock* laog__do_dfs_from_to ( Lock* src, WordSetID dsts /* univ_lsets */ )
+Lock* laog__do_dfs_from_to ( Lock* lk, WordSetID dsts /* univ_lsets */ )
 {
-   Lock*     ret;
-   Word      ssz;
-   XArray*   stack;   /* of Lock* */
-   WordFM*   visited; /* Lock* -> void, iow, Set(Lock*) */
-   Lock*     here;
-   WordSetID succs;
-   UWord     succs_size, i;
-   UWord*    succs_words;
+   UWord      src = laog__node_of( lk );
+   LAOGLinks* srcL;
+   Lock*      ret;
+   Word       ub, nTargets, t;
+   UWord      dsts_size, i;
+   UWord*     dsts_words;
    //laog__sanity_check();
 
    /* If the destination set is empty, we can never get there from
@@ -3903,40 +4164,76 @@ Lock* laog__do_dfs_from_to ( Lock* src, WordSetID dsts /* univ_lsets */ )
    if (HG_(isEmptyWS)( univ_lsets, dsts ))
       return NULL;
 
-   ret     = NULL;
-   stack   = VG_(newXA)( HG_(zalloc), "hg.lddft.1", HG_(free), sizeof(Lock*) );
-   visited = VG_(newFM)( HG_(zalloc), "hg.lddft.2", HG_(free), NULL/*unboxedcmp*/ );
-
-   (void) VG_(addToXA)( stack, &src );
-
-   while (True) {
+   srcL = laog__links( src );
+   if (!srcL || HG_(isEmptyWS)( univ_laog, srcL->outs ))
+      return NULL;
 
-      ssz = VG_(sizeXA)( stack );
+   /* Find the nodes of dsts that may be reachable from src.  With a
+      topological order, they must be after src, and the search can
+      be limited to the nodes before the last of them. */
+   laog__resetXA( laog_targets );
+   ub = srcL->ord;
+   HG_(getPayloadWS)( &dsts_words, &dsts_size, univ_lsets, dsts );
+   for (i = 0; i < dsts_size; i++) {
+      UWord      target[2];
+      LAOGLinks* targetL;
+      target[0] = laog__node_of( (Lock*)dsts_words[i] );
+      target[1] = dsts_words[i];
+      if (target[0] == src)
+         continue;
+      targetL = laog__links( target[0] );
+      if (!targetL || HG_(isEmptyWS)( univ_laog, targetL->inns ))
+         continue;
+      if (laog_is_dag) {
+         if (targetL->ord <= srcL->ord)
+            continue;
+         if (targetL->ord > ub)
+            ub = targetL->ord;
+      }
+      (void) VG_(addToXA)( laog_targets, target );
+   }
+   nTargets = VG_(sizeXA)( laog_targets );
+   if (nTargets == 0) {
+      stats__laog_searches_avoided++;
+      return NULL;
+   }
+   stats__laog_searches++;
 
-      if (ssz == 0) { ret = NULL; break; }
+   ret = NULL;
+   laog_mark++;
+   laog__resetXA( laog_stack );
+   (void) VG_(addToXA)( laog_stack, &src );
 
-      here = *(Lock**) VG_(indexXA)( stack, ssz-1 );
-      VG_(dropTailXA)( stack, 1 );
+   while (VG_(sizeXA)( laog_stack ) > 0) {
+      UWord      here  = laog__pop();
+      LAOGLinks* links;
 
-      if (HG_(elemWS)( univ_lsets, dsts, (UWord)here )) { ret = here; break; }
+      for (t = 0; t < nTargets; t++) {
+         UWord* target = VG_(indexXA)( laog_targets, t );
+         if (target[0] == here) {
+            ret = (Lock*)target[1];
+            break;
+         }
+      }
+      if (ret)
+         break;
 
-      if (VG_(lookupFM)( visited, NULL, NULL, (UWord)here ))
+      links = laog__links( here );
+      tl_assert(links);
+      if (links->mark == laog_mark)
          continue;
+      links->mark = laog_mark;
 
-      VG_(addToFM)( visited, (UWord)here, 0 );
+      /* Nothing after ub in the order can lead to a target. */
+      if (laog_is_dag && links->ord > ub)
+         continue;
 
-      succs = laog__succs( here );
-      HG_(getPayloadWS)( &succs_words, &succs_size, univ_laog, succs );
-      for (i = 0; i < succs_size; i++)
-         (void) VG_(addToXA)( stack, &succs_words[i] );
+      laog__push_links( links->outs );
    }
 
-   VG_(deleteFM)( visited, NULL, NULL );
-   VG_(deleteXA)( stack );
    return ret;
 }
 
-
 /* Thread 'thr' is acquiring 'lk'.  Check for inconsistent ordering
    between 'lk' and the locks already held by 'thr' and issue a
    complaint if so.  Also, update the ordering graph appropriately.
@@ -3949,6 +4246,7 @@ static void laog__pre_thread_acquires_lock (
 {
    UWord*   ls_words;
    UWord    ls_size, i;
+   UWord    node;
    Lock*    other;
 
    /* It may be that 'thr' already holds 'lk' and is recursively
@@ -3973,8 +4271,10 @@ static void laog__pre_thread_acquires_lock (
          in which they should have been acquired. */
       /* Go look in the laog_exposition mapping, to find the allocation
          points for this edge, so we can show the user. */
-      key.src_ga = lk->guestaddr;
-      key.dst_ga = other->guestaddr;
+      key.src_ga = laog__ga_of( lk->laog_node,
+                                laog__links( lk->laog_node ) );
+      key.dst_ga = laog__ga_of( other->laog_node,
+                                laog__links( other->laog_node ) );
       key.src_ec = NULL;
       key.dst_ec = NULL;
       found = NULL;
@@ -4047,11 +4347,14 @@ static void laog__pre_thread_acquires_lock (
       fields must be non-NULL.
    */
    tl_assert(lk->acquired_at);
+   node = laog__node_of( lk );
    HG_(getPayloadWS)( &ls_words, &ls_size, univ_lsets, thr->locksetA );
    for (i = 0; i < ls_size; i++) {
       Lock* old = (Lock*)ls_words[i];
+      UWord old_node = laog__node_of( old );
       tl_assert(old->acquired_at);
-      laog__add_edge( old, lk );
+      if (old_node != node)
+         laog__add_edge( old_node, node, old, lk );
    }
 
    /* Why "except_Locks" ?  We're here because a lock is being
@@ -4087,9 +4390,24 @@ static void laog__handle_one_lock_deletion ( Lock* lk )
    WordSetID preds, succs;
    UWord preds_size, succs_size, i, j;
    UWord *preds_words, *succs_words;
+   UWord node = lk->laog_node;
+   LAOGLinks* links;
 
-   preds = laog__preds( lk );
-   succs = laog__succs( lk );
+   if (node == 0)
+      return; /* lk was never acquired, so is not in laog. */
+   links = laog__links( node );
+   if (!links)
+      return;
+   if (links->isBlock) {
+      /* Only delete the node with the last lock of its block. */
+      tl_assert(links->nLocks > 0);
+      links->nLocks--;
+      if (links->nLocks > 0)
+         return;
+   }
+
+   preds = laog__preds( node );
+   succs = laog__succs( node );
 
    // We need to duplicate the payload, as these can be garbage collected
    // during the del/add operations below.
@@ -4100,10 +4418,10 @@ static void laog__handle_one_lock_deletion ( Lock* lk )
    succs_words = UWordV_dup(succs_words, succs_size);
 
    for (i = 0; i < preds_size; i++)
-      laog__del_edge( (Lock*)preds_words[i], lk );
+      laog__del_edge( preds_words[i], node );
 
    for (j = 0; j < succs_size; j++)
-      laog__del_edge( lk, (Lock*)succs_words[j] );
+      laog__del_edge( node, succs_words[j] );
 
    for (i = 0; i < preds_size; i++) {
       for (j = 0; j < succs_size; j++) {
@@ -4111,7 +4429,11 @@ static void laog__handle_one_lock_deletion ( Lock* lk )
             /* This can pass unlocked locks to laog__add_edge, since
                we're deleting stuff.  So their acquired_at fields may
                be NULL. */
-            laog__add_edge( (Lock*)preds_words[i], (Lock*)succs_words[j] );
+            laog__add_edge( preds_words[i], succs_words[j],
+                            laog__lock_of( preds_words[i],
+                                           laog__links( preds_words[i] ) ),
+                            laog__lock_of( succs_words[j],
+                                           laog__links( succs_words[j] ) ) );
          }
       }
    }
@@ -4123,16 +4445,22 @@ static void laog__handle_one_lock_deletion ( Lock* lk )
 
    // Remove lk information from laog links FM
    {
-      LAOGLinks *links;
-      Lock* linked_lk;
+      UWord linked_node;
 
       if (VG_(delFromFM) (laog, 
-                          (UWord*)&linked_lk, (UWord*)&links, (UWord)lk)) {
-         tl_assert (linked_lk == lk);
+                          &linked_node, (UWord*)&links, node)) {
+         tl_assert (linked_node == node);
          HG_(free) (links);
       }
    }
    /* FIXME ??? What about removing lock lk data from EXPOSITION ??? */
+
+   /* With fewer nodes, laog might have become acyclic again.  Only
+      try to sort it once a fraction of it has been deleted, so that
+      the cost of sorting is amortised. */
+   if (!laog_is_dag
+       && ++laog_n_dels_since_sort * 8 >= VG_(sizeFM)( laog ))
+      laog__sort();
 }
 
 //__attribute__((noinline))
@@ -4172,6 +4500,12 @@ typedef
    (obviously). */
 static VgHashTable *hg_mallocmeta_table = NULL;
 
+/* With --lockorders-by-block=yes, the same MallocMetas, indexed by
+   payload address, so as to find the block containing a lock without
+   looking at all of them (see laog__find_containing_block).  NULL
+   otherwise. */
+static WordFM* hg_mallocmeta_by_addr = NULL; /* Addr -> MallocMeta* */
+
 /* MallocMeta are small elements. We use a pool to avoid
    the overhead of malloc for each MallocMeta. */
 static PoolAlloc *MallocMeta_poolalloc = NULL;
@@ -4213,6 +4547,8 @@ void* handle_alloc ( ThreadId tid,
    md->thr     = map_threads_lookup( tid );
 
    VG_(HT_add_node)( hg_mallocmeta_table, (VgHashNode*)md );
+   if (hg_mallocmeta_by_addr)
+      VG_(addToFM)( hg_mallocmeta_by_addr, p, (UWord)md );
    if (UNLIKELY(VG_(clo_xtree_memory) == Vg_XTMemory_Full))
       VG_(XTMemory_Full_alloc)(md->szB, md->where);
 
@@ -4290,6 +4626,8 @@ static void handle_free ( ThreadId tid, void* p )
    tl_assert(old_md); /* it must be present - we just found it */
    tl_assert(old_md == md);
    tl_assert(old_md->payload == (Addr)p);
+   if (hg_mallocmeta_by_addr)
+      VG_(delFromFM)( hg_mallocmeta_by_addr, NULL, NULL, (UWord)p );
 
    VG_(cli_free)((void*)old_md->payload);
    delete_MallocMeta(old_md);
@@ -4378,6 +4716,8 @@ static void* hg_cli__realloc ( ThreadId tid, void* payloadV, SizeT new_size )
       md_tmp = VG_(HT_remove)( hg_mallocmeta_table, payload );
       tl_assert(md_tmp);
       tl_assert(md_tmp == md);
+      if (hg_mallocmeta_by_addr)
+         VG_(delFromFM)( hg_mallocmeta_by_addr, NULL, NULL, payload );
 
       VG_(cli_free)((void*)md->payload);
       delete_MallocMeta(md);
@@ -4390,6 +4730,8 @@ static void* hg_cli__realloc ( ThreadId tid, void* payloadV, SizeT new_size )
 
       /* and add */
       VG_(HT_add_node)( hg_mallocmeta_table, (VgHashNode*)md_new );
+      if (hg_mallocmeta_by_addr)
+         VG_(addToFM)( hg_mallocmeta_by_addr, p_new, (UWord)md_new );
 
       return (void*)p_new;
    }  
@@ -4472,6 +4814,27 @@ Bool HG_(mm_find_containing_block)( /*OUT*/ExeContext** where,
    return True;
 }
 
+/* As HG_(mm_find_containing_block), but in time logarithmic in the
+   number of blocks, using hg_mallocmeta_by_addr: the block containing
+   a, if any, is the one with the highest payload address <= a. */
+static Bool laog__find_containing_block ( /*OUT*/Addr* payload, Addr a )
+{
+   UWord       valW;
+   MallocMeta* mm;
+
+   tl_assert(hg_mallocmeta_by_addr);
+   if (!VG_(lookupFM)( hg_mallocmeta_by_addr, NULL, &valW, a )) {
+      /* Not the start of a block: take the previous one, if any. */
+      (void)VG_(findBoundsFM)( hg_mallocmeta_by_addr, NULL, &valW,
+                               NULL, NULL, 0, 0, ~(UWord)0, 0, a );
+   }
+   mm = (MallocMeta*)valW;
+   if (mm == NULL || !addr_is_in_MM_Chunk(mm, a))
+      return False;
+   *payload = mm->payload;
+   return True;
+}
+
 
 /*--------------------------------------------------------------*/
 /*--- Instrumentation                                        ---*/
@@ -5747,6 +6110,8 @@ static Bool hg_process_cmd_line_option ( const HChar* arg )
 
    if      VG_BOOL_CLO(arg, "--track-lockorders",
                             HG_(clo_track_lockorders)) {}
+   else if VG_BOOL_CLO(arg, "--lockorders-by-block",
+                            HG_(clo_lockorders_by_block)) {}
    else if VG_BOOL_CLO(arg, "--cmp-race-err-addrs",
                             HG_(clo_cmp_race_err_addrs)) {}
 
@@ -5763,6 +6128,10 @@ static Bool hg_process_cmd_line_option ( const HChar* arg )
    else if VG_BINT_CLO(arg, "--conflict-cache-size",
                        HG_(clo_conflict_cache_size), 10*1000, 150*1000*1000) {}
 
+   else if VG_BINT_CLO(arg, "--conflict-cache-mem",
+                       HG_(clo_conflict_cache_mem),
+                       0, 1024LL*1024LL*1024LL*1024LL) {}
+
    /* "stuvwx" --> stuvwx (binary) */
    else if VG_STR_CLO(arg, "--hg-sanity-flags", tmp_str) {
       Int j;
@@ -5810,6 +6179,8 @@ static void hg_print_usage ( void )
    VG_(printf)(
 "    --free-is-write=no|yes    treat heap frees as writes [no]\n"
 "    --track-lockorders=no|yes show lock ordering errors? [yes]\n"
+"    --lockorders-by-block=no|yes treat the locks in a same heap block\n"
+"                              as one lock for lock ordering? [no]\n"
 "    --history-level=none|approx|full [full]\n"
 "       full:   show both stack traces for a data race (can be very slow)\n"
 "       approx: full trace for one thread, approx for the other (faster)\n"
@@ -5819,6 +6190,9 @@ static void hg_print_usage ( void )
 "        yes : derive a stacktrace from the previous stacktrace\n"
 "          if there was no call/return or similar instruction\n"
 "    --conflict-cache-size=N   size of 'full' history cache [2000000]\n"
+"    --conflict-cache-mem=<number> memory budget in bytes for 'full'\n"
+"                              history, incl. a compact tier for older\n"
+"                              accesses; overrides --conflict-cache-size [0]\n"
 "    --check-stack-refs=no|yes race-check reads and writes on the\n"
 "                              main stack and thread stacks? [yes]\n"
 "    --ignore-thread-creation=yes|no Ignore activities during thread\n"
@@ -5900,6 +6274,11 @@ static void hg_print_stats (void)
                   (Int)(laog ? VG_(sizeFM)( laog ) : 0));
       VG_(printf)(" LAOG exposition: %'8d map size\n",
                   (Int)(laog_exposition ? VG_(sizeFM)( laog_exposition ) : 0));
+      VG_(printf)("            LAOG: %'8lu searches, %'lu avoided, "
+                  "%'lu reorders (%'lu nodes), %'lu sorts, %s\n",
+                  stats__laog_searches, stats__laog_searches_avoided,
+                  stats__laog_reorders, stats__laog_reordered_nodes,
+                  stats__laog_sorts, laog_is_dag ? "acyclic" : "cyclic");
    }
 
    VG_(printf)("           locks: %'8lu acquires, "
@@ -5993,6 +6372,9 @@ static void hg_post_clo_init ( void )
 
    if (HG_(clo_track_lockorders))
       laog__init();
+   if (HG_(clo_track_lockorders) && HG_(clo_lockorders_by_block))
+      hg_mallocmeta_by_addr = VG_(newFM)( HG_(zalloc), "hg.mmba.1",
+                                          HG_(free), NULL/*unboxedcmp*/ );
 
    initialise_data_structures(hbthr_root);
    if (VG_(clo_xtree_memory) == Vg_XTMemory_Full)
@@ -6031,7 +6413,8 @@ static void hg_pre_clo_init ( void )
                                    HG_(get_error_name),
                                    HG_(get_extra_suppression_info),
                                    HG_(print_extra_suppression_use),
-                                   HG_(update_extra_suppression_use));
+                                   HG_(update_extra_suppression_use),
+                                   NULL/*hash_Error*/);
 
    VG_(needs_xml_output)          ();
 
@@ -33,6 +33,7 @@
 #include "pub_tool_libcassert.h"
 #include "pub_tool_libcbase.h"
 #include "pub_tool_libcprint.h"
+#include "pub_tool_libcproc.h"       // VG_(read_millisecond_timer)
 #include "pub_tool_machine.h"
 #include "pub_tool_mallocfree.h"
 #include "pub_tool_wordfm.h"
@@ -297,6 +298,8 @@ typedef
       UWord rc;
       UWord rcX; /* used for crosschecking */
       UWord frames_hash;          /* hash of all the frames */
+      UWord ecu; /* ECU of the ExeContext with these frames, 0 if unknown.
+                    Only computed when moving an OldRef to the cold tier. */
       UWord frames[N_FRAMES];
    }
    RCEC;
@@ -660,10 +663,17 @@ static UWord stats__cline_16to8pulldown  = 0; // # calls to pulldown_to_8
 static UWord stats__vts__tick            = 0; // # calls to VTS__tick
 static UWord stats__vts__join            = 0; // # calls to VTS__join
 static UWord stats__vts__cmpLEQ          = 0; // # calls to VTS__cmpLEQ
+static UWord stats__vts__cmpLEQ_sparse   = 0; // # of which by binary search
 static UWord stats__vts__cmp_structural  = 0; // # calls to VTS__cmp_structural
 static UWord stats__vts_tab_GC           = 0; // # nr of vts_tab GC
 static UWord stats__vts_pruning          = 0; // # nr of vts pruning
 
+// time (ms) spent in the phases of vts_tab GC and vts pruning
+static ULong stats__vts_tab_GC_flush_ms  = 0; // flushing the cache
+static ULong stats__vts_tab_GC_free_ms   = 0; // freeing unused VTSs
+static ULong stats__vts_pruning_ms       = 0; // building the pruned VTSs
+static ULong stats__vts_remap_ms         = 0; // remapping all VtsIDs
+
 // # calls to VTS__cmp_structural w/ slow case
 static UWord stats__vts__cmp_structural_slow = 0;
 
@@ -2117,16 +2127,24 @@ static void verydead_thread_table_sort_and_check (XArray* thrids)
 /* A VTS contains .ts, its vector clock, and also .id, a field to hold
    a backlink for the caller's convenience.  Since we have no idea
    what to set that to in the library, it always gets set to
-   VtsID_INVALID. */
+   VtsID_INVALID.  .hash and .next are only meaningful once the VTS
+   has been added to a VTS set (see vts_set__add). */
 typedef
-   struct {
-      VtsID    id;
-      UInt     usedTS;
-      UInt     sizeTS;
-      ScalarTS ts[0];
+   struct _VTS {
+      VtsID         id;
+      UInt          usedTS;
+      UInt          sizeTS;
+      UInt          hash;  /* VTS__hash of .ts */
+      struct _VTS*  next;  /* hash chain in a VTS set */
+      ScalarTS      ts[0];
    }
    VTS;
 
+/* When a VTS has at most 1/VTS_SPARSE_RATIO as many entries as
+   another, comparing them is done by looking up the entries of the
+   short one in the long one, rather than by walking both. */
+#define VTS_SPARSE_RATIO 8
+
 /* Allocate a VTS capable of storing 'sizeTS' entries. */
 static VTS* VTS__new ( const HChar* who, UInt sizeTS );
 
@@ -2155,8 +2173,10 @@ static void VTS__tick ( /*OUT*/VTS* out, Thr* me, VTS* vts );
 
 /* Create in 'out' a VTS which is the join (max) of 'a' and
    'b'. Caller must have pre-allocated 'out' sufficiently big to hold
-   the result in all possible cases. */
-static void VTS__join ( /*OUT*/VTS* out, VTS* a, VTS* b );
+   the result in all possible cases.  Returns 1 if the join is
+   structurally identical to 'a', else 2 if it is identical to 'b',
+   else 0. */
+static UInt VTS__join ( /*OUT*/VTS* out, VTS* a, VTS* b );
 
 /* Compute the partial ordering relation of the two args.  Although we
    could be completely general and return an enumeration value (EQ,
@@ -2177,6 +2197,10 @@ static UInt VTS__cmpLEQ ( VTS* a, VTS* b );
    Returns -1, 0 or 1. */
 static Word VTS__cmp_structural ( VTS* a, VTS* b );
 
+/* Compute a hash of the args' VC, consistent with
+   VTS__cmp_structural: structurally equal VTSs hash the same. */
+static UInt VTS__hash ( const VTS* vts );
+
 /* Debugging only.  Display the given VTS. */
 static void VTS__show ( const VTS* vts );
 
@@ -2393,12 +2417,13 @@ static void VTS__tick ( /*OUT*/VTS* out, Thr* me, VTS* vts )
 /* Return a new VTS constructed as the join (max) of the 2 args.
    Neither arg is modified.
 */
-static void VTS__join ( /*OUT*/VTS* out, VTS* a, VTS* b )
+static UInt VTS__join ( /*OUT*/VTS* out, VTS* a, VTS* b )
 {
    UInt     ia, ib, useda, usedb;
    ULong    tyma, tymb, tymMax;
    ThrID    thrid;
    UInt     ncommon = 0;
+   Bool     a_geq = True, b_geq = True;
 
    stats__vts__join++;
 
@@ -2476,6 +2501,8 @@ static void VTS__join ( /*OUT*/VTS* out, VTS* a, VTS* b )
 
       /* having laboriously determined (thr, tyma, tymb), do something
          useful with it. */
+      if (tyma < tymb) a_geq = False;
+      if (tymb < tyma) b_geq = False;
       tymMax = tyma > tymb ? tyma : tymb;
       if (tymMax > 0) {
          UInt hi = out->usedTS++;
@@ -2488,9 +2515,49 @@ static void VTS__join ( /*OUT*/VTS* out, VTS* a, VTS* b )
    tl_assert(is_sane_VTS(out));
    tl_assert(out->usedTS <= out->sizeTS);
    tl_assert(out->usedTS == useda + usedb - ncommon);
+   return a_geq ? 1 : b_geq ? 2 : 0;
 }
 
 
+/* Determine if 'a' <= 'b', in the partial ordering, in the case
+   where 'a' has much fewer entries than 'b' -- typically 'a' is a
+   singleton, the time of a single thread as in FastTrack's epochs,
+   and 'b' the clock of a thread.  Rather than walking both, look up
+   each entry of 'a' in 'b' using binary search.  Same return
+   convention as VTS__cmpLEQ. */
+static UInt/*ThrID*/ VTS__cmpLEQ_sparse ( VTS* a, VTS* b )
+{
+   UWord ia, lo, hi, mid;
+   UWord useda = a->usedTS, usedb = b->usedTS;
+
+   stats__vts__cmpLEQ_sparse++;
+
+   lo = 0;
+   for (ia = 0; ia < useda; ia++) {
+      ScalarTS* tmpa = &a->ts[ia];
+      /* Find tmpa->thrid in b->ts[lo .. usedb-1].  Since a is sorted
+         too, the next search can start where this one ended. */
+      hi = usedb;
+      while (lo < hi) {
+         mid = (lo + hi) / 2;
+         if (b->ts[mid].thrid < tmpa->thrid)
+            lo = mid + 1;
+         else
+            hi = mid;
+      }
+      /* Entries of a are never zero, so a missing entry in b (that
+         is, an implicit zero) means not LEQ. */
+      if (lo == usedb || b->ts[lo].thrid != tmpa->thrid
+          || tmpa->tym > b->ts[lo].tym) {
+         tl_assert(tmpa->thrid >= 1024);
+         return tmpa->thrid;
+      }
+      lo++;
+   }
+
+   return 0; /* all points are LEQ => return an invalid ThrID */
+}
+
 /* Determine if 'a' <= 'b', in the partial ordering.  Returns zero if
    they are, or the first ThrID for which they are not (no valid ThrID
    has the value zero).  This rather strange convention is used
@@ -2508,6 +2575,9 @@ static UInt/*ThrID*/ VTS__cmpLEQ ( VTS* a, VTS* b )
    useda = a->usedTS;
    usedb = b->usedTS;
 
+   if (useda * VTS_SPARSE_RATIO <= usedb)
+      return VTS__cmpLEQ_sparse(a, b);
+
    ia = ib = 0;
 
    while (1) {
@@ -2642,6 +2712,22 @@ Word VTS__cmp_structural ( VTS* a, VTS* b )
 }
 
 
+/* Hash the VC.  A ScalarTS is 8 bytes (checked at startup), so mix in
+   each of them as a whole, without bothering with the bitfields.
+*/
+static UInt VTS__hash ( const VTS* vts )
+{
+   UWord i;
+   ULong h = vts->usedTS;
+   for (i = 0; i < vts->usedTS; i++) {
+      h ^= *(const ULong*)&vts->ts[i];
+      h *= 0x9E3779B97F4A7C15ULL;
+      h ^= h >> 29;
+   }
+   return (UInt)(h ^ (h >> 32));
+}
+
+
 /* Debugging only.  Display the given VTS.
 */
 static void VTS__show ( const VTS* vts )
@@ -2728,14 +2814,116 @@ static void VTS__declare_thread_very_dead ( Thr* thr )
 //                                                     //
 /////////////////////////////////////////////////////////
 
-static WordFM* /* WordFM VTS* void */ vts_set = NULL;
+/* A set of VTSs, so that structurally identical VTSs can be shared.
+   The set is consulted on every synchronisation event, so rather than
+   being a WordFM it is a hash table keyed on the VCs: finding a VTS
+   normally costs one hash computation and one structural comparison,
+   rather than log2(size) comparisons of possibly very long VTSs.
+   Removing a VTS is done by identity, and needs no comparison at all.
+   The chains are linked through the VTSs' .next fields. */
+typedef
+   struct {
+      VTS** buckets;   /* nBuckets chains */
+      UWord nBuckets;  /* always a power of 2 */
+      UWord nElems;
+   }
+   VtsSet;
+
+static VtsSet* vts_set = NULL;
+
+/* Make a new empty set, sized to hold about nElemsHint VTSs before it
+   needs to grow. */
+static VtsSet* vts_set__new ( const HChar* who, UWord nElemsHint )
+{
+   VtsSet* set = HG_(zalloc)( who, sizeof(VtsSet) );
+   set->nBuckets = 1024;
+   while (set->nBuckets < nElemsHint)
+      set->nBuckets *= 2;
+   set->buckets = HG_(zalloc)( who, set->nBuckets * sizeof(VTS*) );
+   set->nElems = 0;
+   return set;
+}
+
+/* Free the set itself.  The VTSs it contains are not freed. */
+static void vts_set__delete ( VtsSet* set )
+{
+   HG_(free)( set->buckets );
+   HG_(free)( set );
+}
+
+static inline UWord vts_set__size ( const VtsSet* set )
+{
+   return set->nElems;
+}
+
+/* Double the number of buckets, rechaining all the VTSs. */
+__attribute__((noinline))
+static void vts_set__grow ( VtsSet* set )
+{
+   UWord  i, nNew = 2 * set->nBuckets;
+   VTS**  bNew = HG_(zalloc)( "libhb.vts_set__grow.1", nNew * sizeof(VTS*) );
+   for (i = 0; i < set->nBuckets; i++) {
+      VTS* vts = set->buckets[i];
+      while (vts) {
+         VTS*  next = vts->next;
+         UWord b    = vts->hash & (nNew - 1);
+         vts->next = bNew[b];
+         bNew[b] = vts;
+         vts = next;
+      }
+   }
+   HG_(free)( set->buckets );
+   set->buckets  = bNew;
+   set->nBuckets = nNew;
+}
+
+/* Find a VTS structurally identical to cand, whose hash is 'hash'.
+   Returns NULL if there is none. */
+static VTS* vts_set__lookup ( const VtsSet* set, VTS* cand, UInt hash )
+{
+   VTS* vts = set->buckets[hash & (set->nBuckets - 1)];
+   while (vts) {
+      if (vts->hash == hash && vts->usedTS == cand->usedTS
+          && VTS__cmp_structural( vts, cand ) == 0)
+         return vts;
+      vts = vts->next;
+   }
+   return NULL;
+}
+
+/* Add vts, which must not be in the set, and whose .hash must be
+   set. */
+static void vts_set__add ( VtsSet* set, VTS* vts )
+{
+   UWord b;
+   tl_assert(vts->hash == VTS__hash(vts));
+   if (UNLIKELY(set->nElems >= set->nBuckets))
+      vts_set__grow( set );
+   b = vts->hash & (set->nBuckets - 1);
+   vts->next = set->buckets[b];
+   set->buckets[b] = vts;
+   set->nElems++;
+}
+
+/* Remove vts (this very VTS, not a structurally identical one) from
+   the set.  It must be present. */
+static void vts_set__remove ( VtsSet* set, VTS* vts )
+{
+   VTS** prev = &set->buckets[vts->hash & (set->nBuckets - 1)];
+   while (*prev != vts) {
+      tl_assert(*prev); /* else it isn't in the set ?! */
+      prev = &(*prev)->next;
+   }
+   *prev = vts->next;
+   vts->next = NULL;
+   tl_assert(set->nElems > 0);
+   set->nElems--;
+}
 
 static void vts_set_init ( void )
 {
    tl_assert(!vts_set);
-   vts_set = VG_(newFM)( HG_(zalloc), "libhb.vts_set_init.1",
-                         HG_(free),
-                         (Word(*)(UWord,UWord))VTS__cmp_structural );
+   vts_set = vts_set__new( "libhb.vts_set_init.1", 0 );
 }
 
 /* Given a VTS, look in vts_set to see if we already have a
@@ -2744,23 +2932,25 @@ static void vts_set_init ( void )
    set, and return (False, pointer to the clone). */
 static Bool vts_set__find__or__clone_and_add ( /*OUT*/VTS** res, VTS* cand )
 {
-   UWord keyW, valW;
+   UInt hash = VTS__hash( cand );
+   VTS* vts;
    stats__vts_set__focaa++;
    tl_assert(cand->id == VtsID_INVALID);
    /* lookup cand (by value) */
-   if (VG_(lookupFM)( vts_set, &keyW, &valW, (UWord)cand )) {
+   vts = vts_set__lookup( vts_set, cand, hash );
+   if (vts) {
       /* found it */
-      tl_assert(valW == 0);
       /* if this fails, cand (by ref) was already present (!) */
-      tl_assert(keyW != (UWord)cand);
-      *res = (VTS*)keyW;
+      tl_assert(vts != cand);
+      *res = vts;
       return True;
    } else {
       /* not present.  Clone, add and return address of clone. */
       stats__vts_set__focaa_a++;
       VTS* clone = VTS__clone( "libhb.vts_set_focaa.1", cand );
       tl_assert(clone != cand);
-      VG_(addToFM)( vts_set, (UWord)clone, 0/*val is unused*/ );
+      clone->hash = hash;
+      vts_set__add( vts_set, clone );
       *res = clone;
       return False;
    }
@@ -2812,6 +3002,11 @@ static VtsID vts_tab_freelist = VtsID_INVALID;
    set appropriately so as to check for the next GC point. */
 static Word vts_next_GC_at = 1000;
 
+/* Each GC starts by flushing the whole cache, which costs the same
+   whatever the size of vts_tab.  To amortise that cost, at least
+   this many new VTSs can be created between two GCs. */
+#define VTS_GC_MIN_INTERVAL 8192
+
 static void vts_tab_init ( void )
 {
    vts_tab = VG_(newXA)( HG_(zalloc), "libhb.vts_tab_init.1",
@@ -2922,7 +3117,7 @@ static void show_vts_stats ( const HChar* caller )
    UWord nSet, nTab, nLive;
    ULong totrc;
    UWord n, i;
-   nSet = VG_(sizeFM)( vts_set );
+   nSet = vts_set__size( vts_set );
    nTab = VG_(sizeXA)( vts_tab );
    totrc = 0;
    nLive = 0;
@@ -2988,11 +3183,14 @@ __attribute__((noinline))
 static void vts_tab__do_GC ( Bool show_stats )
 {
    UWord i, nTab, nLive, nFreed;
+   UInt  t_start, t_flushed, t_freed, t_pruned;
 
    /* ---------- BEGIN VTS GC ---------- */
    /* check this is actually necessary. */
    tl_assert(vts_tab_freelist == VtsID_INVALID);
 
+   t_start = VG_(read_millisecond_timer)();
+
    /* empty the caches for partial order checks and binary joins.  We
       could do better and prune out the entries to be deleted, but it
       ain't worth the hassle. */
@@ -3001,6 +3199,9 @@ static void vts_tab__do_GC ( Bool show_stats )
    /* First, make the reference counts up to date. */
    zsm_flush_cache();
 
+   t_flushed = VG_(read_millisecond_timer)();
+   stats__vts_tab_GC_flush_ms += t_flushed - t_start;
+
    nTab = VG_(sizeXA)( vts_tab );
 
    if (show_stats) {
@@ -3013,8 +3214,6 @@ static void vts_tab__do_GC ( Bool show_stats )
       free list, removed from vts_set, and deleted. */
    nFreed = 0;
    for (i = 0; i < nTab; i++) {
-      Bool present;
-      UWord oldK = 0, oldV = 12345;
       VtsTE* te = VG_(indexXA)( vts_tab, i );
       if (te->vts == NULL) {
          tl_assert(te->rc == 0);
@@ -3025,11 +3224,7 @@ static void vts_tab__do_GC ( Bool show_stats )
       /* Ok, we got one we can free. */
       tl_assert(te->vts->id == i);
       /* first, remove it from vts_set. */
-      present = VG_(delFromFM)( vts_set,
-                                &oldK, &oldV, (UWord)te->vts );
-      tl_assert(present); /* else it isn't in vts_set ?! */
-      tl_assert(oldV == 0); /* no info stored in vts_set val fields */
-      tl_assert(oldK == (UWord)te->vts); /* else what did delFromFM find?! */
+      vts_set__remove( vts_set, te->vts );
       /* now free the VTS itself */
       VTS__delete(te->vts);
       te->vts = NULL;
@@ -3040,13 +3235,16 @@ static void vts_tab__do_GC ( Bool show_stats )
    }
 
    /* Now figure out when the next GC should be.  We'll allow the
-      number of VTSs to double before GCing again.  Except of course
-      that since we can't (or, at least, don't) shrink vts_tab, we
-      can't set the threshold value smaller than it. */
+      number of VTSs to double, and to grow by at least
+      VTS_GC_MIN_INTERVAL, before GCing again.  Except of course that
+      since we can't (or, at least, don't) shrink vts_tab, we can't
+      set the threshold value smaller than it. */
    tl_assert(nFreed <= nTab);
    nLive = nTab - nFreed;
    tl_assert(nLive >= 0 && nLive <= nTab);
    vts_next_GC_at = 2 * nLive;
+   if (vts_next_GC_at < nLive + VTS_GC_MIN_INTERVAL)
+      vts_next_GC_at = nLive + VTS_GC_MIN_INTERVAL;
    if (vts_next_GC_at < nTab)
       vts_next_GC_at = nTab;
 
@@ -3055,6 +3253,9 @@ static void vts_tab__do_GC ( Bool show_stats )
       VG_(printf)("<<GC ends, next gc at %ld>>\n", vts_next_GC_at);
    }
 
+   t_freed = VG_(read_millisecond_timer)();
+   stats__vts_tab_GC_free_ms += t_freed - t_flushed;
+
    stats__vts_tab_GC++;
    if (VG_(clo_stats)) {
       tl_assert(nTab > 0);
@@ -3109,11 +3310,8 @@ static void vts_tab__do_GC ( Bool show_stats )
       = VG_(newXA)( HG_(zalloc), "libhb.vts_tab__do_GC.new_tab",
                     HG_(free), sizeof(VtsTE) );
 
-   /* WordFM VTS* void */
-   WordFM* new_set
-      = VG_(newFM)( HG_(zalloc), "libhb.vts_tab__do_GC.new_set",
-                    HG_(free),
-                    (Word(*)(UWord,UWord))VTS__cmp_structural );
+   VtsSet* new_set
+      = vts_set__new( "libhb.vts_tab__do_GC.new_set", nLive );
 
    /* Visit each old VTS.  For each one:
 
@@ -3165,12 +3363,7 @@ static void vts_tab__do_GC ( Bool show_stats )
          them all after we're done, but the upside is that we don't
          wind up temporarily storing potentially two complete copies
          of each VTS and hence spiking memory use. */
-      UWord oldK = 0, oldV = 12345;
-      Bool  present = VG_(delFromFM)( vts_set,
-                                      &oldK, &oldV, (UWord)old_vts );
-      tl_assert(present); /* else it isn't in vts_set ?! */
-      tl_assert(oldV == 0); /* no info stored in vts_set val fields */
-      tl_assert(oldK == (UWord)old_vts); /* else what did delFromFM find?! */
+      vts_set__remove( vts_set, old_vts );
       /* now free the VTS itself */
       VTS__delete(old_vts);
       old_te->vts = NULL;
@@ -3182,23 +3375,18 @@ static void vts_tab__do_GC ( Bool show_stats )
          structurally identical version is already present in new_set.
          If so, delete the one we just made and move on; if not, add
          it. */
-      VTS*  identical_version = NULL;
-      UWord valW = 12345;
-      if (VG_(lookupFM)(new_set, (UWord*)&identical_version, &valW,
-                        (UWord)new_vts)) {
+      new_vts->hash = VTS__hash(new_vts);
+      VTS* identical_version
+         = vts_set__lookup(new_set, new_vts, new_vts->hash);
+      if (identical_version) {
          // already have it
-         tl_assert(valW == 0);
-         tl_assert(identical_version != NULL);
          tl_assert(identical_version != new_vts);
          VTS__delete(new_vts);
          new_vts = identical_version;
          tl_assert(new_vts->id != VtsID_INVALID);
       } else {
-         tl_assert(valW == 12345);
-         tl_assert(identical_version == NULL);
          new_vts->id = new_VtsID_ctr++;
-         Bool b = VG_(addToFM)(new_set, (UWord)new_vts, 0);
-         tl_assert(!b);
+         vts_set__add(new_set, new_vts);
          VtsTE new_te;
          new_te.vts      = new_vts;
          new_te.rc       = 0;
@@ -3229,6 +3417,9 @@ static void vts_tab__do_GC ( Bool show_stats )
       VG_(dropHeadXA) (verydead_thread_table_not_pruned, nBT);
    }
 
+   t_pruned = VG_(read_millisecond_timer)();
+   stats__vts_pruning_ms += t_pruned - t_freed;
+
    /* At this point, we have:
       * the old VTS table, with its u.remap entries set,
         and with all .vts == NULL.
@@ -3239,7 +3430,7 @@ static void vts_tab__do_GC ( Bool show_stats )
         == VtsID_INVALID. 
       * the new VTS tree.
    */
-   tl_assert( VG_(sizeFM)(vts_set) == 0 );
+   tl_assert( vts_set__size(vts_set) == 0 );
 
    /* Now actually apply the mapping. */
    /* Visit all the VtsIDs in the entire system.  Where do we expect
@@ -3322,7 +3513,7 @@ static void vts_tab__do_GC ( Bool show_stats )
    }
 
    /* Install the new table and set. */
-   VG_(deleteFM)(vts_set, NULL/*kFin*/, NULL/*vFin*/);
+   vts_set__delete(vts_set);
    vts_set = new_set;
    VG_(deleteXA)( vts_tab );
    vts_tab = new_tab;
@@ -3335,21 +3526,19 @@ static void vts_tab__do_GC ( Bool show_stats )
    /* Sanity check vts_set and vts_tab. */
 
    /* Because all the live entries got slid down to the bottom of vts_tab: */
-   tl_assert( VG_(sizeXA)( vts_tab ) == VG_(sizeFM)( vts_set ));
+   tl_assert( VG_(sizeXA)( vts_tab ) == vts_set__size( vts_set ));
 
    /* Assert that the vts_tab and vts_set entries point at each other
       in the required way */
-   UWord wordK = 0, wordV = 0;
-   VG_(initIterFM)( vts_set );
-   while (VG_(nextIterFM)( vts_set, &wordK, &wordV )) {
-      tl_assert(wordK != 0);
-      tl_assert(wordV == 0);
-      VTS* vts = (VTS*)wordK;
-      tl_assert(vts->id != VtsID_INVALID);
-      VtsTE* te = VG_(indexXA)( vts_tab, vts->id );
-      tl_assert(te->vts == vts);
-   }
-   VG_(doneIterFM)( vts_set );
+   for (i = 0; i < vts_set->nBuckets; i++) {
+      VTS* vts;
+      for (vts = vts_set->buckets[i]; vts; vts = vts->next) {
+         tl_assert(vts->id != VtsID_INVALID);
+         tl_assert((vts->hash & (vts_set->nBuckets - 1)) == i);
+         VtsTE* te = VG_(indexXA)( vts_tab, vts->id );
+         tl_assert(te->vts == vts);
+      }
+   }
 
    /* Also iterate over the table, and check each entry is
       plausible. */
@@ -3364,6 +3553,7 @@ static void vts_tab__do_GC ( Bool show_stats )
    }
 
    /* And we're done.  Bwahahaha. Ha. Ha. Ha. */
+   stats__vts_remap_ms += VG_(read_millisecond_timer)() - t_pruned;
    stats__vts_pruning++;
    if (VG_(clo_stats)) {
       tl_assert(nTab > 0);
@@ -3396,6 +3586,7 @@ static ULong stats__cmpLEQ_queries = 0;
 static ULong stats__cmpLEQ_misses  = 0;
 static ULong stats__join2_queries  = 0;
 static ULong stats__join2_misses   = 0;
+static ULong stats__join2_dominated = 0; // misses needing no VTS__join
 
 static inline UInt ROL32 ( UInt w, Int n ) {
    w = (w << n) | (w >> (32-n));
@@ -3471,7 +3662,12 @@ static Bool VtsID__cmpLEQ_WRK ( VtsID vi1, VtsID vi2 ) {
    ////--
    v1  = VtsID__to_VTS(vi1);
    v2  = VtsID__to_VTS(vi2);
-   leq = VTS__cmpLEQ( v1, v2 ) == 0;
+   /* VTSs don't contain zero entries, so if v1 has more entries than
+      v2, it has at least one which is implicitly zero in v2. */
+   if (v1->usedTS > v2->usedTS)
+      leq = False;
+   else
+      leq = VTS__cmpLEQ( v1, v2 ) == 0;
    ////++
    cmpLEQ_cache[hash].vi1 = vi1;
    cmpLEQ_cache[hash].vi2 = vi2;
@@ -3501,9 +3697,28 @@ static VtsID VtsID__join2_WRK ( VtsID vi1, VtsID vi2 ) {
    ////--
    vts1 = VtsID__to_VTS(vi1);
    vts2 = VtsID__to_VTS(vi2);
-   temp_max_sized_VTS->usedTS = 0;
-   VTS__join(temp_max_sized_VTS, vts1,vts2);
-   res = vts_tab__find__or__clone_and_add(temp_max_sized_VTS);
+   /* When one arg is much shorter than the other -- typically the
+      clock of a location last accessed by a single thread, joined
+      with the clock of a thread -- it is cheap to check whether it is
+      below the other.  If it is, the join is the other one, and
+      there's no need to build it and look it up. */
+   if (vts1->usedTS * VTS_SPARSE_RATIO <= vts2->usedTS
+       && VTS__cmpLEQ(vts1, vts2) == 0) {
+      stats__join2_dominated++;
+      res = vi2;
+   } else
+   if (vts2->usedTS * VTS_SPARSE_RATIO <= vts1->usedTS
+       && VTS__cmpLEQ(vts2, vts1) == 0) {
+      stats__join2_dominated++;
+      res = vi1;
+   } else {
+      temp_max_sized_VTS->usedTS = 0;
+      switch (VTS__join(temp_max_sized_VTS, vts1,vts2)) {
+         case 1:  stats__join2_dominated++; res = vi1; break;
+         case 2:  stats__join2_dominated++; res = vi2; break;
+         default: res = vts_tab__find__or__clone_and_add(temp_max_sized_VTS);
+      }
+   }
    ////++
    join2_cache[hash].vi1 = vi1;
    join2_cache[hash].vi2 = vi2;
@@ -4076,6 +4291,7 @@ static Thr* Thr__new ( void )
    thr->cached_rcec.magic = RCEC_MAGIC;
    thr->cached_rcec.rc = 0;
    thr->cached_rcec.rcX = 0;
+   thr->cached_rcec.ecu = 0;
    thr->cached_rcec.next = NULL;
 
    /* Add this Thr* <-> ThrID binding to the mapping, and
@@ -4258,10 +4474,19 @@ static inline SVal Ptr2SVal (void* ptr)
       of course decrement the reference count on the RCEC it
       refers to, in order that entries from (1) eventually get
       discarded too.
+
+   3. Optionally (--conflict-cache-mem), a 'cold' tier of ColdRefs.
+      When an OldRef is discarded from (2), a compact copy of it is
+      kept in a fixed-capacity ring, with the stack trace replaced by
+      the ECU of an equivalent ExeContext.  The ring is only searched
+      when (2) has no conflicting access to report, which happens once
+      per reported race, so it costs nothing on the access fast path.
 */
 
 static UWord stats__evm__lookup_found = 0;
 static UWord stats__evm__lookup_notfound = 0;
+static UWord stats__evm__lookup_cold_found = 0;
+static UWord stats__evm__cold_adds = 0;
 
 static UWord stats__ctxt_eq_tsw_eq_rcec = 0;
 static UWord stats__ctxt_eq_tsw_neq_rcec = 0;
@@ -4844,8 +5069,11 @@ static UWord     oldrefHTN    = 0;    /* # elems in oldrefHT */
    as we never free an OldRef : we just re-use them. */
 
 
+static void coldref_add ( const OldRef* or ); /* fwds */
+
 /* allocates a new OldRef or re-use the lru one if all allowed OldRef
-   have already been allocated. */
+   have already been allocated.  A re-used OldRef is first copied to
+   the cold tier, if there is one. */
 static OldRef* alloc_or_reuse_OldRef ( void )
 {
    if (oldrefHTN < HG_(clo_conflict_cache_size)) {
@@ -4858,6 +5086,7 @@ static OldRef* alloc_or_reuse_OldRef ( void )
       OldRef_unchain(oldref);
       oldref_ht = VG_(HT_gen_remove) (oldrefHT, oldref, cmp_oldref_tsw);
       tl_assert (oldref == oldref_ht);
+      coldref_add( oldref );
       ctxt__rcdec( oldref->acc.rcec );
       return oldref;
    }
@@ -4887,6 +5116,168 @@ static inline Word cmp_nonempty_intervals ( Addr a1, SizeT n1,
    return 0;
 }
 
+
+///////////////////////////////////////////////////////
+//// Part (3): The cold tier of ColdRefs
+///
+
+/* A ColdRef is what remains of an OldRef discarded from the oldrefHT:
+   24 bytes instead of an OldRef plus its share of an RCEC.  Stack
+   traces are shared via the ExeContext of the discarded RCEC.  The
+   ColdRefs live in a ring (coldRefs) that is filled in order and, once
+   full, overwrites its oldest entry.  They are hashed on ga into
+   singly linked chains of ring indexes, newest first, so that the
+   first match found in a chain is the most recent one. */
+typedef
+   struct {
+      Addr      ga;
+      TSW       tsw;
+      WordSetID locksHeldW;
+      UInt      ecu;
+      UInt      ht_next; /* 1 + index of next ColdRef in chain, or 0 */
+   }
+   ColdRef;
+
+static ColdRef* coldRefs     = NULL; /* the ring */
+static UInt     coldRefsMax  = 0;    /* capacity when fully grown */
+static UInt     coldRefsSize = 0;    /* current capacity of the ring */
+static UInt     coldRefsUsed = 0;    /* # used entries */
+static UInt     coldRefsNext = 0;    /* index of next entry to fill */
+static UInt*    coldRefsHT   = NULL; /* chain heads, 1 + index or 0 */
+static UInt     coldRefsHTN  = 0;    /* # chain heads, a power of 2 */
+
+static inline UInt coldref_hash ( Addr ga )
+{
+   return (UInt)(((ULong)ga * 0x9E3779B97F4A7C15ULL) >> 32)
+          & (coldRefsHTN - 1);
+}
+
+/* (Re)build the chains of the ColdRefs [0, coldRefsUsed), which must
+   not have wrapped yet, so that the oldest ones are at index 0. */
+static void coldref_rehash ( void )
+{
+   UInt i, h;
+   for (i = 0; i < coldRefsHTN; i++)
+      coldRefsHT[i] = 0;
+   for (i = 0; i < coldRefsUsed; i++) {
+      h = coldref_hash(coldRefs[i].ga);
+      coldRefs[i].ht_next = coldRefsHT[h];
+      coldRefsHT[h] = 1 + i;
+   }
+}
+
+/* The ring is grown by doubling up to coldRefsMax, so that memory is
+   only used when the application actually touches that much memory. */
+static void coldref_grow ( void )
+{
+   UInt     newSize = coldRefsSize == 0 ? 65536 : 2 * coldRefsSize;
+   UInt     newHTN;
+   ColdRef* newRefs;
+
+   /* Growing only happens before the ring first wraps around. */
+   tl_assert(coldRefsUsed == coldRefsSize && coldRefsSize < coldRefsMax);
+   if (newSize > coldRefsMax || newSize < coldRefsSize)
+      newSize = coldRefsMax;
+   newRefs = HG_(zalloc)( "libhb.coldref_grow.1 (ColdRefs)",
+                          newSize * sizeof(ColdRef) );
+   if (coldRefs) {
+      VG_(memcpy)(newRefs, coldRefs, coldRefsUsed * sizeof(ColdRef));
+      HG_(free)(coldRefs);
+   }
+   coldRefs     = newRefs;
+   coldRefsSize = newSize;
+   coldRefsNext = coldRefsUsed;
+
+   /* Keep about one chain per ColdRef. */
+   newHTN = 1;
+   while ((newHTN << 1) != 0 && (newHTN << 1) <= coldRefsSize)
+      newHTN <<= 1;
+   if (newHTN != coldRefsHTN) {
+      if (coldRefsHT)
+         HG_(free)(coldRefsHT);
+      coldRefsHTN = newHTN;
+      coldRefsHT = HG_(zalloc)( "libhb.coldref_grow.2 (ColdRef chains)",
+                                coldRefsHTN * sizeof(UInt) );
+      coldref_rehash();
+   }
+}
+
+/* Remove the ColdRef at index ix from its chain. */
+static void coldref_unlink ( UInt ix )
+{
+   UInt* prevp = &coldRefsHT[coldref_hash(coldRefs[ix].ga)];
+   while (*prevp != 1 + ix) {
+      tl_assert(*prevp != 0);
+      prevp = &coldRefs[*prevp - 1].ht_next;
+   }
+   *prevp = coldRefs[ix].ht_next;
+}
+
+/* Keep a compact copy of or, which is being discarded from the
+   oldrefHT, if there is a cold tier. */
+static void coldref_add ( const OldRef* or )
+{
+   RCEC*   rcec = or->acc.rcec;
+   ColdRef* cr;
+   UInt    ix, h;
+
+   if (coldRefsMax == 0)
+      return;
+
+   if (rcec->ecu == 0) {
+      Int n, maxNFrames;
+      maxNFrames = min_UInt(N_FRAMES, VG_(clo_backtrace_size));
+      for (n = 0; n < maxNFrames; n++) {
+         if (0 == rcec->frames[n]) break;
+      }
+      if (n == 0)
+         return;
+      rcec->ecu = VG_(get_ECU_from_ExeContext)
+                     (VG_(make_ExeContext_from_StackTrace)(rcec->frames, n));
+   }
+
+   if (coldRefsUsed == coldRefsSize && coldRefsSize < coldRefsMax)
+      coldref_grow();
+
+   ix = coldRefsNext;
+   if (coldRefsUsed == coldRefsSize)
+      coldref_unlink(ix); /* full: overwrite the oldest */
+   else
+      coldRefsUsed++;
+   coldRefsNext = ix + 1 == coldRefsSize ? 0 : ix + 1;
+
+   cr = &coldRefs[ix];
+   cr->ga         = or->ga;
+   cr->tsw        = or->acc.tsw;
+   cr->locksHeldW = or->acc.locksHeldW;
+   cr->ecu        = (UInt)rcec->ecu;
+   h = coldref_hash(cr->ga);
+   cr->ht_next    = coldRefsHT[h];
+   coldRefsHT[h]  = 1 + ix;
+   stats__evm__cold_adds++;
+}
+
+/* Returns the newest ColdRef for an access to cand_a conflicting with
+   thrid/[a, a+szB[/isW, or NULL. */
+static ColdRef* coldref_lookup ( ThrID thrid, Addr a, SizeT szB, Bool isW,
+                                 Addr cand_a )
+{
+   UInt ix;
+   if (coldRefsUsed == 0)
+      return NULL;
+   for (ix = coldRefsHT[coldref_hash(cand_a)]; ix != 0;
+        ix = coldRefs[ix - 1].ht_next) {
+      ColdRef* cr = &coldRefs[ix - 1];
+      if (cr->ga != cand_a
+          || cr->tsw.thrid == thrid
+          || ((!cr->tsw.isW) && (!isW))
+          || cmp_nonempty_intervals(a, szB, cand_a, cr->tsw.szB) != 0)
+         continue;
+      return cr;
+   }
+   return NULL;
+}
+
 static UWord event_map_stamp = 0; // Used to stamp each OldRef when touched.
 
 static void event_map_bind ( Addr a, SizeT szB, Bool isW, Thr* thr )
@@ -5061,6 +5452,23 @@ Bool libhb_event_map_lookup ( /*OUT*/ExeContext** resEC,
       /* consider next address in toCheck[] */
    } /* for (j = 0; j < nToCheck; j++) */
 
+   /* Nothing in the oldrefHT.  Try the older accesses in the cold
+      tier, in the same address order. */
+   for (j = 0; j < nToCheck && coldRefsMax > 0; j++) {
+      ColdRef* cr = coldref_lookup(thrid, a, szB, isW, toCheck[j]);
+      if (cr) {
+         *resEC      = VG_(get_ExeContext_from_ECU)(cr->ecu);
+         tl_assert(*resEC);
+         *resThr     = Thr__from_ThrID(cr->tsw.thrid);
+         *resSzB     = cr->tsw.szB;
+         *resIsW     = cr->tsw.isW;
+         *locksHeldW = cr->locksHeldW;
+         stats__evm__lookup_found++;
+         stats__evm__lookup_cold_found++;
+         return True;
+      }
+   }
+
    /* really didn't find anything. */
    stats__evm__lookup_notfound++;
    return False;
@@ -5140,6 +5548,28 @@ static void event_map_init ( void )
                            .locksHeldW = 0, 
                            .rcec = NULL};
    lru.acc = mru.acc;
+
+   /* Split the --conflict-cache-mem budget: a quarter for the OldRefs
+      (and their hash table chain pointers), the rest for the cold
+      tier (and its chain heads).  RCECs and ExeContexts are shared
+      between many entries and are not accounted for. */
+   if (HG_(clo_conflict_cache_mem) > 0 && HG_(clo_history_level) == 2) {
+      ULong hotB  = HG_(clo_conflict_cache_mem) / 4;
+      ULong nHot  = hotB / (sizeof(OldRef) + sizeof(OldRef*));
+      ULong nCold = (HG_(clo_conflict_cache_mem) - hotB)
+                    / (sizeof(ColdRef) + sizeof(UInt));
+      if (nHot < 10*1000)
+         nHot = 10*1000;
+      if (nCold > 0x7FFFFFFFULL)
+         nCold = 0x7FFFFFFFULL;
+      HG_(clo_conflict_cache_size) = (UWord)nHot;
+      coldRefsMax = (UInt)nCold;
+      if (VG_(clo_verbosity) > 1)
+         VG_(message)(Vg_DebugMsg,
+                      "libhb: conflict cache: %'lu OldRefs, "
+                      "up to %'u ColdRefs\n",
+                      HG_(clo_conflict_cache_size), coldRefsMax);
+   }
 }
 
 static void event_map__check_reference_counts ( void )
@@ -6711,12 +7141,16 @@ void libhb_shutdown ( Bool show_stats )
                   stats__msmcwrite, stats__msmcwrite_change);
       VG_(printf)("   libhb: %'13llu cmpLEQ queries (%'llu misses)\n",
                   stats__cmpLEQ_queries, stats__cmpLEQ_misses);
-      VG_(printf)("   libhb: %'13llu join2  queries (%'llu misses)\n",
-                  stats__join2_queries, stats__join2_misses);
+      VG_(printf)("   libhb: %'13llu join2  queries (%'llu misses,"
+                  " %'llu dominated)\n",
+                  stats__join2_queries, stats__join2_misses,
+                  stats__join2_dominated);
 
       VG_(printf)("%s","\n");
-      VG_(printf)("   libhb: VTSops: tick %'lu,  join %'lu,  cmpLEQ %'lu\n",
-                  stats__vts__tick, stats__vts__join,  stats__vts__cmpLEQ );
+      VG_(printf)("   libhb: VTSops: tick %'lu,  join %'lu,  cmpLEQ %'lu"
+                  " (%'lu sparse)\n",
+                  stats__vts__tick, stats__vts__join,  stats__vts__cmpLEQ,
+                  stats__vts__cmpLEQ_sparse );
       VG_(printf)("   libhb: VTSops: cmp_structural %'lu (%'lu slow)\n",
                   stats__vts__cmp_structural, stats__vts__cmp_structural_slow);
       VG_(printf)("   libhb: VTSset: find__or__clone_and_add %'lu"
@@ -6732,8 +7166,14 @@ void libhb_shutdown ( Bool show_stats )
       );
       VG_(printf)("   libhb: #%lu vts_tab GC    #%lu vts pruning\n",
                   stats__vts_tab_GC, stats__vts_pruning);
+      VG_(printf)("   libhb: vts_tab GC: %'llu ms flushing cache,"
+                  " %'llu ms freeing VTSs\n",
+                  stats__vts_tab_GC_flush_ms, stats__vts_tab_GC_free_ms);
+      VG_(printf)("   libhb: vts pruning: %'llu ms pruning VTSs,"
+                  " %'llu ms remapping VtsIDs\n",
+                  stats__vts_pruning_ms, stats__vts_remap_ms);
       VG_(printf)( "   libhb: %lu entries in vts_set\n",
-                   VG_(sizeFM)( vts_set ) );
+                   vts_set__size( vts_set ) );
 
       VG_(printf)("%s","\n");
       {
@@ -6776,6 +7216,13 @@ void libhb_shutdown ( Bool show_stats )
       tl_assert (oldrefHTN == VG_(HT_count_nodes) (oldrefHT));
       VG_(printf)( "   libhb: oldref lookup found=%lu notfound=%lu\n",
                    stats__evm__lookup_found, stats__evm__lookup_notfound);
+      if (coldRefsMax > 0)
+         VG_(printf)( "   libhb: coldref adds=%lu found=%lu"
+                      " (%u of max %u in use, %d kB)\n",
+                      stats__evm__cold_adds, stats__evm__lookup_cold_found,
+                      coldRefsUsed, coldRefsMax,
+                      (int)(((ULong)coldRefsSize * sizeof(ColdRef)
+                             + (ULong)coldRefsHTN * sizeof(UInt)) / 1024));
       if (VG_(clo_verbosity) > 1)
          VG_(HT_print_stats) (oldrefHT, cmp_oldref_tsw);
       VG_(printf)( "   libhb: oldref bind tsw/rcec "
@@ -0,0 +1,45 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Parent and child both modify x with no locking.  Before the parent
+   does so, the child touches many more locations than the smallest
+   possible --conflict-cache-size, so that its access to x has been
+   evicted from the conflicting-access cache.  With --conflict-cache-mem
+   the child's access should still be reported, from the cold tier. */
+
+#define N_OTHER 30000
+
+int x = 0;
+long other[N_OTHER];
+
+void* child_fn ( void* arg )
+{
+   int i;
+   /* Unprotected relative to parent */
+   x++;
+   for (i = 0; i < N_OTHER; i++)
+      other[i] = i;
+   return NULL;
+}
+
+int main ( void )
+{
+   const struct timespec delay = { 0, 500 * 1000 * 1000 };
+   pthread_t child;
+   if (pthread_create(&child, NULL, child_fn, NULL)) {
+      perror("pthread_create");
+      exit(1);
+   }
+   nanosleep(&delay, 0);
+   /* Unprotected relative to child */
+   x++;
+
+   if (pthread_join(child, NULL)) {
+      perror("pthread join");
+      exit(1);
+   }
+
+   return 0;
+}
@@ -0,0 +1,59 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <assert.h>
+
+/* With --lockorders-by-block=yes, the locks of an array of locks
+   allocated in one block are a single lock for lock order checking.
+   Acquiring locks of the array in different orders is then not an
+   error, but acquiring G before some lock of the array, and later
+   another lock of the array before G, is. */
+
+#define N_LOCKS 16
+/* Space for each lock, so that the output does not depend on
+   sizeof(pthread_mutex_t). */
+#define LOCK_SPACE 64
+
+pthread_mutex_t g = PTHREAD_MUTEX_INITIALIZER;
+
+int main ( void )
+{
+   int r;
+   char* block = malloc(N_LOCKS * LOCK_SPACE);
+   pthread_mutex_t* a[N_LOCKS];
+   assert(block);
+   assert(sizeof(pthread_mutex_t) <= LOCK_SPACE);
+   for (r = 0; r < N_LOCKS; r++) {
+      a[r] = (pthread_mutex_t*)(block + r * LOCK_SPACE);
+      pthread_mutex_init(a[r], NULL);
+   }
+
+   /* Establish a[1] before a[2], then do it the other way round:
+      not an error, as both locks are in the same block. */
+   r = pthread_mutex_lock(a[1]); assert(!r);
+   r = pthread_mutex_lock(a[2]); assert(!r);
+   r = pthread_mutex_unlock(a[2]); assert(!r);
+   r = pthread_mutex_unlock(a[1]); assert(!r);
+
+   r = pthread_mutex_lock(a[2]); assert(!r);
+   r = pthread_mutex_lock(a[1]); assert(!r);
+   r = pthread_mutex_unlock(a[1]); assert(!r);
+   r = pthread_mutex_unlock(a[2]); assert(!r);
+
+   /* Establish g before a[3], then take a[4] before g: an error, as
+      a[3] and a[4] are in the same block. */
+   r = pthread_mutex_lock(&g); assert(!r);
+   r = pthread_mutex_lock(a[3]); assert(!r);
+   r = pthread_mutex_unlock(a[3]); assert(!r);
+   r = pthread_mutex_unlock(&g); assert(!r);
+
+   r = pthread_mutex_lock(a[4]); assert(!r);
+   r = pthread_mutex_lock(&g); assert(!r);
+   r = pthread_mutex_unlock(&g); assert(!r);
+   r = pthread_mutex_unlock(a[4]); assert(!r);
+
+   for (r = 0; r < N_LOCKS; r++)
+      pthread_mutex_destroy(a[r]);
+   pthread_mutex_destroy(&g);
+   free(block);
+   return 0;
+}
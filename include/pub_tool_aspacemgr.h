@@ -159,6 +159,13 @@ extern void* VG_(am_shadow_alloc)(SizeT size);
    accordingly.  This fails if the range isn't valid for valgrind. */
 extern SysRes VG_(am_munmap_valgrind)( Addr start, SizeT length );
 
+/* Tell the kernel that the contents of the given page aligned range
+   are not needed anymore, so that it can reclaim the memory.  The
+   mapping and the segment array are unchanged, but the contents of
+   the range are undefined afterwards.  Fails on platforms not
+   supporting this. */
+extern SysRes VG_(am_release_pages)( Addr start, SizeT length );
+
 #endif   // __PUB_TOOL_ASPACEMGR_H
 
 /*--------------------------------------------------------------------*/
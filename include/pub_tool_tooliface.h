@@ -355,7 +355,16 @@ extern void VG_(needs_tool_errors) (
    // can be used to update suppression extra information such as
    // some statistical counters that will be printed by
    // print_extra_suppression_use.
-   void (*update_extra_suppression_use)(const Error* err, const Supp* su)
+   void (*update_extra_suppression_use)(const Error* err, const Supp* su),
+
+   // Hash the tool-specific part of an error, so that the core can find
+   // duplicates without comparing against every error recorded so far.
+   // Any two errors for which eq_Error returns True (at any resolution)
+   // must hash to the same value, so only fields that eq_Error looks at
+   // may be used.  The core already hashes the error kind and the top of
+   // the error's ExeContext.  May be NULL, in which case only the core
+   // part of the error is hashed.
+   UWord (*hash_Error)(const Error* err)
 );
 
 /* Is information kept by the tool about specific instructions or
@@ -499,6 +508,14 @@ extern void VG_(needs_xml_output) ( void );
    function here. */
 extern void VG_(needs_final_IR_tidy_pass) ( IRSB*(*final_tidy)(IRSB*) );
 
+/* Can translations instrumented by the tool be saved and reused by a
+   later run (see --translation-cache)?  Only if the instrumentation
+   depends on nothing but the guest code and the command line options:
+   it must not embed run-specific values such as pointers to memory
+   allocated at run time, and must not have side effects that later
+   parts of the tool rely on. */
+extern void VG_(needs_cacheable_translations) ( void );
+
 
 /* ------------------------------------------------------------------ */
 /* Core events to track */
@@ -539,6 +556,16 @@ typedef
    decided to read debug info from).  If the value is zero, there is
    no associated debug info.  If the value exceeds zero, it can be
    supplied as an argument to selected queries in m_debuginfo.
+
+   When mremap moves a mapping, the contents of [from, from+len) are
+   now at [to, to+len), and [from, from+len) is unmapped; the two do
+   not overlap.  If a tool tracks move_mem_remap, it gets only that
+   event for them.  Otherwise it gets copy_mem_remap followed by
+   die_mem_munmap.
+
+   discard_mem_madvise is called after madvise(MADV_DONTNEED) on Linux:
+   the range now reads as zeroes for private anonymous mappings, and as
+   the contents of the file for file mappings.
 */
 void VG_(track_new_mem_startup)     (void(*f)(Addr a, SizeT len,
                                               Bool rr, Bool ww, Bool xx,
@@ -550,6 +577,8 @@ void VG_(track_new_mem_mmap)        (void(*f)(Addr a, SizeT len,
                                               ULong di_handle));
 
 void VG_(track_copy_mem_remap)      (void(*f)(Addr from, Addr to, SizeT len));
+void VG_(track_move_mem_remap)      (void(*f)(Addr from, Addr to, SizeT len));
+void VG_(track_discard_mem_madvise) (void(*f)(Addr a, SizeT len));
 void VG_(track_change_mem_mprotect) (void(*f)(Addr a, SizeT len,
                                               Bool rr, Bool ww, Bool xx));
 void VG_(track_die_mem_stack_signal)(void(*f)(Addr a, SizeT len));
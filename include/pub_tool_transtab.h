@@ -34,6 +34,13 @@
 void VG_(discard_translations_safely) ( Addr  start, SizeT len,
                                         const HChar* who );
 
+/* Discard all the translations at the next point where it is safe to
+   do so, that is, once the scheduler gets back control from the
+   client code about to run or currently running.  Unlike
+   VG_(discard_translations_safely), this can be called from any tool
+   callback. */
+void VG_(discard_all_translations_soon) ( const HChar* who );
+
 #endif   // __PUB_TOOL_TRANSTAB_H
 
 /*--------------------------------------------------------------------*/
@@ -1468,6 +1468,8 @@ typedef enum vki_idtype {
 #define VKI_MAP_ANON 0x1000   /* don't use a file */
 #define  VKI_MAP_ANONYMOUS VKI_MAP_ANON
 
+#define VKI_MADV_DONTNEED 4   /* dont need these pages */
+
 //----------------------------------------------------------------------
 // From sys/stat.h
 //----------------------------------------------------------------------
@@ -1029,6 +1029,49 @@ Bool MC_(eq_Error) ( VgRes res, const Error* e1, const Error* e2 )
    }
 }
 
+static UWord hash_string ( const HChar* s )
+{
+   UWord h = 0;
+   while (*s) {
+      h = (h << 5) + h + (UChar)*s;
+      s++;
+   }
+   return h;
+}
+
+/* Hash the parts of an error that MC_(eq_Error) compares.  Must be
+   kept in sync with it. */
+UWord MC_(hash_Error) ( const Error* err )
+{
+   MC_Error* extra = VG_(get_error_extra)(err);
+
+   switch (VG_(get_error_kind)(err)) {
+      case Err_CoreMem:
+      case Err_RegParam:
+         return hash_string(VG_(get_error_string)(err));
+
+      case Err_MemParam:
+         return hash_string(VG_(get_error_string)(err))
+                ^ (UWord)extra->Err.User.isAddrErr;
+
+      case Err_User:
+         return (UWord)extra->Err.User.isAddrErr;
+
+      case Err_FishyValue:
+         return hash_string(extra->Err.FishyValue.function_name)
+                ^ (hash_string(extra->Err.FishyValue.argument_name) << 1);
+
+      case Err_Addr:
+         return (UWord)extra->Err.Addr.szB;
+
+      case Err_Value:
+         return (UWord)extra->Err.Value.szB;
+
+      default:
+         return 0;
+   }
+}
+
 /* Functions used when searching MC_Chunk lists */
 static
 Bool addr_is_in_MC_Chunk_default_REDZONE_SZB(MC_Chunk* mc, Addr a)
@@ -278,6 +278,14 @@ enum {
    MCPE_COPY_ADDRESS_RANGE_STATE,
    MCPE_COPY_ADDRESS_RANGE_STATE_LOOP1,
    MCPE_COPY_ADDRESS_RANGE_STATE_LOOP2,
+   MCPE_COPY_ADDRESS_RANGE_STATE_CHUNK,
+   MCPE_COPY_ADDRESS_RANGE_STATE_SHARE_SM,
+   MCPE_MOVE_MEM_REMAP,
+   MCPE_MOVE_MEM_REMAP_SM,
+   MCPE_MAKE_MEM_DEFINED_IF_ADDRESSABLE,
+   MCPE_MAKE_MEM_DEFINED_IF_ADDRESSABLE_CHUNK,
+   MCPE_MAKE_MEM_DEFINED_IF_NOACCESS,
+   MCPE_MAKE_MEM_DEFINED_IF_NOACCESS_CHUNK,
    MCPE_CHECK_MEM_IS_NOACCESS,
    MCPE_CHECK_MEM_IS_NOACCESS_LOOP,
    MCPE_IS_MEM_ADDRESSABLE,
@@ -301,8 +309,9 @@ enum {
    MCPE_SET_ADDRESS_RANGE_PERMS_LOOP1A,
    MCPE_SET_ADDRESS_RANGE_PERMS_LOOP1B,
    MCPE_SET_ADDRESS_RANGE_PERMS_LOOP1C,
-   MCPE_SET_ADDRESS_RANGE_PERMS_LOOP8A,
-   MCPE_SET_ADDRESS_RANGE_PERMS_LOOP8B,
+   MCPE_SET_ADDRESS_RANGE_PERMS_FILL_A,
+   MCPE_SET_ADDRESS_RANGE_PERMS_FILL_B,
+   MCPE_SET_ADDRESS_RANGE_PERMS_TO_DIST_SM,
    MCPE_SET_ADDRESS_RANGE_PERMS_LOOP64K,
    MCPE_SET_ADDRESS_RANGE_PERMS_LOOP64K_FREE_DIST_SM,
    MCPE_NEW_MEM_STACK,
@@ -507,6 +516,14 @@ extern HChar * MC_(snprintf_delta) (HChar * buf, Int size,
 Bool MC_(is_valid_aligned_word)     ( Addr a );
 Bool MC_(is_within_valid_secondary) ( Addr a );
 
+// Tracking of the secondary maps (64Kb address chunks) in which client
+// memory contents or definedness might have changed, used by the
+// incremental leak search.  Only active with --leak-check-incremental=yes.
+// MC_(SM_written) returns True if the secondary map containing a was
+// (maybe) written since the last MC_(clear_written_SMs).
+Bool MC_(SM_written)        ( Addr a );
+void MC_(clear_written_SMs) ( void );
+
 // Prints as user msg a description of the given loss record.
 void MC_(pp_LossRecord)(UInt n_this_record, UInt n_total_records,
                         LossRecord* l);
@@ -528,6 +545,7 @@ Bool MC_(eq_Error)           ( VgRes res, const Error* e1, const Error* e2 );
 void MC_(before_pp_Error)    ( const Error* err );
 void MC_(pp_Error)           ( const Error* err );
 UInt MC_(update_Error_extra) ( const Error* err );
+UWord MC_(hash_Error)        ( const Error* err );
 
 Bool MC_(is_recognised_suppression) ( const HChar* name, Supp* su );
 
@@ -622,6 +640,13 @@ extern Long MC_(clo_freelist_vol);
    in the "big block" freed blocks queue. */
 extern Long MC_(clo_freelist_big_blocks);
 
+/* If > 0, give back to the kernel the memory of the blocks on the
+   freed blocks queue each time this volume of them was queued. */
+extern Long MC_(clo_freelist_release);
+
+/* Memory of queued freed blocks given back to the kernel so far. */
+extern ULong MC_(freelist_released_szB);
+
 /* Do leak check at exit?  default: NO */
 extern LeakCheckMode MC_(clo_leak_check);
 
@@ -671,6 +696,10 @@ typedef
    Default : all heuristics. */
 extern UInt MC_(clo_leak_check_heuristics);
 
+/* Should leak searches reuse the results of the previous search for the
+   memory not written since then ?  default: NO */
+extern Bool MC_(clo_leak_check_incremental);
+
 /* Assume accesses immediately below %esp are due to gcc-2.96 bugs.
  * default: NO */
 extern Bool MC_(clo_workaround_gcc296_bugs);
@@ -723,9 +752,31 @@ extern KeepStacktraces MC_(clo_keep_stacktraces);
 */
 extern Int MC_(clo_mc_level);
 
+/* When MC_(clo_mc_level) is 3, only give origins to heap blocks and
+   to memory made undefined by client requests, but not to stack
+   allocations or other sources.  Default: NO */
+extern Bool MC_(clo_track_origins_heap_only);
+
+/* Number of sets and of lines per set of the origin-tag cache.
+   Defaults: 1048576 sets of 2 lines */
+extern UInt MC_(clo_origin_cache_sets);
+extern UInt MC_(clo_origin_cache_ways);
+
 /* Should we show mismatched frees?  Default: YES */
 extern Bool MC_(clo_show_mismatched_frees);
 
+/* Whether to periodically replace secondary maps which are uniform or
+   identical to others with read-only shared ones.  Default: YES */
+extern Bool MC_(clo_share_secmaps);
+
+/* If > 1, only instrument about one superblock in this many, and only
+   check addressability.  Default: 1 (instrument everything) */
+extern UInt MC_(clo_sample_rate);
+
+/* With MC_(clo_sample_rate) > 1, should the superblock at this guest
+   address be instrumented? */
+extern Bool MC_(sample_SB) ( Addr guest_addr );
+
 /* Indicates the level of detail for Vbit tracking through integer add,
    subtract, and some integer comparison operations. */
 typedef
@@ -771,6 +822,11 @@ VG_REGPARM(0) void MC_(helperc_value_check1_fail_no_o) ( void );
 VG_REGPARM(0) void MC_(helperc_value_check0_fail_no_o) ( void );
 
 /* V-bits load/store helpers */
+/* For 64-bit little-endian hosts only: the V bits are passed in 64-bit
+   pieces, least significant first. */
+VG_REGPARM(1) void MC_(helperc_STOREV256le) ( Addr, ULong, ULong,
+                                                    ULong, ULong );
+VG_REGPARM(1) void MC_(helperc_STOREV128le) ( Addr, ULong, ULong );
 VG_REGPARM(1) void MC_(helperc_STOREV64be) ( Addr, ULong );
 VG_REGPARM(1) void MC_(helperc_STOREV64le) ( Addr, ULong );
 VG_REGPARM(2) void MC_(helperc_STOREV32be) ( Addr, UWord );
@@ -779,6 +835,9 @@ VG_REGPARM(2) void MC_(helperc_STOREV16be) ( Addr, UWord );
 VG_REGPARM(2) void MC_(helperc_STOREV16le) ( Addr, UWord );
 VG_REGPARM(2) void MC_(helperc_STOREV8)    ( Addr, UWord );
 
+/* Called after each store if --leak-check-incremental=yes. */
+VG_REGPARM(1) void MC_(helperc_mark_written) ( Addr );
+
 VG_REGPARM(2) void  MC_(helperc_LOADV256be) ( /*OUT*/V256*, Addr );
 VG_REGPARM(2) void  MC_(helperc_LOADV256le) ( /*OUT*/V256*, Addr );
 VG_REGPARM(2) void  MC_(helperc_LOADV128be) ( /*OUT*/V128*, Addr );
@@ -457,6 +457,20 @@ static MC_Chunk** lc_chunks;
 // How many chunks we're dealing with.
 static Int        lc_n_chunks;
 static SizeT lc_chunks_n_frees_marker;
+// All the chunks in lc_chunks are within [lc_chunks_min_addr,
+// lc_chunks_max_addr), counting zero-sized blocks as one byte.  Most
+// scanned words are not heap pointers, and this filters them out cheaply.
+static Addr lc_chunks_min_addr;
+static Addr lc_chunks_max_addr;
+// When lc_chunks has no overlapping blocks, lc_chunk_index splits
+// [lc_chunks_min_addr, lc_chunks_max_addr) into buckets of
+// 2^lc_chunk_index_shift bytes, and lc_chunk_index[b] is the index of the
+// first chunk ending after the start of bucket b.  A pointer in bucket b
+// can then only point in chunks lc_chunk_index[b] .. lc_chunk_index[b+1],
+// so the binary search is done on a few chunks rather than all of them.
+// NULL if there are overlapping blocks (e.g. metapools).
+static Int* lc_chunk_index;
+static UInt lc_chunk_index_shift;
 // This has the same number of entries as lc_chunks, and each entry
 // in lc_chunks corresponds with the entry here (ie. lc_chunks[i] and
 // lc_extras[i] describe the same block).
@@ -519,6 +533,83 @@ static SizeT MC_(bytes_heuristically_reachable)[N_LEAK_CHECK_HEURISTICS]
 static SizeT MC_(blocks_heuristically_reachable)[N_LEAK_CHECK_HEURISTICS]
                                                 = {0,0,0,0};
 
+// Builds lc_chunks_{min,max}_addr and lc_chunk_index for the sorted
+// lc_chunks.
+static void build_chunk_index ( void )
+{
+   Int   i, b, n_buckets;
+   Addr  end, prev_end;
+   Bool  overlap;
+
+   if (lc_chunk_index) {
+      VG_(free)(lc_chunk_index);
+      lc_chunk_index = NULL;
+   }
+   if (lc_n_chunks == 0) {
+      lc_chunks_min_addr = lc_chunks_max_addr = 0;
+      return;
+   }
+
+   lc_chunks_min_addr = lc_chunks[0]->data;
+   lc_chunks_max_addr = 0;
+   prev_end = 0;
+   overlap = False;
+   for (i = 0; i < lc_n_chunks; i++) {
+      // Zero-sized blocks are treated as size 1, as in find_chunk_for.
+      end = lc_chunks[i]->data + (lc_chunks[i]->szB == 0
+                                  ? 1 : lc_chunks[i]->szB);
+      if (lc_chunks[i]->data < prev_end)
+         overlap = True;
+      if (end > lc_chunks_max_addr)
+         lc_chunks_max_addr = end;
+      prev_end = lc_chunks_max_addr;
+   }
+   if (overlap)
+      return;
+
+   // Use about one bucket per chunk.
+   lc_chunk_index_shift = 0;
+   while (lc_chunk_index_shift < 8 * sizeof(Addr) - 1
+          && ((lc_chunks_max_addr - lc_chunks_min_addr - 1)
+              >> lc_chunk_index_shift) >= lc_n_chunks)
+      lc_chunk_index_shift++;
+   n_buckets = ((lc_chunks_max_addr - lc_chunks_min_addr - 1)
+                >> lc_chunk_index_shift) + 1;
+
+   lc_chunk_index = VG_(malloc)( "mc.bci.1", (n_buckets + 1) * sizeof(Int) );
+   i = 0;
+   for (b = 0; b < n_buckets; b++) {
+      Addr b_start = lc_chunks_min_addr + ((Addr)b << lc_chunk_index_shift);
+      while (i < lc_n_chunks
+             && lc_chunks[i]->data + (lc_chunks[i]->szB == 0
+                                      ? 1 : lc_chunks[i]->szB) <= b_start)
+         i++;
+      lc_chunk_index[b] = i;
+   }
+   lc_chunk_index[n_buckets] = lc_n_chunks - 1;
+}
+
+// Same as find_chunk_for(ptr, lc_chunks, lc_n_chunks), using
+// lc_chunk_index.
+static Int find_lc_chunk_for ( Addr ptr )
+{
+   Int lo, hi, ch_no;
+   UWord b;
+
+   if (ptr < lc_chunks_min_addr || ptr >= lc_chunks_max_addr)
+      return -1;
+   if (lc_chunk_index == NULL)
+      return find_chunk_for(ptr, lc_chunks, lc_n_chunks);
+
+   b  = (ptr - lc_chunks_min_addr) >> lc_chunk_index_shift;
+   lo = lc_chunk_index[b];
+   hi = lc_chunk_index[b+1];
+   if (hi >= lc_n_chunks)
+      hi = lc_n_chunks - 1;
+   ch_no = find_chunk_for(ptr, lc_chunks + lo, hi - lo + 1);
+   return ch_no == -1 ? -1 : lo + ch_no;
+}
+
 // Determines if a pointer is to a chunk.  Returns the chunk number et al
 // via call-by-reference.
 static Bool
@@ -528,36 +619,33 @@ lc_is_a_chunk_ptr(Addr ptr, Int* pch_no, MC_Chunk** pch, LC_Extra** pex)
    MC_Chunk* ch;
    LC_Extra* ex;
 
-   // Quick filter. Note: implemented with am, not with get_vabits2
-   // as ptr might be random data pointing anywhere. On 64 bit
-   // platforms, getting va bits for random data can be quite costly
-   // due to the secondary map.
-   if (!VG_(am_is_valid_for_client)(ptr, 1, VKI_PROT_READ)) {
+   // Quick filter: most scanned words do not point in a chunk, and
+   // find_lc_chunk_for rejects those cheaply.  Validity is then checked
+   // with am, not with get_vabits2 as ptr might be random data pointing
+   // anywhere. On 64 bit platforms, getting va bits for random data can
+   // be quite costly due to the secondary map.
+   ch_no = find_lc_chunk_for(ptr);
+   tl_assert(ch_no >= -1 && ch_no < lc_n_chunks);
+
+   if (ch_no == -1 || !VG_(am_is_valid_for_client)(ptr, 1, VKI_PROT_READ)) {
       return False;
    } else {
-      ch_no = find_chunk_for(ptr, lc_chunks, lc_n_chunks);
-      tl_assert(ch_no >= -1 && ch_no < lc_n_chunks);
+      // Ok, we've found a pointer to a chunk.  Get the MC_Chunk and its
+      // LC_Extra.
+      ch = lc_chunks[ch_no];
+      ex = &(lc_extras[ch_no]);
 
-      if (ch_no == -1) {
-         return False;
-      } else {
-         // Ok, we've found a pointer to a chunk.  Get the MC_Chunk and its
-         // LC_Extra.
-         ch = lc_chunks[ch_no];
-         ex = &(lc_extras[ch_no]);
-
-         tl_assert(ptr >= ch->data);
-         tl_assert(ptr < ch->data + ch->szB + (ch->szB==0  ? 1  : 0));
+      tl_assert(ptr >= ch->data);
+      tl_assert(ptr < ch->data + ch->szB + (ch->szB==0  ? 1  : 0));
 
-         if (VG_DEBUG_LEAKCHECK)
-            VG_(printf)("ptr=%#lx -> block %d\n", ptr, ch_no);
+      if (VG_DEBUG_LEAKCHECK)
+         VG_(printf)("ptr=%#lx -> block %d\n", ptr, ch_no);
 
-         *pch_no = ch_no;
-         *pch    = ch;
-         *pex    = ex;
+      *pch_no = ch_no;
+      *pch    = ch;
+      *pex    = ex;
 
-         return True;
-      }
+      return True;
    }
 }
 
@@ -1040,9 +1128,9 @@ void lc_scan_memory_fault_catcher ( Int sigNo, Addr addr )
 // to searched and outputs the places where searched is found.
 // It does not recursively scans the found memory.
 static void
-lc_scan_memory(Addr start, SizeT len, Bool is_prior_definite,
-               Int clique, Int cur_clique,
-               Addr searched, SizeT szB)
+lc_scan_memory_uncached(Addr start, SizeT len, Bool is_prior_definite,
+                        Int clique, Int cur_clique,
+                        Addr searched, SizeT szB)
 {
    /* memory scan is based on the assumption that valid pointers are aligned
       on a multiple of sizeof(Addr). So, we can (and must) skip the begin and
@@ -1177,6 +1265,285 @@ lc_scan_memory(Addr start, SizeT len, Bool is_prior_definite,
 }
 
 
+/*------------------------------------------------------------*/
+/*--- Incremental leak search.                             ---*/
+/*------------------------------------------------------------*/
+
+// With --leak-check-incremental=yes, the leak search remembers, for each
+// piece of LC_PIECE_SIZE bytes it has scanned, the valid words found in
+// it that could be pointers (i.e. are not in page 0) together with their
+// contents.  A later leak search reuses this instead of reading the
+// memory again, as long as mc_main.c says that the memory of the
+// secondary map (64Kb of address space) containing the piece was not
+// written since (see MC_(SM_written)).
+// As memory becoming unreadable, undefined or noaccess is not tracked,
+// the validity of each reused word is checked again.
+//
+// A piece is only read when lc_scan_memory is asked to scan some of it,
+// so the leak search never reads memory it would otherwise skip, such
+// as device mappings.  LC_PIECE_SIZE is not bigger than the page size of
+// any platform: all of a piece is in the mapping being scanned.
+//
+// Pieces with too many candidate pointers, or containing valid words in
+// unreadable pages, are not cached, and are scanned each time.
+// If more than half of the cached secondary maps were written since the
+// previous leak search, the cache is dropped, and the leak search is a
+// full scan.
+
+#define LC_PIECE_SIZE         4096
+#define LC_SM_PIECES          (SM_SIZE / LC_PIECE_SIZE)
+#define LC_PIECE_WORDS        (LC_PIECE_SIZE / sizeof(Addr))
+#define LC_PIECE_MAX_CANDS    (LC_PIECE_WORDS / 4)
+
+// Values of n_cands for pieces which have no candidates cached.
+#define LC_PIECE_NOT_READ     (-2)
+#define LC_PIECE_NOT_CACHED   (-1)
+
+typedef
+   struct {
+      Int     n_cands;  // or LC_PIECE_NOT_READ or LC_PIECE_NOT_CACHED
+      UShort* word_nr;  // word number in the piece of each candidate
+      Addr*   value;    // contents of each candidate
+   }
+   LCPiece;
+
+typedef
+   struct _LCSMCache {
+      struct _LCSMCache* next;
+      UWord              key;      // secondary map base / SM_SIZE
+      LCPiece            piece[LC_SM_PIECES];
+   }
+   LCSMCache;
+
+static VgHashTable* lc_sm_cache = NULL;
+// True while a leak search uses lc_sm_cache.
+static Bool lc_sm_cache_in_use = False;
+// Nr of pieces reused or (re)scanned during the last leak search.
+static UWord lc_sm_cache_n_reused;
+static UWord lc_sm_cache_n_scanned;
+
+static UShort lc_piece_build_word_nr[LC_PIECE_MAX_CANDS];
+static Addr   lc_piece_build_value[LC_PIECE_MAX_CANDS];
+
+static void free_LCSMCache ( void* v )
+{
+   LCSMCache* c = v;
+   Int        i;
+   for (i = 0; i < LC_SM_PIECES; i++) {
+      if (c->piece[i].n_cands > 0) {
+         VG_(free)(c->piece[i].word_nr);
+         VG_(free)(c->piece[i].value);
+      }
+   }
+   VG_(free)(c);
+}
+
+static LCSMCache* lc_sm_cache_get ( Addr sm_base )
+{
+   LCSMCache* c = VG_(HT_lookup)(lc_sm_cache, sm_base / SM_SIZE);
+   Int        i;
+
+   if (c == NULL) {
+      c = VG_(malloc)("mc.lsmcg.1", sizeof(LCSMCache));
+      c->key = sm_base / SM_SIZE;
+      for (i = 0; i < LC_SM_PIECES; i++) {
+         c->piece[i].n_cands = LC_PIECE_NOT_READ;
+         c->piece[i].word_nr = NULL;
+         c->piece[i].value   = NULL;
+      }
+      VG_(HT_add_node)(lc_sm_cache, c);
+   }
+   return c;
+}
+
+static VG_MINIMAL_JMP_BUF(lc_sm_cache_jmpbuf);
+static
+void lc_sm_cache_fault_catcher ( Int sigNo, Addr addr )
+{
+   leak_search_fault_catcher (sigNo, addr,
+                              "lc_sm_cache_fault_catcher",
+                              lc_sm_cache_jmpbuf);
+}
+
+// Scan the whole piece at base, and record its candidates in *pc.
+static void lc_piece_build ( LCPiece* pc, Addr base )
+{
+   fault_catcher_t prev_catcher;
+   Bool            readable;
+   Addr            a, v;
+   Int             n;
+
+   lc_sm_cache_n_scanned++;
+   pc->n_cands = LC_PIECE_NOT_CACHED;
+
+   if (!MC_(is_within_valid_secondary)(base)) {
+      pc->n_cands = 0;
+      return;
+   }
+
+   prev_catcher = VG_(set_fault_catcher)(lc_sm_cache_fault_catcher);
+   if (VG_MINIMAL_SETJMP(lc_sm_cache_jmpbuf) != 0) {
+      // Read error: do not cache this piece.
+      VG_(set_fault_catcher)(prev_catcher);
+      return;
+   }
+
+   n = 0;
+   readable = VG_(am_is_valid_for_client)(base, sizeof(Addr), VKI_PROT_READ);
+   for (a = base; a < base + LC_PIECE_SIZE; a += sizeof(Addr)) {
+      if (!MC_(is_valid_aligned_word)(a))
+         continue;
+      // A valid word in an unreadable page would be seen by a later
+      // leak search if the page becomes readable again.
+      if (!readable || n == LC_PIECE_MAX_CANDS)
+         goto not_cached;
+      v = *(Addr *)a;
+      if (v < VKI_PAGE_SIZE)
+         continue;
+      lc_piece_build_word_nr[n] = (a - base) / sizeof(Addr);
+      lc_piece_build_value[n]   = v;
+      n++;
+   }
+   VG_(set_fault_catcher)(prev_catcher);
+
+   pc->n_cands = n;
+   if (n > 0) {
+      pc->word_nr = VG_(malloc)("mc.lpb.1", n * sizeof(UShort));
+      pc->value   = VG_(malloc)("mc.lpb.2", n * sizeof(Addr));
+      VG_(memcpy)(pc->word_nr, lc_piece_build_word_nr, n * sizeof(UShort));
+      VG_(memcpy)(pc->value,   lc_piece_build_value,   n * sizeof(Addr));
+   }
+   return;
+
+  not_cached:
+   VG_(set_fault_catcher)(prev_catcher);
+}
+
+// Does the same as lc_scan_memory_uncached on [from, to), which must be
+// in the piece at base, using its cached candidates.
+static void lc_piece_scan ( const LCPiece* pc, Addr base,
+                            Addr from, Addr to, Bool is_prior_definite,
+                            Int clique, Int cur_clique )
+{
+   UWord from_nr = (from - base) / sizeof(Addr);
+   Int   lo, hi, mid, i;
+
+   if (pc->n_cands == 0
+       || !VG_(am_is_valid_for_client)(base, sizeof(Addr), VKI_PROT_READ))
+      return;
+
+   // Find the first candidate at or after from.
+   lo = 0;
+   hi = pc->n_cands;
+   while (lo < hi) {
+      mid = (lo + hi) / 2;
+      if (pc->word_nr[mid] < from_nr)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   for (i = lo; i < pc->n_cands; i++) {
+      Addr a = base + pc->word_nr[i] * sizeof(Addr);
+      if (a >= to)
+         break;
+      if (!MC_(is_valid_aligned_word)(a))
+         continue;
+      lc_scanned_szB += sizeof(Addr);
+      lc_push_if_a_chunk_ptr(pc->value[i], clique, cur_clique,
+                             is_prior_definite);
+   }
+}
+
+static void lc_scan_memory_cached(Addr start, SizeT len,
+                                  Bool is_prior_definite,
+                                  Int clique, Int cur_clique)
+{
+   Addr       ptr = VG_ROUNDUP(start, sizeof(Addr));
+   const Addr end = VG_ROUNDDN(start+len, sizeof(Addr));
+
+   while (ptr < end) {
+      Addr       base      = ptr & ~(Addr)(LC_PIECE_SIZE - 1);
+      Addr       piece_end = end - base > LC_PIECE_SIZE
+                             ? base + LC_PIECE_SIZE : end;
+      Addr       sm_base   = ptr & ~(Addr)SM_MASK;
+      LCPiece*   pc        = NULL;
+
+      // Memory not tracked by MC_(SM_written) cannot be cached.
+      if (!MC_(SM_written)(sm_base)) {
+         LCSMCache* c = lc_sm_cache_get(sm_base);
+         pc = &c->piece[(base - sm_base) / LC_PIECE_SIZE];
+         if (pc->n_cands == LC_PIECE_NOT_READ)
+            lc_piece_build(pc, base);
+      }
+
+      if (pc != NULL && pc->n_cands >= 0)
+         lc_piece_scan(pc, base, ptr, piece_end, is_prior_definite,
+                       clique, cur_clique);
+      else
+         lc_scan_memory_uncached(ptr, piece_end - ptr, is_prior_definite,
+                                 clique, cur_clique, /*searched*/ 0, 0);
+      ptr = piece_end;
+   }
+}
+
+// Prepare lc_sm_cache for a new leak search: forget the secondary maps
+// written since the previous one.
+static void lc_sm_cache_start_search(void)
+{
+   LCSMCache* c;
+   UWord      n_cached = 0;
+   UWord      n_written = 0;
+   UWord      n_reused = 0;
+   Int        i;
+
+   if (lc_sm_cache == NULL)
+      lc_sm_cache = VG_(HT_construct)("mc.lsmcss.1");
+
+   VG_(HT_ResetIter)(lc_sm_cache);
+   while ((c = VG_(HT_Next)(lc_sm_cache))) {
+      n_cached++;
+      if (MC_(SM_written)(c->key * SM_SIZE)) {
+         VG_(HT_remove_at_Iter)(lc_sm_cache);
+         free_LCSMCache(c);
+         n_written++;
+      } else {
+         for (i = 0; i < LC_SM_PIECES; i++)
+            if (c->piece[i].n_cands >= 0)
+               n_reused++;
+      }
+   }
+
+   lc_sm_cache_n_reused  = n_reused;
+   lc_sm_cache_n_scanned = 0;
+   if (n_written > n_cached / 2) {
+      // Too much has changed for the cache to be worth maintaining:
+      // do a full scan, and start again with an empty cache next time.
+      VG_(HT_destruct)(lc_sm_cache, free_LCSMCache);
+      lc_sm_cache = VG_(HT_construct)("mc.lsmcss.1");
+      lc_sm_cache_in_use = False;
+      lc_sm_cache_n_reused = 0;
+   } else {
+      lc_sm_cache_in_use = True;
+   }
+   MC_(clear_written_SMs)();
+}
+
+// See lc_scan_memory_uncached.
+static void
+lc_scan_memory(Addr start, SizeT len, Bool is_prior_definite,
+               Int clique, Int cur_clique,
+               Addr searched, SizeT szB)
+{
+   if (lc_sm_cache_in_use && searched == 0)
+      lc_scan_memory_cached(start, len, is_prior_definite,
+                            clique, cur_clique);
+   else
+      lc_scan_memory_uncached(start, len, is_prior_definite,
+                              clique, cur_clique, searched, szB);
+}
+
+
 // Process the mark stack until empty.
 static void lc_process_markstack(Int clique)
 {
@@ -2020,6 +2387,7 @@ void MC_(detect_memory_leaks) ( ThreadId tid, LeakCheckParams* lcp)
    lc_chunks_n_frees_marker = MC_(get_cmalloc_n_frees)();
    if (lc_n_chunks == 0) {
       tl_assert(lc_chunks == NULL);
+      build_chunk_index();
       if (lr_table != NULL) {
          // forget the previous recorded LossRecords as next leak search
          // can in any case just create new leaks.
@@ -2143,6 +2511,8 @@ void MC_(detect_memory_leaks) ( ThreadId tid, LeakCheckParams* lcp)
       }
    }
 
+   build_chunk_index();
+
    // Initialise lc_extras.
    if (lc_extras) {
       VG_(free)(lc_extras);
@@ -2169,6 +2539,9 @@ void MC_(detect_memory_leaks) ( ThreadId tid, LeakCheckParams* lcp)
                  lc_n_chunks );
    }
 
+   if (MC_(clo_leak_check_incremental))
+      lc_sm_cache_start_search();
+
    // Scan the memory root-set, pushing onto the mark stack any blocks
    // pointed to.
    scan_memory_root_set(/*searched*/0, 0);
@@ -2182,6 +2555,9 @@ void MC_(detect_memory_leaks) ( ThreadId tid, LeakCheckParams* lcp)
 
    if (VG_(clo_verbosity) > 1 && !VG_(clo_xml)) {
       VG_(umsg)("Checked %'lu bytes\n", lc_scanned_szB);
+      if (MC_(clo_leak_check_incremental))
+         VG_(umsg)("Reused %'lu and scanned %'lu cached memory regions\n",
+                   lc_sm_cache_n_reused, lc_sm_cache_n_scanned);
       if (lc_sig_skipped_szB > 0)
          VG_(umsg)("Skipped %'lu bytes due to read errors\n",
                    lc_sig_skipped_szB);
@@ -2218,6 +2594,8 @@ void MC_(detect_memory_leaks) ( ThreadId tid, LeakCheckParams* lcp)
       }
    }
 
+   lc_sm_cache_in_use = False;
+
    print_results( tid, lcp);
 
    VG_(free) ( lc_markstack );
@@ -45,6 +45,7 @@
 #include "pub_tool_replacemalloc.h"
 #include "pub_tool_tooliface.h"
 #include "pub_tool_threadstate.h"
+#include "pub_tool_transtab.h"
 #include "pub_tool_xarray.h"
 #include "pub_tool_xtree.h"
 #include "pub_tool_xtmemory.h"
@@ -141,9 +142,11 @@ static void ocache_sarp_Clear_Origins ( Addr, UWord ); /* fwds */
    scheme we'd have a four-level table which would require too many memory
    accesses.  So instead the top-level map table has 2^20 entries (indexed
    using bits 16..35 of the address);  this covers the bottom 64GB.  Any
-   accesses above 64GB are handled with a slow, sparse auxiliary table.
-   Valgrind's address space manager tries very hard to keep things below
-   this 64GB barrier so that performance doesn't suffer too much.
+   accesses above 64GB are handled with a sparse radix tree, the high
+   map, which costs a few more memory accesses and is not handled by the
+   fastest load/store paths.  Valgrind's address space manager tries very
+   hard to keep things below this 64GB barrier so that performance
+   doesn't suffer too much.
 
    Note that this file has a lot of different functions for reading and
    writing shadow memory.  Only a couple are strictly necessary (eg.
@@ -169,8 +172,8 @@ static void ocache_sarp_Clear_Origins ( Addr, UWord ); /* fwds */
 
 #else
 
-/* Just handle the first 128G fast and the rest via auxiliary
-   primaries.  If you change this, Memcheck will assert at startup.
+/* Just handle the first 128G fast and the rest via the high
+   map.  If you change this, Memcheck will assert at startup.
    See the definition of UNALIGNED_OR_HIGH for extensive comments. */
 #  define N_PRIMARY_BITS  21
 
@@ -286,24 +289,43 @@ typedef
 #define SM_DIST_UNDEFINED  1
 #define SM_DIST_DEFINED    2
 
-static SecMap sm_distinguished[3];
+// After those come N_SHARED_SMS shared secondary maps, each holding
+// the contents of a set of secondaries found to be identical by
+// share_secmaps.  They are read-only just like the first 3, and live
+// in the same array so that is_distinguished_sm stays a single range
+// check; hence everything below which makes a writable copy of a
+// distinguished secondary handles the shared ones too.
+#define N_SHARED_SMS       125
+#define N_DIST_SMS         (3 + N_SHARED_SMS)
+
+static SecMap sm_distinguished[N_DIST_SMS];
 
 static INLINE Bool is_distinguished_sm ( SecMap* sm ) {
-   return sm >= &sm_distinguished[0] && sm <= &sm_distinguished[2];
+   return sm >= &sm_distinguished[0]
+          && sm <= &sm_distinguished[N_DIST_SMS-1];
+}
+
+static INLINE Bool is_shared_sm ( SecMap* sm ) {
+   return sm > &sm_distinguished[SM_DIST_DEFINED]
+          && sm <= &sm_distinguished[N_DIST_SMS-1];
 }
 
+// For each shared secondary, the number of primary map and high map
+// entries pointing at it, and the hash of its contents.  A shared
+// secondary with no references is free.
+static UInt sm_shared_refs[N_SHARED_SMS];
+static UInt sm_shared_hash[N_SHARED_SMS];
+
 // Forward declaration
 static void update_SM_counts(SecMap* oldSM, SecMap* newSM);
 
-/* dist_sm points to one of our three distinguished secondaries.  Make
-   a copy of it so that we can write to it.
+/* dist_sm points to one of our distinguished or shared secondaries.
+   Make a copy of it so that we can write to it.
 */
 static SecMap* copy_for_writing ( SecMap* dist_sm )
 {
    SecMap* new_sm;
-   tl_assert(dist_sm == &sm_distinguished[0]
-          || dist_sm == &sm_distinguished[1]
-          || dist_sm == &sm_distinguished[2]);
+   tl_assert(is_distinguished_sm(dist_sm));
 
    new_sm = VG_(am_shadow_alloc)(sizeof(SecMap));
    if (new_sm == NULL)
@@ -326,14 +348,12 @@ static Int   max_noaccess_SMs  = 0;
 static Int   max_undefined_SMs = 0;
 static Int   max_defined_SMs   = 0;
 static Int   max_non_DSM_SMs   = 0;
+static Int   n_shared_SMs      = 0; // # refs to shared SMs
+static Int   max_shared_SMs    = 0;
 
-/* # searches initiated in auxmap_L1, and # base cmps required */
-static ULong n_auxmap_L1_searches  = 0;
-static ULong n_auxmap_L1_cmps      = 0;
-/* # of searches that missed in auxmap_L1 and therefore had to
-   be handed to auxmap_L2. And the number of nodes inserted. */
-static ULong n_auxmap_L2_searches  = 0;
-static ULong n_auxmap_L2_nodes     = 0;
+/* # of middle tables and leaves allocated in the high map */
+static UWord n_high_map_mids   = 0;
+static UWord n_high_map_leaves = 0;
 
 static Int   n_sanity_cheap     = 0;
 static Int   n_sanity_expensive = 0;
@@ -346,12 +366,16 @@ static void update_SM_counts(SecMap* oldSM, SecMap* newSM)
    if      (oldSM == &sm_distinguished[SM_DIST_NOACCESS ]) n_noaccess_SMs --;
    else if (oldSM == &sm_distinguished[SM_DIST_UNDEFINED]) n_undefined_SMs--;
    else if (oldSM == &sm_distinguished[SM_DIST_DEFINED  ]) n_defined_SMs  --;
+   else if (is_shared_sm(oldSM))                         { n_shared_SMs   --;
+      sm_shared_refs[oldSM - &sm_distinguished[3]]--; }
    else                                                  { n_non_DSM_SMs  --;
                                                            n_deissued_SMs ++; }
 
    if      (newSM == &sm_distinguished[SM_DIST_NOACCESS ]) n_noaccess_SMs ++;
    else if (newSM == &sm_distinguished[SM_DIST_UNDEFINED]) n_undefined_SMs++;
    else if (newSM == &sm_distinguished[SM_DIST_DEFINED  ]) n_defined_SMs  ++;
+   else if (is_shared_sm(newSM))                         { n_shared_SMs   ++;
+      sm_shared_refs[newSM - &sm_distinguished[3]]++; }
    else                                                  { n_non_DSM_SMs  ++;
                                                            n_issued_SMs   ++; }
 
@@ -359,13 +383,14 @@ static void update_SM_counts(SecMap* oldSM, SecMap* newSM)
    if (n_undefined_SMs > max_undefined_SMs) max_undefined_SMs = n_undefined_SMs;
    if (n_defined_SMs   > max_defined_SMs  ) max_defined_SMs   = n_defined_SMs;
    if (n_non_DSM_SMs   > max_non_DSM_SMs  ) max_non_DSM_SMs   = n_non_DSM_SMs;   
+   if (n_shared_SMs    > max_shared_SMs   ) max_shared_SMs    = n_shared_SMs;
 }
 
 /* --------------- Primary maps --------------- */
 
 /* The main primary map.  This covers some initial part of the address
    space, addresses 0 .. (N_PRIMARY_MAP << 16)-1.  The rest of it is
-   handled using the auxiliary primary map.  
+   handled using the high map.
 */
 #if ENABLE_ASSEMBLY_HELPERS && defined(PERF_FAST_LOADV) \
     && (defined(VGP_arm_linux) \
@@ -380,233 +405,178 @@ static void update_SM_counts(SecMap* oldSM, SecMap* newSM)
 MC_MAIN_STATIC SecMap* primary_map[N_PRIMARY_MAP];
 
 
-/* An entry in the auxiliary primary map.  base must be a 64k-aligned
-   value, and sm points at the relevant secondary map.  As with the
-   main primary map, the secondary may be either a real secondary, or
-   one of the three distinguished secondaries.  DO NOT CHANGE THIS
-   LAYOUT: the first word has to be the key for OSet fast lookups.
-*/
-typedef
-   struct { 
-      Addr    base;
-      SecMap* sm;
-   }
-   AuxMapEnt;
+/* The high primary map.  Addresses above MAX_PRIMARY_ADDRESS are
+   handled by a three-level radix tree, indexed by bits 48..63, 28..47
+   and 16..27 of the address.  The top level is static.  The middle
+   and leaf levels are allocated on demand, the first time a secondary
+   map in the range they cover is needed for writing; a missing middle
+   table or leaf means the whole range it would cover is noaccess.  As
+   with the main primary map, every entry of a leaf points to a valid
+   secondary, which may be one of the distinguished secondaries.
 
-/* Tunable parameter: How big is the L1 queue? */
-#define N_AUXMAP_L1 24
+   Leaves are small (32kB, covering 256MB) so that a program scattering
+   its memory all over a large address space, e.g. with an allocator
+   using arenas at high addresses, does not need much memory for them.
+   Middle tables are large (8MB, covering 256TB) but are only touched
+   where leaves are present.  All the leaves are also chained in a list,
+   so that they can be visited without walking the tree. */
 
-/* Tunable parameter: How far along the L1 queue to insert
-   entries resulting from L2 lookups? */
-#define AUXMAP_L1_INSERT_IX 12
+#if VG_WORDSIZE == 4
+#  define N_HIGH_MAP_TOP_BITS  0
+#else
+#  define N_HIGH_MAP_TOP_BITS  16
+#endif
+#define N_HIGH_MAP_MID_BITS   20
+#define N_HIGH_MAP_LEAF_BITS  12
 
-static struct {
-          Addr       base;
-          AuxMapEnt* ent; // pointer to the matching auxmap_L2 node
-       } 
-       auxmap_L1[N_AUXMAP_L1];
+#define N_HIGH_MAP_TOP   ( ((UWord)1) << N_HIGH_MAP_TOP_BITS)
+#define N_HIGH_MAP_MID   ( ((UWord)1) << N_HIGH_MAP_MID_BITS)
+#define N_HIGH_MAP_LEAF  ( ((UWord)1) << N_HIGH_MAP_LEAF_BITS)
 
-static OSet* auxmap_L2 = NULL;
+#define HIGH_MAP_LEAF_IX(_a) \
+   ((UWord)((ULong)(_a) >> 16) & (N_HIGH_MAP_LEAF-1))
+#define HIGH_MAP_MID_IX(_a) \
+   ((UWord)((ULong)(_a) >> (16 + N_HIGH_MAP_LEAF_BITS)) & (N_HIGH_MAP_MID-1))
+#define HIGH_MAP_TOP_IX(_a) \
+   ((UWord)((ULong)(_a) >> 48) & (N_HIGH_MAP_TOP-1))
 
-static void init_auxmap_L1_L2 ( void )
-{
-   Int i;
-   for (i = 0; i < N_AUXMAP_L1; i++) {
-      auxmap_L1[i].base = 0;
-      auxmap_L1[i].ent  = NULL;
+/* A leaf never straddles MAX_PRIMARY_ADDRESS. */
+STATIC_ASSERT(((MAX_PRIMARY_ADDRESS + 1) >> 16) % N_HIGH_MAP_LEAF == 0);
+
+typedef
+   struct _HighMapLeaf {
+      SecMap*              sm[N_HIGH_MAP_LEAF];
+      Addr                 base; // first address covered
+      struct _HighMapLeaf* next; // next in high_map_leaves
    }
+   HighMapLeaf;
 
-   tl_assert(0 == offsetof(AuxMapEnt,base));
-   tl_assert(sizeof(Addr) == sizeof(void*));
-   auxmap_L2 = VG_(OSetGen_Create)( /*keyOff*/  offsetof(AuxMapEnt,base),
-                                    /*fastCmp*/ NULL,
-                                    VG_(malloc), "mc.iaLL.1", VG_(free) );
-}
+typedef
+   struct {
+      HighMapLeaf* leaf[N_HIGH_MAP_MID];
+   }
+   HighMapMid;
+
+static HighMapMid*  high_map[N_HIGH_MAP_TOP];
+static HighMapLeaf* high_map_leaves = NULL;
 
 /* Check representation invariants; if OK return NULL; else a
    descriptive bit of text.  Also return the number of
-   non-distinguished secondary maps referred to from the auxiliary
-   primary maps. */
-
-static const HChar* check_auxmap_L1_L2_sanity ( Word* n_secmaps_found )
-{
-   Word i, j;
-   /* On a 32-bit platform, the L2 and L1 tables should
-      both remain empty forever.
-
-      On a 64-bit platform:
-      In the L2 table:
-       all .base & 0xFFFF == 0
-       all .base > MAX_PRIMARY_ADDRESS
-      In the L1 table:
-       all .base & 0xFFFF == 0
-       all (.base > MAX_PRIMARY_ADDRESS
-            .base & 0xFFFF == 0
-            and .ent points to an AuxMapEnt with the same .base)
-           or
-           (.base == 0 and .ent == NULL)
-   */
-   *n_secmaps_found = 0;
-   if (sizeof(void*) == 4) {
-      /* 32-bit platform */
-      if (VG_(OSetGen_Size)(auxmap_L2) != 0)
-         return "32-bit: auxmap_L2 is non-empty";
-      for (i = 0; i < N_AUXMAP_L1; i++) 
-        if (auxmap_L1[i].base != 0 || auxmap_L1[i].ent != NULL)
-      return "32-bit: auxmap_L1 is non-empty";
-   } else {
-      /* 64-bit platform */
-      UWord elems_seen = 0;
-      AuxMapEnt *elem, *res;
-      AuxMapEnt key;
-      /* L2 table */
-      VG_(OSetGen_ResetIter)(auxmap_L2);
-      while ( (elem = VG_(OSetGen_Next)(auxmap_L2)) ) {
-         elems_seen++;
-         if (0 != (elem->base & (Addr)0xFFFF))
-            return "64-bit: nonzero .base & 0xFFFF in auxmap_L2";
-         if (elem->base <= MAX_PRIMARY_ADDRESS)
-            return "64-bit: .base <= MAX_PRIMARY_ADDRESS in auxmap_L2";
-         if (elem->sm == NULL)
-            return "64-bit: .sm in _L2 is NULL";
-         if (!is_distinguished_sm(elem->sm))
-            (*n_secmaps_found)++;
-      }
-      if (elems_seen != n_auxmap_L2_nodes)
-         return "64-bit: disagreement on number of elems in _L2";
-      /* Check L1-L2 correspondence */
-      for (i = 0; i < N_AUXMAP_L1; i++) {
-         if (auxmap_L1[i].base == 0 && auxmap_L1[i].ent == NULL)
-            continue;
-         if (0 != (auxmap_L1[i].base & (Addr)0xFFFF))
-            return "64-bit: nonzero .base & 0xFFFF in auxmap_L1";
-         if (auxmap_L1[i].base <= MAX_PRIMARY_ADDRESS)
-            return "64-bit: .base <= MAX_PRIMARY_ADDRESS in auxmap_L1";
-         if (auxmap_L1[i].ent == NULL)
-            return "64-bit: .ent is NULL in auxmap_L1";
-         if (auxmap_L1[i].ent->base != auxmap_L1[i].base)
-            return "64-bit: _L1 and _L2 bases are inconsistent";
-         /* Look it up in auxmap_L2. */
-         key.base = auxmap_L1[i].base;
-         key.sm   = 0;
-         res = VG_(OSetGen_Lookup)(auxmap_L2, &key);
-         if (res == NULL)
-            return "64-bit: _L1 .base not found in _L2";
-         if (res != auxmap_L1[i].ent)
-            return "64-bit: _L1 .ent disagrees with _L2 entry";
-      }
-      /* Check L1 contains no duplicates */
-      for (i = 0; i < N_AUXMAP_L1; i++) {
-         if (auxmap_L1[i].base == 0)
-            continue;
-	 for (j = i+1; j < N_AUXMAP_L1; j++) {
-            if (auxmap_L1[j].base == 0)
-               continue;
-            if (auxmap_L1[j].base == auxmap_L1[i].base)
-               return "64-bit: duplicate _L1 .base entries";
-         }
-      }
-   }
-   return NULL; /* ok */
-}
+   non-distinguished secondary maps referred to from the high map. */
 
-static void insert_into_auxmap_L1_at ( Word rank, AuxMapEnt* ent )
+static const HChar* check_high_map_sanity ( Word* n_secmaps_found )
 {
-   Word i;
-   tl_assert(ent);
-   tl_assert(rank >= 0 && rank < N_AUXMAP_L1);
-   for (i = N_AUXMAP_L1-1; i > rank; i--)
-      auxmap_L1[i] = auxmap_L1[i-1];
-   auxmap_L1[rank].base = ent->base;
-   auxmap_L1[rank].ent  = ent;
-}
-
-static INLINE AuxMapEnt* maybe_find_in_auxmap ( Addr a )
-{
-   AuxMapEnt  key;
-   AuxMapEnt* res;
-   Word       i;
-
-   tl_assert(a > MAX_PRIMARY_ADDRESS);
-   a &= ~(Addr)0xFFFF;
-
-   /* First search the front-cache, which is a self-organising
-      list containing the most popular entries. */
-
-   if (LIKELY(auxmap_L1[0].base == a))
-      return auxmap_L1[0].ent;
-   if (LIKELY(auxmap_L1[1].base == a)) {
-      Addr       t_base = auxmap_L1[0].base;
-      AuxMapEnt* t_ent  = auxmap_L1[0].ent;
-      auxmap_L1[0].base = auxmap_L1[1].base;
-      auxmap_L1[0].ent  = auxmap_L1[1].ent;
-      auxmap_L1[1].base = t_base;
-      auxmap_L1[1].ent  = t_ent;
-      return auxmap_L1[0].ent;
-   }
+   UWord        i, j, n_mids = 0, n_leaves = 0;
+   HighMapLeaf* leaf;
 
-   n_auxmap_L1_searches++;
+   *n_secmaps_found = 0;
 
-   for (i = 0; i < N_AUXMAP_L1; i++) {
-      if (auxmap_L1[i].base == a) {
-         break;
+   /* The tree. */
+   for (i = 0; i < N_HIGH_MAP_TOP; i++) {
+      if (high_map[i] == NULL)
+         continue;
+      if (sizeof(void*) == 4)
+         return "32-bit: high map is non-empty";
+      n_mids++;
+      for (j = 0; j < N_HIGH_MAP_MID; j++) {
+         leaf = high_map[i]->leaf[j];
+         if (leaf == NULL)
+            continue;
+         n_leaves++;
+         if (HIGH_MAP_TOP_IX(leaf->base) != i
+             || HIGH_MAP_MID_IX(leaf->base) != j
+             || HIGH_MAP_LEAF_IX(leaf->base) != 0
+             || 0 != (leaf->base & (Addr)0xFFFF))
+            return "leaf .base disagrees with its position in the high map";
+         if (leaf->base <= MAX_PRIMARY_ADDRESS)
+            return ".base <= MAX_PRIMARY_ADDRESS in high map leaf";
       }
    }
-   tl_assert(i >= 0 && i <= N_AUXMAP_L1);
-
-   n_auxmap_L1_cmps += (ULong)(i+1);
-
-   if (i < N_AUXMAP_L1) {
-      if (i > 0) {
-         Addr       t_base = auxmap_L1[i-1].base;
-         AuxMapEnt* t_ent  = auxmap_L1[i-1].ent;
-         auxmap_L1[i-1].base = auxmap_L1[i-0].base;
-         auxmap_L1[i-1].ent  = auxmap_L1[i-0].ent;
-         auxmap_L1[i-0].base = t_base;
-         auxmap_L1[i-0].ent  = t_ent;
-         i--;
+   if (n_mids != n_high_map_mids || n_leaves != n_high_map_leaves)
+      return "disagreement on number of high map tables";
+
+   /* The list of leaves. */
+   for (leaf = high_map_leaves; leaf; leaf = leaf->next) {
+      if (n_leaves-- == 0)
+         return "high map leaf list is too long";
+      if (high_map[HIGH_MAP_TOP_IX(leaf->base)] == NULL
+          || high_map[HIGH_MAP_TOP_IX(leaf->base)]
+                ->leaf[HIGH_MAP_MID_IX(leaf->base)] != leaf)
+         return "high map leaf list entry not found in the high map";
+      for (i = 0; i < N_HIGH_MAP_LEAF; i++) {
+         if (leaf->sm[i] == NULL)
+            return ".sm in high map leaf is NULL";
+         if (!is_distinguished_sm(leaf->sm[i]))
+            (*n_secmaps_found)++;
       }
-      return auxmap_L1[i].ent;
    }
+   if (n_leaves != 0)
+      return "high map leaf list is too short";
 
-   n_auxmap_L2_searches++;
+   return NULL; /* ok */
+}
 
-   /* First see if we already have it. */
-   key.base = a;
-   key.sm   = 0;
+/* Return the high map entry for 'a', or NULL if there is none, in
+   which case 'a' is noaccess. */
+static INLINE SecMap** maybe_find_in_high_map ( Addr a )
+{
+   HighMapMid*  mid;
+   HighMapLeaf* leaf;
 
-   res = VG_(OSetGen_Lookup)(auxmap_L2, &key);
-   if (res)
-      insert_into_auxmap_L1_at( AUXMAP_L1_INSERT_IX, res );
-   return res;
+   tl_assert(a > MAX_PRIMARY_ADDRESS);
+
+   mid = high_map[HIGH_MAP_TOP_IX(a)];
+   if (UNLIKELY(mid == NULL))
+      return NULL;
+   leaf = mid->leaf[HIGH_MAP_MID_IX(a)];
+   if (UNLIKELY(leaf == NULL))
+      return NULL;
+   return &leaf->sm[HIGH_MAP_LEAF_IX(a)];
 }
 
-static AuxMapEnt* find_or_alloc_in_auxmap ( Addr a )
+static SecMap** find_or_alloc_in_high_map ( Addr a )
 {
-   AuxMapEnt *nyu, *res;
+   SecMap**     res;
+   HighMapMid*  mid;
+   HighMapLeaf* leaf;
+   UWord        i;
 
    /* First see if we already have it. */
-   res = maybe_find_in_auxmap( a );
+   res = maybe_find_in_high_map( a );
    if (LIKELY(res))
       return res;
 
-   /* Ok, there's no entry in the secondary map, so we'll have
-      to allocate one. */
-   a &= ~(Addr)0xFFFF;
-
-   nyu = (AuxMapEnt*) VG_(OSetGen_AllocNode)( auxmap_L2, sizeof(AuxMapEnt) );
-   nyu->base = a;
-   nyu->sm   = &sm_distinguished[SM_DIST_NOACCESS];
-   VG_(OSetGen_Insert)( auxmap_L2, nyu );
-   insert_into_auxmap_L1_at( AUXMAP_L1_INSERT_IX, nyu );
-   n_auxmap_L2_nodes++;
-   return nyu;
+   /* No, so allocate whatever is missing on the way down.  Fresh
+      shadow memory is zeroed, so new middle tables are empty. */
+   mid = high_map[HIGH_MAP_TOP_IX(a)];
+   if (mid == NULL) {
+      mid = VG_(am_shadow_alloc)(sizeof(HighMapMid));
+      if (mid == NULL)
+         VG_(out_of_memory_NORETURN)( "memcheck:allocate high map table",
+                                      sizeof(HighMapMid) );
+      high_map[HIGH_MAP_TOP_IX(a)] = mid;
+      n_high_map_mids++;
+   }
+
+   leaf = VG_(am_shadow_alloc)(sizeof(HighMapLeaf));
+   if (leaf == NULL)
+      VG_(out_of_memory_NORETURN)( "memcheck:allocate high map leaf",
+                                   sizeof(HighMapLeaf) );
+   for (i = 0; i < N_HIGH_MAP_LEAF; i++)
+      leaf->sm[i] = &sm_distinguished[SM_DIST_NOACCESS];
+   leaf->base = a & ~(((Addr)N_HIGH_MAP_LEAF << 16) - 1);
+   leaf->next = high_map_leaves;
+   high_map_leaves = leaf;
+   mid->leaf[HIGH_MAP_MID_IX(a)] = leaf;
+   n_high_map_leaves++;
+
+   return &leaf->sm[HIGH_MAP_LEAF_IX(a)];
 }
 
 /* --------------- SecMap fundamentals --------------- */
 
 // In all these, 'low' means it's definitely in the main primary map,
-// 'high' means it's definitely in the auxiliary table.
+// 'high' means it's definitely in the high map.
 
 static INLINE UWord get_primary_map_low_offset ( Addr a )
 {
@@ -625,8 +595,7 @@ static INLINE SecMap** get_secmap_low_ptr ( Addr a )
 
 static INLINE SecMap** get_secmap_high_ptr ( Addr a )
 {
-   AuxMapEnt* am = find_or_alloc_in_auxmap(a);
-   return &am->sm;
+   return find_or_alloc_in_high_map(a);
 }
 
 static INLINE SecMap** get_secmap_ptr ( Addr a )
@@ -643,7 +612,8 @@ static INLINE SecMap* get_secmap_for_reading_low ( Addr a )
 
 static INLINE SecMap* get_secmap_for_reading_high ( Addr a )
 {
-   return *get_secmap_high_ptr(a);
+   SecMap** p = maybe_find_in_high_map(a);
+   return LIKELY(p) ? *p : &sm_distinguished[SM_DIST_NOACCESS];
 }
 
 static INLINE SecMap* get_secmap_for_writing_low(Addr a)
@@ -662,10 +632,9 @@ static INLINE SecMap* get_secmap_for_writing_high ( Addr a )
    return *p;
 }
 
-/* Produce the secmap for 'a', either from the primary map or by
-   ensuring there is an entry for it in the aux primary map.  The
-   secmap may be a distinguished one as the caller will only want to
-   be able to read it. 
+/* Produce the secmap for 'a', either from the primary map or from
+   the high map.  The secmap may be a distinguished one as the caller
+   will only want to be able to read it.
 */
 static INLINE SecMap* get_secmap_for_reading ( Addr a )
 {
@@ -675,7 +644,7 @@ static INLINE SecMap* get_secmap_for_reading ( Addr a )
 }
 
 /* Produce the secmap for 'a', either from the primary map or by
-   ensuring there is an entry for it in the aux primary map.  The
+   ensuring there is an entry for it in the high map.  The
    secmap may not be a distinguished one, since the caller will want
    to be able to write it.  If it is a distinguished secondary, make a
    writable copy of it, install it, and return the copy instead.  (COW
@@ -697,8 +666,8 @@ static SecMap* maybe_get_secmap_for ( Addr a )
    if (a <= MAX_PRIMARY_ADDRESS) {
       return get_secmap_for_reading_low(a);
    } else {
-      AuxMapEnt* am = maybe_find_in_auxmap(a);
-      return am ? am->sm : NULL;
+      SecMap** p = maybe_find_in_high_map(a);
+      return p ? *p : NULL;
    }
 }
 
@@ -740,8 +709,21 @@ UChar extract_vabits4_from_vabits8 ( Addr a, UChar vabits8 )
    return 0xf & vabits8;               // mask out the rest
 }
 
+/* True if the vabits4 in vabits8 indicate a and a+1 are accessible. */
+static INLINE
+Bool accessible_vabits4_in_vabits8 ( Addr a, UChar vabits8 )
+{
+   UInt shift;
+   tl_assert(VG_IS_2_ALIGNED(a));      // Must be 2-aligned
+   shift = (a & 2) << 1;               // shift by 0 or 4
+   vabits8 >>= shift;                  // shift the four bits to the bottom
+    // check 2 x vabits2 != VA_BITS2_NOACCESS
+   return ((0x3 & vabits8) != VA_BITS2_NOACCESS)
+      &&  ((0xc & vabits8) != VA_BITS2_NOACCESS << 2);
+}
+
 // Note that these four are only used in slow cases.  The fast cases do
-// clever things like combine the auxmap check (in
+// clever things like combine the high map check (in
 // get_secmap_{read,writ}able) with alignment checks.
 
 // *** WARNING! ***
@@ -1075,6 +1057,306 @@ static INLINE UWord byte_offset_w ( UWord wordszB, Bool bigendian,
 }
 
 
+/* --------------- Sharing of secondary maps --------------- */
+
+/* Secondaries are copied from the distinguished ones as soon as a
+   part of the memory they cover gets different V+A bits, and stay
+   private after that even if that memory later goes back to being
+   uniform (for instance, an array allocated undefined and then fully
+   written).  Also, a large program often has many secondaries with
+   exactly the same contents.  So, when the number of private
+   secondaries has doubled since the previous time, share_secmaps
+   looks at all of them: the ones which are uniformly noaccess,
+   undefined or defined are replaced by the matching distinguished
+   secondary, and the ones with the same contents as another one are
+   replaced by a shared secondary, as long as there is a free one.
+   Writing to any of these later makes a private copy again, in the
+   usual way.
+
+   This is only done between runs of client code (see
+   mc_start_client_code), since the code above may hold pointers to
+   secondaries it is writing to. */
+
+#define SHARE_SECMAPS_MIN  1024
+
+static Int   next_share_secmaps_at = SHARE_SECMAPS_MIN;
+
+static Int   n_share_passes     = 0;
+static ULong n_SMs_to_DSM       = 0; // private SMs replaced by a DSM
+static ULong n_SMs_to_shared    = 0; // private SMs replaced by a shared SM
+
+/* Hash the contents of sm, and say whether it is uniformly one of the
+   three distinguished ones.  Returns the index of that distinguished
+   secondary, or -1. */
+static Int hash_secmap ( const SecMap* sm, /*OUT*/UInt* hash )
+{
+   const ULong* w = (const ULong*)sm;
+   ULong h0 = 0, h1 = 0, h2 = 0, h3 = 0; // 4 of them, for speed
+   ULong w0 = w[0];
+   ULong diff = 0;
+   UWord i;
+
+   STATIC_ASSERT(sizeof(SecMap) % (4 * sizeof(ULong)) == 0);
+   for (i = 0; i < sizeof(SecMap) / sizeof(ULong); i += 4) {
+      h0 = (h0 ^ w[i+0]) * 0x100000001b3ULL;
+      h1 = (h1 ^ w[i+1]) * 0x100000001b3ULL;
+      h2 = (h2 ^ w[i+2]) * 0x100000001b3ULL;
+      h3 = (h3 ^ w[i+3]) * 0x100000001b3ULL;
+      diff |= (w[i+0] ^ w0) | (w[i+1] ^ w0) | (w[i+2] ^ w0) | (w[i+3] ^ w0);
+   }
+   h0 ^= (h1 << 1) ^ (h2 << 2) ^ (h3 << 3);
+   *hash = (UInt)(h0 ^ (h0 >> 32));
+   if (diff == 0) {
+      if (w0 == 0x0101010101010101ULL * VA_BITS8_NOACCESS)
+         return SM_DIST_NOACCESS;
+      if (w0 == 0x0101010101010101ULL * VA_BITS8_UNDEFINED)
+         return SM_DIST_UNDEFINED;
+      if (w0 == 0x0101010101010101ULL * VA_BITS8_DEFINED)
+         return SM_DIST_DEFINED;
+   }
+   return -1;
+}
+
+/* Point *sm_ptr at the read-only secondary new_sm instead of the
+   private one it points at, and free the private one. */
+static void replace_private_secmap ( SecMap** sm_ptr, SecMap* new_sm )
+{
+   SecMap* old_sm = *sm_ptr;
+   SysRes  sres;
+
+   tl_assert(!is_distinguished_sm(old_sm));
+   tl_assert(is_distinguished_sm(new_sm));
+   update_SM_counts(old_sm, new_sm);
+   *sm_ptr = new_sm;
+   sres = VG_(am_munmap_valgrind)((Addr)old_sm, sizeof(SecMap));
+   tl_assert2(! sr_isError(sres), "SecMap valgrind munmap failure\n");
+}
+
+/* A private secondary seen in this pass, for finding the next one
+   with the same contents. */
+typedef
+   struct {
+      SecMap** sm_ptr; // NULL if the slot is empty
+      UInt     hash;
+   }
+   SeenSecMap;
+
+static void share_secmap ( SecMap** sm_ptr,
+                           SeenSecMap* seen, UWord seen_mask )
+{
+   SecMap* sm = *sm_ptr;
+   UInt    hash;
+   Int     dsm_num;
+   UWord   i, j;
+
+   if (is_distinguished_sm(sm))
+      return;
+
+   dsm_num = hash_secmap(sm, &hash);
+   if (dsm_num >= 0) {
+      replace_private_secmap(sm_ptr, &sm_distinguished[dsm_num]);
+      n_SMs_to_DSM++;
+      return;
+   }
+
+   /* Is there a shared secondary with the same contents already? */
+   for (i = 0; i < N_SHARED_SMS; i++) {
+      SecMap* shared_sm = &sm_distinguished[3 + i];
+      if (sm_shared_refs[i] > 0 && sm_shared_hash[i] == hash
+          && VG_(memcmp)(shared_sm, sm, sizeof(SecMap)) == 0) {
+         replace_private_secmap(sm_ptr, shared_sm);
+         n_SMs_to_shared++;
+         return;
+      }
+   }
+
+   /* Otherwise, was a private one with the same contents seen before?
+      If so, give both of them a new shared secondary. */
+   for (j = hash & seen_mask; seen[j].sm_ptr != NULL;
+        j = (j + 1) & seen_mask) {
+      if (seen[j].hash == hash
+          && !is_distinguished_sm(*seen[j].sm_ptr)
+          && VG_(memcmp)(*seen[j].sm_ptr, sm, sizeof(SecMap)) == 0) {
+         for (i = 0; i < N_SHARED_SMS; i++)
+            if (sm_shared_refs[i] == 0)
+               break;
+         if (i == N_SHARED_SMS)
+            return; // No free shared secondary.
+         VG_(memcpy)(&sm_distinguished[3 + i], sm, sizeof(SecMap));
+         sm_shared_hash[i] = hash;
+         replace_private_secmap(seen[j].sm_ptr, &sm_distinguished[3 + i]);
+         replace_private_secmap(sm_ptr, &sm_distinguished[3 + i]);
+         n_SMs_to_shared += 2;
+         return;
+      }
+   }
+   seen[j].sm_ptr = sm_ptr;
+   seen[j].hash   = hash;
+}
+
+static void share_secmaps ( void )
+{
+   SeenSecMap*  seen;
+   UWord        seen_size, i;
+   HighMapLeaf* leaf;
+   Int          n_before = n_non_DSM_SMs;
+
+   /* Room for all the private secondaries, at most half full. */
+   for (seen_size = 1; seen_size < 2 * (UWord)n_non_DSM_SMs; seen_size *= 2)
+      ;
+   seen = VG_(calloc)("mc.share_secmaps.1", seen_size, sizeof(SeenSecMap));
+
+   for (i = 0; i < N_PRIMARY_MAP; i++)
+      share_secmap(&primary_map[i], seen, seen_size - 1);
+   for (leaf = high_map_leaves; leaf; leaf = leaf->next)
+      for (i = 0; i < N_HIGH_MAP_LEAF; i++)
+         share_secmap(&leaf->sm[i], seen, seen_size - 1);
+
+   VG_(free)(seen);
+   n_share_passes++;
+   next_share_secmaps_at = 2 * n_non_DSM_SMs;
+   if (next_share_secmaps_at < SHARE_SECMAPS_MIN)
+      next_share_secmaps_at = SHARE_SECMAPS_MIN;
+
+   if (VG_(clo_verbosity) > 1)
+      VG_(message)(Vg_DebugMsg,
+                   "share_secmaps: %d private secondaries before, %d after\n",
+                   n_before, n_non_DSM_SMs);
+}
+
+/* --------------- Sampling --------------- */
+
+/* With --sample-rate=N, MC_(instrument) only instruments about one
+   superblock in N, chosen by hashing its guest address with
+   sample_epoch.  The others run at full speed, unchecked.  Every
+   SAMPLE_PERIOD_BBS blocks executed, sample_epoch changes and all the
+   translations are discarded, so that a different set of superblocks
+   gets instrumented as the code is translated again.
+
+   The V bits of memory written by uninstrumented code would not be
+   updated, so in this mode memory is made defined rather than
+   undefined when it becomes addressable (see make_mem_undefined), and
+   only addressability errors can be reported.  Heap blocks, stacks
+   and mappings are still tracked precisely, since that is done by
+   the core events rather than by the instrumentation.
+
+   With --translation-cache, a saved translation keeps the sampling
+   decision made when it was saved; it is just another random pick. */
+
+#define SAMPLE_PERIOD_BBS  100000000ULL
+
+static UInt  sample_epoch          = 0;
+static ULong next_sample_period_at = SAMPLE_PERIOD_BBS;
+static ULong n_SBs_sampled         = 0;
+static ULong n_SBs_not_sampled     = 0;
+
+Bool MC_(sample_SB) ( Addr guest_addr )
+{
+   ULong h = ((ULong)guest_addr ^ ((ULong)sample_epoch << 32))
+             * 0x9E3779B97F4A7C15ULL;
+   tl_assert(MC_(clo_sample_rate) > 1);
+   if ((h >> 32) % MC_(clo_sample_rate) == 0) {
+      n_SBs_sampled++;
+      return True;
+   }
+   n_SBs_not_sampled++;
+   return False;
+}
+
+static void print_sampling_summary ( void )
+{
+   /* An invalid access in a given superblock is seen in a period with
+      probability 1/N, and independently in each period. */
+   Double p1    = 1.0 / MC_(clo_sample_rate);
+   Double p_all = 1.0;
+   UInt   i;
+   for (i = 0; i <= sample_epoch; i++)
+      p_all *= 1.0 - p1;
+   p_all = 1.0 - p_all;
+
+   VG_(umsg)("Sampling: %'llu of %'llu superblock translations "
+             "instrumented (1 in %u)\n",
+             n_SBs_sampled, n_SBs_sampled + n_SBs_not_sampled,
+             MC_(clo_sample_rate));
+   VG_(umsg)("Sampling: chance of detecting an invalid read or write: "
+             "%.1f%% per period,\n", 100.0 * p1);
+   VG_(umsg)("Sampling: %.1f%% if it recurs in all %u period(s).  "
+             "Uninitialised values were not checked.\n",
+             100.0 * p_all, sample_epoch + 1);
+   VG_(umsg)("\n");
+}
+
+static void mc_start_client_code ( ThreadId tid, ULong bbs_done )
+{
+   if (UNLIKELY(n_non_DSM_SMs >= next_share_secmaps_at)
+       && MC_(clo_share_secmaps))
+      share_secmaps();
+
+   if (UNLIKELY(MC_(clo_sample_rate) > 1)
+       && bbs_done >= next_sample_period_at) {
+      sample_epoch++;
+      next_sample_period_at = bbs_done + SAMPLE_PERIOD_BBS;
+      VG_(discard_all_translations_soon)( "memcheck sampling" );
+   }
+}
+
+
+/* --------------- Written secondary maps --------------- */
+
+/* With --leak-check-incremental=yes, the leak search reuses what it
+   found in the memory covered by a secondary map if that memory was not
+   written since the previous leak search.  written_SMs has one entry
+   per primary map entry, set to 1 by anything that can change the
+   contents or the definedness of the memory it covers: client stores
+   (see MC_(helperc_mark_written)) and the functions below that make
+   memory defined (syscalls writing memory, mmap, realloc, ...).  Memory
+   becoming undefined or noaccess does not need to be tracked, as the
+   leak search rechecks the definedness of what it reuses.  Memory
+   above MAX_PRIMARY_ADDRESS is not tracked and is always considered
+   written.  NULL when not used. */
+static UChar* written_SMs = NULL;
+
+static INLINE void mark_written ( Addr a, SizeT len )
+{
+   UWord i, last;
+
+   if (LIKELY(written_SMs == NULL) || len == 0 || a > MAX_PRIMARY_ADDRESS)
+      return;
+   last = a + len - 1 < a || a + len - 1 > MAX_PRIMARY_ADDRESS
+          ? MAX_PRIMARY_ADDRESS : a + len - 1;
+   for (i = a >> 16; i <= (last >> 16); i++)
+      written_SMs[i] = 1;
+}
+
+/* Stores are at most 32 bytes (V256), so marking the secondary maps of
+   a and a+31 covers the whole store. */
+VG_REGPARM(1)
+void MC_(helperc_mark_written) ( Addr a )
+{
+   written_SMs[(a & MAX_PRIMARY_ADDRESS) >> 16] = 1;
+   written_SMs[((a + 31) & MAX_PRIMARY_ADDRESS) >> 16] = 1;
+}
+
+Bool MC_(SM_written) ( Addr a )
+{
+   tl_assert(written_SMs);
+   return a > MAX_PRIMARY_ADDRESS || written_SMs[a >> 16];
+}
+
+void MC_(clear_written_SMs) ( void )
+{
+   tl_assert(written_SMs);
+   VG_(memset)(written_SMs, 0, N_PRIMARY_MAP);
+}
+
+static void init_written_SMs ( void )
+{
+   // Initially, everything is considered as written.
+   written_SMs = VG_(malloc)("mc.iwSMs.1", N_PRIMARY_MAP);
+   VG_(memset)(written_SMs, 1, N_PRIMARY_MAP);
+}
+
+
 /* --------------- Ignored address ranges --------------- */
 
 /* Denotes the address-error-reportability status for address ranges:
@@ -1230,6 +1512,8 @@ static Bool modify_ignore_ranges ( Bool addRange, Addr start, Addr len )
    } else {
       VG_(bindRangeMap)(gIgnoredAddressRanges,
                         start, start+len-1, IAR_NotIgnored);
+      // Words in the range can now be seen by the leak search.
+      mark_written(start, len);
       if (verbose)
          VG_(dmsg)("memcheck: modify_ignore_ranges: del %p %p\n",
                    (void*)start, (void*)(start+len-1));
@@ -1395,12 +1679,12 @@ ULong mc_LOADVn_slow ( Addr a, SizeT nBits, Bool bigendian )
    PROF_EVENT(MCPE_LOADVN_SLOW);
 
    /* ------------ BEGIN semi-fast cases ------------ */
-   /* These deal quickly-ish with the common auxiliary primary map
+   /* These deal quickly-ish with the common high map
       cases on 64-bit platforms.  Are merely a speedup hack; can be
       omitted without loss of correctness/functionality.  Note that in
-      both cases the "sizeof(void*) == 8" causes these cases to be
+      all cases the "sizeof(void*) == 8" causes these cases to be
       folded out by compilers on 32-bit platforms.  These are derived
-      from LOADV64 and LOADV32.
+      from LOADV64, LOADV32, LOADV16 and LOADV8.
    */
 
 #  if defined(VGA_mips64) && defined(VGABI_N32)
@@ -1435,6 +1719,38 @@ ULong mc_LOADVn_slow ( Addr a, SizeT nBits, Bool bigendian )
       /* else fall into slow case */
    }
 
+#  if defined(VGA_mips64) && defined(VGABI_N32)
+   if (LIKELY(sizeof(void*) == 4 && nBits == 16 && VG_IS_2_ALIGNED(a)))
+#  else
+   if (LIKELY(sizeof(void*) == 8 && nBits == 16 && VG_IS_2_ALIGNED(a)))
+#  endif
+   {
+      SecMap* sm = get_secmap_for_reading(a);
+      UWord sm_off = SM_OFF(a);
+      UChar vabits4 = extract_vabits4_from_vabits8(a, sm->vabits8[sm_off]);
+      if (LIKELY(vabits4 == VA_BITS4_DEFINED))
+         return ((UWord)0xFFFFFFFFFFFF0000ULL | (UWord)V_BITS16_DEFINED);
+      if (LIKELY(vabits4 == VA_BITS4_UNDEFINED))
+         return ((UWord)0xFFFFFFFFFFFF0000ULL | (UWord)V_BITS16_UNDEFINED);
+      /* else fall into slow case */
+   }
+
+#  if defined(VGA_mips64) && defined(VGABI_N32)
+   if (LIKELY(sizeof(void*) == 4 && nBits == 8))
+#  else
+   if (LIKELY(sizeof(void*) == 8 && nBits == 8))
+#  endif
+   {
+      SecMap* sm = get_secmap_for_reading(a);
+      UWord sm_off = SM_OFF(a);
+      UChar vabits2 = extract_vabits2_from_vabits8(a, sm->vabits8[sm_off]);
+      if (LIKELY(vabits2 == VA_BITS2_DEFINED))
+         return ((UWord)0xFFFFFFFFFFFFFF00ULL | (UWord)V_BITS8_DEFINED);
+      if (LIKELY(vabits2 == VA_BITS2_UNDEFINED))
+         return ((UWord)0xFFFFFFFFFFFFFF00ULL | (UWord)V_BITS8_UNDEFINED);
+      /* else fall into slow case */
+   }
+
    /* ------------ END semi-fast cases ------------ */
 
    ULong  vbits64     = V_BITS64_UNDEFINED; /* result */
@@ -1573,13 +1889,15 @@ void mc_STOREVn_slow ( Addr a, SizeT nBits, ULong vbytes, Bool bigendian )
    PROF_EVENT(MCPE_STOREVN_SLOW);
 
    /* ------------ BEGIN semi-fast cases ------------ */
-   /* These deal quickly-ish with the common auxiliary primary map
+   /* These deal quickly-ish with the common high map
       cases on 64-bit platforms.  Are merely a speedup hack; can be
       omitted without loss of correctness/functionality.  Note that in
-      both cases the "sizeof(void*) == 8" causes these cases to be
+      all cases the "sizeof(void*) == 8" causes these cases to be
       folded out by compilers on 32-bit platforms.  The logic below
       is somewhat similar to some cases extensively commented in
-      MC_(helperc_STOREV8).
+      MC_(helperc_STOREV8), including the "defined on defined" and
+      "undefined on undefined" cases, which matter here as most high
+      memory is covered by distinguished secondaries.
    */
 #  if defined(VGA_mips64) && defined(VGABI_N32)
    if (LIKELY(sizeof(void*) == 4 && nBits == 64 && VG_IS_8_ALIGNED(a)))
@@ -1590,18 +1908,25 @@ void mc_STOREVn_slow ( Addr a, SizeT nBits, ULong vbytes, Bool bigendian )
       SecMap* sm       = get_secmap_for_reading(a);
       UWord   sm_off16 = SM_OFF_16(a);
       UWord   vabits16 = sm->vabits16[sm_off16];
-      if (LIKELY( !is_distinguished_sm(sm) && 
-                          (VA_BITS16_DEFINED   == vabits16 ||
-                           VA_BITS16_UNDEFINED == vabits16) )) {
+      if (LIKELY( VA_BITS16_DEFINED   == vabits16 ||
+                  VA_BITS16_UNDEFINED == vabits16 )) {
          /* Handle common case quickly: a is suitably aligned, */
          /* is mapped, and is addressible. */
          // Convert full V-bits in register to compact 2-bit form.
          if (LIKELY(V_BITS64_DEFINED == vbytes)) {
-            sm->vabits16[sm_off16] = VA_BITS16_DEFINED;
-            return;
+            if (vabits16 == VA_BITS16_DEFINED)
+               return; // defined on defined
+            if (!is_distinguished_sm(sm)) {
+               sm->vabits16[sm_off16] = VA_BITS16_DEFINED;
+               return;
+            }
          } else if (V_BITS64_UNDEFINED == vbytes) {
-            sm->vabits16[sm_off16] = VA_BITS16_UNDEFINED;
-            return;
+            if (vabits16 == VA_BITS16_UNDEFINED)
+               return; // undefined on undefined
+            if (!is_distinguished_sm(sm)) {
+               sm->vabits16[sm_off16] = VA_BITS16_UNDEFINED;
+               return;
+            }
          }
          /* else fall into the slow case */
       }
@@ -1617,23 +1942,92 @@ void mc_STOREVn_slow ( Addr a, SizeT nBits, ULong vbytes, Bool bigendian )
       SecMap* sm      = get_secmap_for_reading(a);
       UWord   sm_off  = SM_OFF(a);
       UWord   vabits8 = sm->vabits8[sm_off];
-      if (LIKELY( !is_distinguished_sm(sm) && 
-                          (VA_BITS8_DEFINED   == vabits8 ||
-                           VA_BITS8_UNDEFINED == vabits8) )) {
+      if (LIKELY( VA_BITS8_DEFINED   == vabits8 ||
+                  VA_BITS8_UNDEFINED == vabits8 )) {
          /* Handle common case quickly: a is suitably aligned, */
          /* is mapped, and is addressible. */
          // Convert full V-bits in register to compact 2-bit form.
          if (LIKELY(V_BITS32_DEFINED == (vbytes & 0xFFFFFFFF))) {
-            sm->vabits8[sm_off] = VA_BITS8_DEFINED;
-            return;
+            if (vabits8 == VA_BITS8_DEFINED)
+               return; // defined on defined
+            if (!is_distinguished_sm(sm)) {
+               sm->vabits8[sm_off] = VA_BITS8_DEFINED;
+               return;
+            }
          } else if (V_BITS32_UNDEFINED == (vbytes & 0xFFFFFFFF)) {
-            sm->vabits8[sm_off] = VA_BITS8_UNDEFINED;
-            return;
+            if (vabits8 == VA_BITS8_UNDEFINED)
+               return; // undefined on undefined
+            if (!is_distinguished_sm(sm)) {
+               sm->vabits8[sm_off] = VA_BITS8_UNDEFINED;
+               return;
+            }
          }
          /* else fall into the slow case */
       }
       /* else fall into the slow case */
    }
+
+#  if defined(VGA_mips64) && defined(VGABI_N32)
+   if (LIKELY(sizeof(void*) == 4 && nBits == 16 && VG_IS_2_ALIGNED(a)))
+#  else
+   if (LIKELY(sizeof(void*) == 8 && nBits == 16 && VG_IS_2_ALIGNED(a)))
+#  endif
+   {
+      SecMap* sm      = get_secmap_for_reading(a);
+      UWord   sm_off  = SM_OFF(a);
+      UWord   vabits8 = sm->vabits8[sm_off];
+      UChar   vabits4 = extract_vabits4_from_vabits8(a, vabits8);
+      if (LIKELY(V_BITS16_DEFINED == (vbytes & 0xFFFF))) {
+         if (LIKELY(vabits4 == VA_BITS4_DEFINED))
+            return; // defined on defined
+         if (!is_distinguished_sm(sm)
+             && accessible_vabits4_in_vabits8(a, vabits8)) {
+            insert_vabits4_into_vabits8( a, VA_BITS4_DEFINED,
+                                         &(sm->vabits8[sm_off]) );
+            return;
+         }
+      } else if (V_BITS16_UNDEFINED == (vbytes & 0xFFFF)) {
+         if (vabits4 == VA_BITS4_UNDEFINED)
+            return; // undefined on undefined
+         if (!is_distinguished_sm(sm)
+             && accessible_vabits4_in_vabits8(a, vabits8)) {
+            insert_vabits4_into_vabits8( a, VA_BITS4_UNDEFINED,
+                                         &(sm->vabits8[sm_off]) );
+            return;
+         }
+      }
+      /* else fall into the slow case */
+   }
+
+#  if defined(VGA_mips64) && defined(VGABI_N32)
+   if (LIKELY(sizeof(void*) == 4 && nBits == 8))
+#  else
+   if (LIKELY(sizeof(void*) == 8 && nBits == 8))
+#  endif
+   {
+      SecMap* sm      = get_secmap_for_reading(a);
+      UWord   sm_off  = SM_OFF(a);
+      UWord   vabits8 = sm->vabits8[sm_off];
+      UChar   vabits2 = extract_vabits2_from_vabits8(a, vabits8);
+      if (LIKELY(V_BITS8_DEFINED == (vbytes & 0xFF))) {
+         if (LIKELY(vabits2 == VA_BITS2_DEFINED))
+            return; // defined on defined
+         if (!is_distinguished_sm(sm) && vabits2 != VA_BITS2_NOACCESS) {
+            insert_vabits2_into_vabits8( a, VA_BITS2_DEFINED,
+                                         &(sm->vabits8[sm_off]) );
+            return;
+         }
+      } else if (V_BITS8_UNDEFINED == (vbytes & 0xFF)) {
+         if (vabits2 == VA_BITS2_UNDEFINED)
+            return; // undefined on undefined
+         if (!is_distinguished_sm(sm) && vabits2 != VA_BITS2_NOACCESS) {
+            insert_vabits2_into_vabits8( a, VA_BITS2_UNDEFINED,
+                                         &(sm->vabits8[sm_off]) );
+            return;
+         }
+      }
+      /* else fall into the slow case */
+   }
    /* ------------ END semi-fast cases ------------ */
 
    tl_assert(nBits == 64 || nBits == 32 || nBits == 16 || nBits == 8);
@@ -1659,12 +2053,55 @@ void mc_STOREVn_slow ( Addr a, SizeT nBits, ULong vbytes, Bool bigendian )
 /*--- Setting permissions over address ranges.             ---*/
 /*------------------------------------------------------------*/
 
+/* Set the V+A bits of the 4-aligned range [a, a+len), which must be
+   within sm and have a length multiple of 4, to vabits8.  Each vabits8
+   byte covers 4 bytes of memory, so this is a plain memset. */
+static INLINE void fill_vabits8 ( SecMap* sm, Addr a, SizeT len,
+                                  UChar vabits8 )
+{
+   tl_assert(VG_IS_4_ALIGNED(a) && VG_IS_4_ALIGNED(len));
+   VG_(memset)( &sm->vabits8[SM_OFF(a)], vabits8, len >> 2 );
+}
+
+/* Is all of sm set to vabits8? */
+static Bool is_uniform_secmap ( const SecMap* sm, UChar vabits8 )
+{
+   const ULong* w  = (const ULong*)sm;
+   ULong        w8 = 0x0101010101010101ULL * vabits8;
+   UWord        i;
+
+   STATIC_ASSERT(sizeof(SecMap) % (4 * sizeof(ULong)) == 0);
+   for (i = 0; i < sizeof(SecMap) / sizeof(ULong); i += 4) {
+      if ((w[i+0] ^ w8) | (w[i+1] ^ w8) | (w[i+2] ^ w8) | (w[i+3] ^ w8))
+         return False;
+   }
+   return True;
+}
+
+/* set_address_range_perms has just set lenS bytes of the private
+   secondary *sm_ptr to the V+A bits of the distinguished secondary
+   dsm.  If that was a large part of it, check if all of it now has
+   these V+A bits, in which case replace it by dsm.  This catches the
+   common case of a large block covering several secondaries being
+   (re)allocated or freed, without waiting for share_secmaps. */
+static void maybe_replace_by_dsm ( SecMap** sm_ptr, SizeT lenS,
+                                   SecMap* dsm )
+{
+   if (lenS < SM_SIZE / 2 || is_distinguished_sm(*sm_ptr))
+      return;
+   if (is_uniform_secmap(*sm_ptr, dsm->vabits8[0])) {
+      PROF_EVENT(MCPE_SET_ADDRESS_RANGE_PERMS_TO_DIST_SM);
+      replace_private_secmap(sm_ptr, dsm);
+   }
+}
+
 static void set_address_range_perms ( Addr a, SizeT lenT, UWord vabits16,
                                       UWord dsm_num )
 {
-   UWord    sm_off, sm_off16;
+   UWord    sm_off;
    UWord    vabits2 = vabits16 & 0x3;
-   SizeT    lenA, lenB, len_to_next_secmap;
+   UChar    vabits8 = vabits16 & 0xff;
+   SizeT    lenA, lenB, lenS, len_to_next_secmap;
    Addr     aNext;
    SecMap*  sm;
    SecMap** sm_ptr;
@@ -1684,6 +2121,9 @@ static void set_address_range_perms ( Addr a, SizeT lenT, UWord vabits16,
    if (lenT == 0)
       return;
 
+   if (vabits16 == VA_BITS16_DEFINED)
+      mark_written(a, lenT);
+
    if (lenT > 256 * 1024 * 1024) {
       if (VG_(clo_verbosity) > 0 && !VG_(clo_xml)) {
          const HChar* s = "unknown???";
@@ -1785,11 +2225,12 @@ static void set_address_range_perms ( Addr a, SizeT lenT, UWord vabits16,
          *sm_ptr = copy_for_writing(*sm_ptr);
       }
    }
-   sm = *sm_ptr;
+   sm   = *sm_ptr;
+   lenS = lenA;
 
    // 1 byte steps
    while (True) {
-      if (VG_IS_8_ALIGNED(a)) break;
+      if (VG_IS_4_ALIGNED(a)) break;
       if (lenA < 1)           break;
       PROF_EVENT(MCPE_SET_ADDRESS_RANGE_PERMS_LOOP1A);
       sm_off = SM_OFF(a);
@@ -1797,14 +2238,12 @@ static void set_address_range_perms ( Addr a, SizeT lenT, UWord vabits16,
       a    += 1;
       lenA -= 1;
    }
-   // 8-aligned, 8 byte steps
-   while (True) {
-      if (lenA < 8) break;
-      PROF_EVENT(MCPE_SET_ADDRESS_RANGE_PERMS_LOOP8A);
-      sm_off16 = SM_OFF_16(a);
-      sm->vabits16[sm_off16] = vabits16;
-      a    += 8;
-      lenA -= 8;
+   // 4-aligned, all the 4 byte groups at once
+   if (lenA >= 4) {
+      PROF_EVENT(MCPE_SET_ADDRESS_RANGE_PERMS_FILL_A);
+      fill_vabits8( sm, a, lenA & ~(SizeT)3, vabits8 );
+      a    += lenA & ~(SizeT)3;
+      lenA &= 3;
    }
    // 1 byte steps
    while (True) {
@@ -1815,6 +2254,7 @@ static void set_address_range_perms ( Addr a, SizeT lenT, UWord vabits16,
       a    += 1;
       lenA -= 1;
    }
+   maybe_replace_by_dsm( sm_ptr, lenS, example_dsm );
 
    // We've finished the first sec-map.  Is that it?
    if (lenB == 0)
@@ -1868,26 +2308,26 @@ static void set_address_range_perms ( Addr a, SizeT lenT, UWord vabits16,
          *sm_ptr = copy_for_writing(*sm_ptr);
       }
    }
-   sm = *sm_ptr;
+   sm   = *sm_ptr;
+   lenS = lenB;
 
-   // 8-aligned, 8 byte steps
-   while (True) {
-      if (lenB < 8) break;
-      PROF_EVENT(MCPE_SET_ADDRESS_RANGE_PERMS_LOOP8B);
-      sm_off16 = SM_OFF_16(a);
-      sm->vabits16[sm_off16] = vabits16;
-      a    += 8;
-      lenB -= 8;
+   // 4-aligned, all the 4 byte groups at once
+   if (lenB >= 4) {
+      PROF_EVENT(MCPE_SET_ADDRESS_RANGE_PERMS_FILL_B);
+      fill_vabits8( sm, a, lenB & ~(SizeT)3, vabits8 );
+      a    += lenB & ~(SizeT)3;
+      lenB &= 3;
    }
    // 1 byte steps
    while (True) {
-      if (lenB < 1) return;
+      if (lenB < 1) break;
       PROF_EVENT(MCPE_SET_ADDRESS_RANGE_PERMS_LOOP1C);
       sm_off = SM_OFF(a);
       insert_vabits2_into_vabits8( a, vabits2, &(sm->vabits8[sm_off]) );
       a    += 1;
       lenB -= 1;
    }
+   maybe_replace_by_dsm( sm_ptr, lenS, example_dsm );
 }
 
 
@@ -1906,6 +2346,11 @@ static void make_mem_undefined ( Addr a, SizeT len )
 {
    PROF_EVENT(MCPE_MAKE_MEM_UNDEFINED);
    DEBUG("make_mem_undefined(%p, %lu)\n", a, len);
+   if (UNLIKELY(MC_(clo_sample_rate) > 1)) {
+      /* See "Sampling" above. */
+      MC_(make_mem_defined) ( a, len );
+      return;
+   }
    set_address_range_perms ( a, len, VA_BITS16_UNDEFINED, SM_DIST_UNDEFINED );
 }
 
@@ -1913,6 +2358,11 @@ void MC_(make_mem_undefined_w_otag) ( Addr a, SizeT len, UInt otag )
 {
    PROF_EVENT(MCPE_MAKE_MEM_UNDEFINED_W_OTAG);
    DEBUG("MC_(make_mem_undefined)(%p, %lu)\n", a, len);
+   if (UNLIKELY(MC_(clo_sample_rate) > 1)) {
+      /* See "Sampling" above. */
+      MC_(make_mem_defined) ( a, len );
+      return;
+   }
    set_address_range_perms ( a, len, VA_BITS16_UNDEFINED, SM_DIST_UNDEFINED );
    if (UNLIKELY( MC_(clo_mc_level) == 3 ))
       ocache_sarp_Set_Origins ( a, len, otag );
@@ -1964,37 +2414,133 @@ static void make_mem_defined_w_tid ( Addr a, SizeT len, ThreadId tid )
 /* For each byte in [a,a+len), if the byte is addressable, make it be
    defined, but if it isn't addressible, leave it alone.  In other
    words a version of MC_(make_mem_defined) that doesn't mess with
-   addressibility.  Low-performance implementation. */
+   addressibility.  The 4-aligned parts are done a vabits8 byte at a
+   time, within one secondary at a time. */
 static void make_mem_defined_if_addressable ( Addr a, SizeT len )
 {
-   SizeT i;
+   SizeT i, j, n;
    UChar vabits2;
    DEBUG("make_mem_defined_if_addressable(%p, %llu)\n", a, (ULong)len);
-   for (i = 0; i < len; i++) {
-      vabits2 = get_vabits2( a+i );
-      if (LIKELY(VA_BITS2_NOACCESS != vabits2)) {
-         set_vabits2(a+i, VA_BITS2_DEFINED);
-         if (UNLIKELY(MC_(clo_mc_level) >= 3)) {
-            MC_(helperc_b_store1)( a+i, 0 ); /* clear the origin tag */
-         } 
+   PROF_EVENT(MCPE_MAKE_MEM_DEFINED_IF_ADDRESSABLE);
+   mark_written(a, len);
+   i = 0;
+   while (i < len) {
+      SecMap** sm_ptr;
+      SecMap*  sm;
+      UChar*   vabits8;
+
+      if (!VG_IS_4_ALIGNED(a+i) || len - i < 4) {
+         vabits2 = get_vabits2( a+i );
+         if (LIKELY(VA_BITS2_NOACCESS != vabits2)) {
+            set_vabits2(a+i, VA_BITS2_DEFINED);
+            if (UNLIKELY(MC_(clo_mc_level) >= 3)) {
+               MC_(helperc_b_store1)( a+i, 0 ); /* clear the origin tag */
+            }
+         }
+         i++;
+         continue;
       }
+
+      n = (len - i) & ~(SizeT)3;
+      if (n > SM_SIZE - (SM_OFF(a+i) << 2))
+         n = SM_SIZE - (SM_OFF(a+i) << 2);
+      PROF_EVENT(MCPE_MAKE_MEM_DEFINED_IF_ADDRESSABLE_CHUNK);
+      sm_ptr = get_secmap_ptr(a+i);
+      sm     = *sm_ptr;
+      if (sm == &sm_distinguished[SM_DIST_NOACCESS]
+          || sm == &sm_distinguished[SM_DIST_DEFINED]) {
+         /* nothing to do */
+      } else if (sm == &sm_distinguished[SM_DIST_UNDEFINED] && n == SM_SIZE) {
+         update_SM_counts(sm, &sm_distinguished[SM_DIST_DEFINED]);
+         *sm_ptr = &sm_distinguished[SM_DIST_DEFINED];
+      } else {
+         if (is_distinguished_sm(sm))
+            *sm_ptr = sm = copy_for_writing(sm);
+         /* Each non-zero (that is, not noaccess) pair of bits becomes
+            10b (defined). */
+         vabits8 = &sm->vabits8[SM_OFF(a+i)];
+         for (j = 0; j < (n >> 2); j++)
+            vabits8[j] = ((vabits8[j] | (vabits8[j] >> 1)) & 0x55) << 1;
+         maybe_replace_by_dsm(sm_ptr, n, &sm_distinguished[SM_DIST_DEFINED]);
+      }
+      if (UNLIKELY(MC_(clo_mc_level) == 3))
+         ocache_sarp_Clear_Origins ( a+i, n );
+      i += n;
    }
 }
 
-/* Similarly (needed for mprotect handling ..) */
+/* Similarly (needed for mprotect handling ..).  This is called for the
+   whole of each newly made accessible thread stack, so, as above, it
+   works a secondary at a time: a noaccess DSM is swapped for the
+   defined one, and a secondary holding no noaccess bytes is left
+   alone rather than being copied.  The stack's secondaries are then
+   only made private as the stack pointer moves down into them. */
 static void make_mem_defined_if_noaccess ( Addr a, SizeT len )
 {
-   SizeT i;
-   UChar vabits2;
+   SizeT i, j, k, n;
+   UChar vabits2, noaccess8, any_noaccess;
    DEBUG("make_mem_defined_if_noaccess(%p, %llu)\n", a, (ULong)len);
-   for (i = 0; i < len; i++) {
-      vabits2 = get_vabits2( a+i );
-      if (LIKELY(VA_BITS2_NOACCESS == vabits2)) {
-         set_vabits2(a+i, VA_BITS2_DEFINED);
-         if (UNLIKELY(MC_(clo_mc_level) >= 3)) {
-            MC_(helperc_b_store1)( a+i, 0 ); /* clear the origin tag */
-         } 
+   PROF_EVENT(MCPE_MAKE_MEM_DEFINED_IF_NOACCESS);
+   mark_written(a, len);
+   i = 0;
+   while (i < len) {
+      SecMap** sm_ptr;
+      SecMap*  sm;
+      UChar*   vabits8;
+
+      if (!VG_IS_4_ALIGNED(a+i) || len - i < 4) {
+         vabits2 = get_vabits2( a+i );
+         if (LIKELY(VA_BITS2_NOACCESS == vabits2)) {
+            set_vabits2(a+i, VA_BITS2_DEFINED);
+            if (UNLIKELY(MC_(clo_mc_level) >= 3)) {
+               MC_(helperc_b_store1)( a+i, 0 ); /* clear the origin tag */
+            }
+         }
+         i++;
+         continue;
       }
+
+      n = (len - i) & ~(SizeT)3;
+      if (n > SM_SIZE - (SM_OFF(a+i) << 2))
+         n = SM_SIZE - (SM_OFF(a+i) << 2);
+      PROF_EVENT(MCPE_MAKE_MEM_DEFINED_IF_NOACCESS_CHUNK);
+      sm_ptr = get_secmap_ptr(a+i);
+      sm     = *sm_ptr;
+      if (sm == &sm_distinguished[SM_DIST_UNDEFINED]
+          || sm == &sm_distinguished[SM_DIST_DEFINED]) {
+         /* nothing to do */
+      } else if (sm == &sm_distinguished[SM_DIST_NOACCESS] && n == SM_SIZE) {
+         update_SM_counts(sm, &sm_distinguished[SM_DIST_DEFINED]);
+         *sm_ptr = &sm_distinguished[SM_DIST_DEFINED];
+         if (UNLIKELY(MC_(clo_mc_level) == 3))
+            ocache_sarp_Clear_Origins ( a+i, n );
+      } else {
+         /* A pair of bits is noaccess iff both bits are zero. */
+         vabits8 = &sm->vabits8[SM_OFF(a+i)];
+         any_noaccess = 0;
+         for (j = 0; j < (n >> 2); j++)
+            any_noaccess |= ~(vabits8[j] | (vabits8[j] >> 1)) & 0x55;
+         if (any_noaccess) {
+            if (is_distinguished_sm(sm)) {
+               *sm_ptr = sm = copy_for_writing(sm);
+               vabits8 = &sm->vabits8[SM_OFF(a+i)];
+            }
+            for (j = 0; j < (n >> 2); j++) {
+               noaccess8 = ~(vabits8[j] | (vabits8[j] >> 1)) & 0x55;
+               if (LIKELY(noaccess8 == 0))
+                  continue;
+               vabits8[j] |= noaccess8 << 1;
+               if (UNLIKELY(MC_(clo_mc_level) >= 3)) {
+                  for (k = 0; k < 4; k++)
+                     if (noaccess8 & (1 << (2*k)))
+                        MC_(helperc_b_store1)( a+i + 4*j + k, 0 );
+               }
+            }
+            maybe_replace_by_dsm(sm_ptr, n,
+                                 &sm_distinguished[SM_DIST_DEFINED]);
+         }
+      }
+      i += n;
    }
 }
 
@@ -2003,7 +2549,7 @@ static void make_mem_defined_if_noaccess ( Addr a, SizeT len )
 
 void MC_(copy_address_range_state) ( Addr src, Addr dst, SizeT len )
 {
-   SizeT i, j;
+   SizeT i, j, k;
    UChar vabits2, vabits8;
    Bool  aligned, nooverlap;
 
@@ -2013,34 +2559,66 @@ void MC_(copy_address_range_state) ( Addr src, Addr dst, SizeT len )
    if (len == 0 || src == dst)
       return;
 
+   mark_written(dst, len);
+
    aligned   = VG_IS_4_ALIGNED(src) && VG_IS_4_ALIGNED(dst);
    nooverlap = src+len <= dst || dst+len <= src;
 
    if (nooverlap && aligned) {
 
-      /* Vectorised fast case, when no overlap and suitably aligned */
-      /* vector loop */
+      /* Fast case, when no overlap and suitably aligned: copy the
+         vabits8 of each piece of the range which is within one
+         secondary at both src and dst with a memcpy.  Whole
+         secondaries which are distinguished at src are shared rather
+         than copied. */
       i = 0;
       while (len >= 4) {
-         vabits8 = get_vabits8_for_aligned_word32( src+i );
-         set_vabits8_for_aligned_word32( dst+i, vabits8 );
-         if (LIKELY(VA_BITS8_DEFINED == vabits8 
-                            || VA_BITS8_UNDEFINED == vabits8 
-                            || VA_BITS8_NOACCESS == vabits8)) {
-            /* do nothing */
-         } else {
-            /* have to copy secondary map info */
-            if (VA_BITS2_PARTDEFINED == get_vabits2( src+i+0 ))
-               set_sec_vbits8( dst+i+0, get_sec_vbits8( src+i+0 ) );
-            if (VA_BITS2_PARTDEFINED == get_vabits2( src+i+1 ))
-               set_sec_vbits8( dst+i+1, get_sec_vbits8( src+i+1 ) );
-            if (VA_BITS2_PARTDEFINED == get_vabits2( src+i+2 ))
-               set_sec_vbits8( dst+i+2, get_sec_vbits8( src+i+2 ) );
-            if (VA_BITS2_PARTDEFINED == get_vabits2( src+i+3 ))
-               set_sec_vbits8( dst+i+3, get_sec_vbits8( src+i+3 ) );
+         SizeT    n  = len & ~(SizeT)3;
+         SecMap*  src_sm;
+         SecMap** dst_sm_ptr;
+         UChar*   src8;
+         UChar*   dst8;
+         if (n > SM_SIZE - (SM_OFF(src+i) << 2))
+            n = SM_SIZE - (SM_OFF(src+i) << 2);
+         if (n > SM_SIZE - (SM_OFF(dst+i) << 2))
+            n = SM_SIZE - (SM_OFF(dst+i) << 2);
+         PROF_EVENT(MCPE_COPY_ADDRESS_RANGE_STATE_CHUNK);
+         src_sm     = get_secmap_for_reading( src+i );
+         dst_sm_ptr = get_secmap_ptr( dst+i );
+         src8       = &src_sm->vabits8[SM_OFF(src+i)];
+         if (n == SM_SIZE && is_distinguished_sm(src_sm)) {
+            PROF_EVENT(MCPE_COPY_ADDRESS_RANGE_STATE_SHARE_SM);
+            if (is_distinguished_sm(*dst_sm_ptr)) {
+               update_SM_counts(*dst_sm_ptr, src_sm);
+               *dst_sm_ptr = src_sm;
+            } else {
+               replace_private_secmap(dst_sm_ptr, src_sm);
+            }
+         } else if (src_sm != *dst_sm_ptr || !is_distinguished_sm(src_sm)) {
+            if (is_distinguished_sm(*dst_sm_ptr))
+               *dst_sm_ptr = copy_for_writing(*dst_sm_ptr);
+            dst8 = &(*dst_sm_ptr)->vabits8[SM_OFF(dst+i)];
+            VG_(memcpy)( dst8, src8, n >> 2 );
          }
-         i += 4;
-         len -= 4;
+         /* Partially defined bytes also need their V bits copied,
+            including when the secondary itself was shared above, as
+            the V bits are kept per address.  Only the shared
+            secondaries among the distinguished ones can have some. */
+         if (!is_distinguished_sm(src_sm) || is_shared_sm(src_sm)) {
+            for (j = 0; j < (n >> 2); j++) {
+               vabits8 = src8[j];
+               if (LIKELY(0 == (vabits8 & (vabits8 >> 1) & 0x55)))
+                  continue;
+               for (k = 0; k < 4; k++) {
+                  Addr src_a = src+i + 4*j + k;
+                  if (VA_BITS2_PARTDEFINED == get_vabits2( src_a ))
+                     set_sec_vbits8( dst+i + 4*j + k,
+                                     get_sec_vbits8( src_a ) );
+               }
+            }
+         }
+         i   += n;
+         len -= n;
       }
       /* fixup loop */
       while (len >= 1) {
@@ -2082,6 +2660,85 @@ void MC_(copy_address_range_state) ( Addr src, Addr dst, SizeT len )
 }
 
 
+/* mremap has moved [src, src+len) to [dst, dst+len), which do not
+   overlap: the V+A bits of dst become those of src, and src becomes
+   noaccess.  When src and dst are at the same offset in their
+   secondaries, the secondaries covered entirely by the range are
+   moved rather than copied. */
+static void mc_move_mem_remap ( Addr src, Addr dst, SizeT len )
+{
+   SizeT i, j, k, n;
+
+   DEBUG("mc_move_mem_remap\n");
+   PROF_EVENT(MCPE_MOVE_MEM_REMAP);
+   tl_assert(src+len <= dst || dst+len <= src);
+
+   if (((src ^ dst) & (SM_SIZE-1)) != 0) {
+      MC_(copy_address_range_state)( src, dst, len );
+      MC_(make_mem_noaccess)( src, len );
+      return;
+   }
+
+   mark_written(dst, len);
+   i = 0;
+   while (i < len) {
+      SecMap** src_sm_ptr;
+      SecMap** dst_sm_ptr;
+      SecMap*  sm;
+
+      n = SM_SIZE - ((src+i) & (SM_SIZE-1));
+      if (n > len - i)
+         n = len - i;
+      if (n < SM_SIZE) {
+         MC_(copy_address_range_state)( src+i, dst+i, n );
+         MC_(make_mem_noaccess)( src+i, n );
+         i += n;
+         continue;
+      }
+
+      PROF_EVENT(MCPE_MOVE_MEM_REMAP_SM);
+      src_sm_ptr = get_secmap_ptr( src+i );
+      dst_sm_ptr = get_secmap_ptr( dst+i );
+      sm         = *src_sm_ptr;
+
+      /* The V bits of partially defined bytes are found by address,
+         so they have to be copied.  There are none if the sec V bits
+         table is empty. */
+      if ((!is_distinguished_sm(sm) || is_shared_sm(sm))
+          && VG_(OSetGen_Size)(secVBitTable) > 0) {
+         const ULong* w = (const ULong*)sm->vabits8;
+         for (j = 0; j < SM_CHUNKS / 8; j++) {
+            if (LIKELY(0 == (w[j] & (w[j] >> 1) & 0x5555555555555555ULL)))
+               continue;
+            for (k = 0; k < 32; k++) {
+               Addr src_a = src+i + 32*j + k;
+               if (VA_BITS2_PARTDEFINED == get_vabits2( src_a ))
+                  set_sec_vbits8( dst+i + 32*j + k, get_sec_vbits8( src_a ) );
+            }
+         }
+      }
+
+      /* dst now refers to sm instead of its old secondary, and src to
+         a noaccess one instead of sm: only the old dst goes away. */
+      if (is_distinguished_sm(*dst_sm_ptr))
+         update_SM_counts(*dst_sm_ptr, &sm_distinguished[SM_DIST_NOACCESS]);
+      else
+         replace_private_secmap(dst_sm_ptr,
+                                &sm_distinguished[SM_DIST_NOACCESS]);
+      *dst_sm_ptr = sm;
+      *src_sm_ptr = &sm_distinguished[SM_DIST_NOACCESS];
+      i += n;
+   }
+}
+
+/* madvise(MADV_DONTNEED) has dropped the pages of [a, a+len): they now
+   read as zeroes, or as the contents of the file. */
+static void mc_discard_mem_madvise ( Addr a, SizeT len )
+{
+   make_mem_defined_if_addressable( a, len );
+}
+
+
 /*------------------------------------------------------------*/
 /*--- Origin tracking stuff - cache basics                 ---*/
 /*------------------------------------------------------------*/
@@ -2158,8 +2815,9 @@ void MC_(copy_address_range_state) ( Addr src, Addr dst, SizeT len )
 
    Memory is shadowed using a two level cache structure (ocacheL1 and
    ocacheL2).  Memory references are first directed to ocacheL1.  This
-   is a traditional 2-way set associative cache with 32-byte lines and
-   approximate LRU replacement within each set.
+   is a traditional set associative cache (2-way and 1M sets by default,
+   see --origin-cache-ways= and --origin-cache-sets=) with 32-byte lines
+   and approximate LRU replacement within each set.
 
    A naive implementation would require storing one 32 bit otag for
    each byte of memory covered, a 4:1 space overhead.  Instead, there
@@ -2177,7 +2835,7 @@ void MC_(copy_address_range_state) ( Addr src, Addr dst, SizeT len )
    zeroes to be installed.  However, ejecting a line containing
    nonzeroes risks losing origin information permanently.  In order to
    prevent such lossage, ejected nonzero lines are placed in a
-   secondary cache (ocacheL2), which is an OSet (AVL tree) of cache
+   secondary cache (ocacheL2), which is a hash table of cache
    lines.  This can grow arbitrarily large, and so should ensure that
    Memcheck runs out of memory in preference to losing useful origin
    info due to cache size limitations.
@@ -2420,15 +3078,16 @@ static INLINE Bool is_valid_oc_tag ( Addr tag ) {
    return 0 == (tag & ((1 << OC_BITS_PER_LINE) - 1));
 }
 
-#define OC_LINES_PER_SET 2
-
-#define OC_N_SET_BITS    20
-#define OC_N_SETS        (1 << OC_N_SET_BITS)
-
-/* These settings give:
+/* The number of sets (a power of 2) and of lines per set are given by
+   --origin-cache-sets= and --origin-cache-ways=.  The defaults give:
    64 bit host: ocache:  100,663,296 sizeB    67,108,864 useful
    32 bit host: ocache:   92,274,688 sizeB    67,108,864 useful
 */
+#define OC_DEFAULT_SETS  (1 << 20)
+#define OC_MIN_SETS      (1 << 10)
+#define OC_MAX_SETS      (1 << 24)
+#define OC_DEFAULT_WAYS  2
+#define OC_MAX_WAYS      8
 
 #define OC_MOVE_FORWARDS_EVERY_BITS 7
 
@@ -2441,7 +3100,6 @@ static INLINE Bool is_valid_oc_tag ( Addr tag ) {
    size is 32 bytes).  Changing that would require a bunch of re-tuning
    effort.  So let's set it in stone for now. */
 STATIC_ASSERT(OC_BITS_PER_LINE == 5);
-STATIC_ASSERT(OC_LINES_PER_SET == 2);
 
 /* Fundamentally we want an OCacheLine structure (see below) as follows:
       struct {
@@ -2518,49 +3176,58 @@ static inline UChar classify_OCacheLine ( OCacheLine* line )
    return 'z'; /* ZERO - no useful info */
 }
 
-typedef
-   struct {
-      OCacheLine line[OC_LINES_PER_SET];
-   }
-   OCacheSet;
+/* The L1 cache: ocacheL1_set_mask+1 sets of ocacheL1_ways lines,
+   each set being ocacheL1_ways consecutive lines in ocacheL1[]. */
+static OCacheLine* ocacheL1 = NULL;
+static UWord       ocacheL1_set_mask = 0;
+static UWord       ocacheL1_ways = 0;
+static UWord       ocacheL1_event_ctr = 0;
 
-typedef
-   struct {
-      OCacheSet set[OC_N_SETS];
-   }
-   OCache;
+static INLINE OCacheLine* ocacheL1_set ( UWord setno ) {
+   return &ocacheL1[setno * ocacheL1_ways];
+}
 
-static OCache* ocacheL1 = NULL;
-static UWord   ocacheL1_event_ctr = 0;
+static SizeT ocacheL1_szB ( void ) {
+   return (SizeT)MC_(clo_origin_cache_sets) * MC_(clo_origin_cache_ways)
+          * sizeof(OCacheLine);
+}
 
 static void init_ocacheL2 ( void ); /* fwds */
+static void init_ocache_regions ( void ); /* fwds */
 static void init_OCache ( void )
 {
-   UWord line, set;
+   UWord i;
    tl_assert(MC_(clo_mc_level) >= 3);
    tl_assert(ocacheL1 == NULL);
-   ocacheL1 = VG_(am_shadow_alloc)(sizeof(OCache));
+   tl_assert(MC_(clo_origin_cache_sets) >= OC_MIN_SETS
+             && MC_(clo_origin_cache_sets) <= OC_MAX_SETS
+             && 0 == (MC_(clo_origin_cache_sets)
+                      & (MC_(clo_origin_cache_sets) - 1)));
+   tl_assert(MC_(clo_origin_cache_ways) >= 1
+             && MC_(clo_origin_cache_ways) <= OC_MAX_WAYS);
+   ocacheL1 = VG_(am_shadow_alloc)(ocacheL1_szB());
    if (ocacheL1 == NULL) {
       VG_(out_of_memory_NORETURN)( "memcheck:allocating ocacheL1", 
-                                   sizeof(OCache) );
+                                   ocacheL1_szB() );
    }
    tl_assert(ocacheL1 != NULL);
-   for (set = 0; set < OC_N_SETS; set++) {
-      for (line = 0; line < OC_LINES_PER_SET; line++) {
-         ocacheL1->set[set].line[line].tag = 1/*invalid*/;
-      }
+   ocacheL1_set_mask = MC_(clo_origin_cache_sets) - 1;
+   ocacheL1_ways     = MC_(clo_origin_cache_ways);
+   for (i = 0; i < (ocacheL1_set_mask + 1) * ocacheL1_ways; i++) {
+      ocacheL1[i].tag = 1/*invalid*/;
    }
    init_ocacheL2();
+   init_ocache_regions();
 }
 
-static inline void moveLineForwards ( OCacheSet* set, UWord lineno )
+static inline void moveLineForwards ( OCacheLine* set, UWord lineno )
 {
    OCacheLine tmp;
    stats_ocacheL1_movefwds++;
-   tl_assert(lineno > 0 && lineno < OC_LINES_PER_SET);
-   tmp = set->line[lineno-1];
-   set->line[lineno-1] = set->line[lineno];
-   set->line[lineno] = tmp;
+   tl_assert(lineno > 0 && lineno < ocacheL1_ways);
+   tmp = set[lineno-1];
+   set[lineno-1] = set[lineno];
+   set[lineno] = tmp;
 }
 
 static inline void zeroise_OCacheLine ( OCacheLine* line, Addr tag ) {
@@ -2587,100 +3254,119 @@ static inline void zeroise_OCacheLine ( OCacheLine* line, Addr tag ) {
 //////////////////////////////////////////////////////////////
 //// OCache backing store
 
-// The backing store for ocacheL1 is, conceptually, an AVL tree of lines that
-// got ejected from the L1 (a "victim cache"), and which actually contain
-// useful info -- that is, for which classify_OCacheLine would return 'n' and
-// no other value.  However, the tree can grow large, and searching/updating
-// it can be hot paths.  Hence we "take out" 12 significant bits of the key by
-// having 4096 trees, and select one using HASH_OCACHE_TAG.
-//
-// What that hash function returns isn't important so long as it is a pure
-// function of the tag values, and is < 4096.  However, it is critical for
-// performance of long SARPs.  Hence the extra shift of 11 bits.  This means
-// each tree conceptually is assigned to contiguous sequences of 2048 lines in
-// the "line address space", giving some locality of reference when scanning
-// linearly through address space, as is done by a SARP.  Changing that 11 to
-// 0 gives terrible performance on long SARPs, presumably because each new
-// line is in a different tree, hence we wind up thrashing the (CPU's) caches.
-//
-// On 32-bit targets, we have to be a bit careful not to shift out so many
-// bits that not all 2^12 trees get used.  That leads to the constraint
-// (OC_BITS_PER_LINE + 11 + 12) < 32.  Note that the 11 is the only thing we
-// can change here.  In this case we have OC_BITS_PER_LINE == 5, hence the
-// inequality is (28 < 32) and so we're good.
-//
-// The value 11 was determined empirically from various Firefox runs.  10 or
-// 12 also work pretty well.
+// The backing store for ocacheL1 is a hash table of lines that got ejected
+// from the L1 (a "victim cache"), and which actually contain useful info --
+// that is, for which classify_OCacheLine would return 'n' and no other
+// value.  It can grow large, and searching/updating it can be hot paths,
+// especially when the L1 is too small for the working set: then nearly
+// every L1 miss does a (usually failing) lookup and a delete.  Hence the
+// table is a simple chained hash table indexed by the low bits of the
+// line number, whose number of chains is doubled whenever it holds more
+// lines than chains, so that the cost of a lookup stays constant.
 
-static OSet* ocachesL2[4096];
+typedef
+   struct _OCacheL2Node {
+      struct _OCacheL2Node* next;
+      OCacheLine            line;
+   }
+   OCacheL2Node;
 
-STATIC_ASSERT((OC_BITS_PER_LINE + 11 + 12) < 32);
-static inline UInt HASH_OCACHE_TAG ( Addr tag ) {
-   return (UInt)((tag >> (OC_BITS_PER_LINE + 11)) & 0xFFF);
-}
+#define OC_L2_MIN_CHAINS 4096
 
-static void* ocacheL2_malloc ( const HChar* cc, SizeT szB ) {
-   return VG_(malloc)(cc, szB);
-}
-static void ocacheL2_free ( void* v ) {
-   VG_(free)( v );
-}
+static OCacheL2Node** ocacheL2 = NULL;
+static UWord          ocacheL2_chain_mask = 0;
 
-/* Stats: # nodes currently in tree */
+/* Stats: # nodes currently in table */
 static UWord stats__ocacheL2_n_nodes = 0;
 
+static INLINE UWord ocacheL2_chain ( Addr tag )
+{
+   UWord lineno = tag >> OC_BITS_PER_LINE;
+   return (lineno ^ (lineno >> 21)) & ocacheL2_chain_mask;
+}
+
+static OCacheL2Node** ocacheL2_alloc_chains ( UWord n_chains )
+{
+   return VG_(calloc)( "mc.ioL2.1", n_chains, sizeof(OCacheL2Node*) );
+}
+
 static void init_ocacheL2 ( void )
 {
-   tl_assert(sizeof(Word) == sizeof(Addr)); /* since OCacheLine.tag :: Addr */
+   tl_assert(sizeof(UWord) == sizeof(Addr)); /* since OCacheLine.tag :: Addr */
    tl_assert(0 == offsetof(OCacheLine,tag));
-   for (UInt i = 0; i < 4096; i++) {
-      tl_assert(!ocachesL2[i]);
-      ocachesL2[i]
-         = VG_(OSetGen_Create)( offsetof(OCacheLine,tag),
-                                NULL, /* fast cmp */
-                                ocacheL2_malloc, "mc.ioL2", ocacheL2_free);
-   }
+   tl_assert(!ocacheL2);
+   ocacheL2 = ocacheL2_alloc_chains( OC_L2_MIN_CHAINS );
+   ocacheL2_chain_mask = OC_L2_MIN_CHAINS - 1;
    stats__ocacheL2_n_nodes = 0;
 }
 
-/* Find line with the given tag in the tree, or NULL if not found. */
+/* Double the number of chains of the table. */
+__attribute__((noinline))
+static void ocacheL2_grow ( void )
+{
+   UWord          i, old_n_chains = ocacheL2_chain_mask + 1;
+   OCacheL2Node** old_chains      = ocacheL2;
+   OCacheL2Node  *node, *next;
+   ocacheL2 = ocacheL2_alloc_chains( 2 * old_n_chains );
+   ocacheL2_chain_mask = 2 * old_n_chains - 1;
+   for (i = 0; i < old_n_chains; i++) {
+      for (node = old_chains[i]; node; node = next) {
+         UWord chain = ocacheL2_chain( node->line.tag );
+         next = node->next;
+         node->next = ocacheL2[chain];
+         ocacheL2[chain] = node;
+      }
+   }
+   VG_(free)( old_chains );
+}
+
+/* Find line with the given tag in the table, or NULL if not found. */
 static inline OCacheLine* ocacheL2_find_tag ( Addr tag )
 {
-   OCacheLine* line;
+   OCacheL2Node* node;
    tl_assert(is_valid_oc_tag(tag));
    stats__ocacheL2_finds++;
-   OSet* oset = ocachesL2[HASH_OCACHE_TAG(tag)];
-   line = VG_(OSetGen_Lookup)( oset, &tag );
-   return line;
+   for (node = ocacheL2[ocacheL2_chain(tag)]; node; node = node->next) {
+      if (node->line.tag == tag)
+         return &node->line;
+   }
+   return NULL;
 }
 
-/* Delete the line with the given tag from the tree, if it is present, and
-   free up the associated memory. */
+/* Delete the line with the given tag from the table, if it is present,
+   and free up the associated memory. */
 static void ocacheL2_del_tag ( Addr tag )
 {
-   OCacheLine* line;
+   OCacheL2Node *node, **prev;
    tl_assert(is_valid_oc_tag(tag));
    stats__ocacheL2_dels++;
-   OSet* oset = ocachesL2[HASH_OCACHE_TAG(tag)];
-   line = VG_(OSetGen_Remove)( oset, &tag );
-   if (line) {
-      VG_(OSetGen_FreeNode)(oset, line);
-      tl_assert(stats__ocacheL2_n_nodes > 0);
-      stats__ocacheL2_n_nodes--;
+   prev = &ocacheL2[ocacheL2_chain(tag)];
+   for (node = *prev; node; prev = &node->next, node = node->next) {
+      if (node->line.tag == tag) {
+         *prev = node->next;
+         VG_(free)(node);
+         tl_assert(stats__ocacheL2_n_nodes > 0);
+         stats__ocacheL2_n_nodes--;
+         return;
+      }
    }
 }
 
-/* Add a copy of the given line to the tree.  It must not already be
+/* Add a copy of the given line to the table.  It must not already be
    present. */
 static void ocacheL2_add_line ( OCacheLine* line )
 {
-   OCacheLine* copy;
+   OCacheL2Node* node;
+   UWord         chain;
    tl_assert(is_valid_oc_tag(line->tag));
-   OSet* oset = ocachesL2[HASH_OCACHE_TAG(line->tag)];
-   copy = VG_(OSetGen_AllocNode)( oset, sizeof(OCacheLine) );
-   *copy = *line;
+   if (UNLIKELY(stats__ocacheL2_n_nodes > ocacheL2_chain_mask))
+      ocacheL2_grow();
+   node = VG_(malloc)( "mc.oL2al.1", sizeof(OCacheL2Node) );
+   node->line = *line;
+   chain = ocacheL2_chain( line->tag );
+   node->next = ocacheL2[chain];
+   ocacheL2[chain] = node;
    stats__ocacheL2_adds++;
-   VG_(OSetGen_Insert)( oset, copy );
    stats__ocacheL2_n_nodes++;
    if (stats__ocacheL2_n_nodes > stats__ocacheL2_n_nodes_max)
       stats__ocacheL2_n_nodes_max = stats__ocacheL2_n_nodes;
@@ -2689,20 +3375,69 @@ static void ocacheL2_add_line ( OCacheLine* line )
 ////
 //////////////////////////////////////////////////////////////
 
+//////////////////////////////////////////////////////////////
+//// OCache region directory
+
+// A directory of the 64KB regions of the address space that may have
+// lines in either level of the cache.  It lets ocache_clear_lines skip
+// the parts of a large range that origins have never been looked up
+// in, which for a thread stack is nearly all of it.  Each slot holds
+// the number of the only region using it that may have lines,
+// OC_REGION_NONE if no region does, or OC_REGION_MANY if more than
+// one might.  A region is noted each time one of its lines is loaded
+// into the L1; lines that are still in the L1 were all loaded since
+// their region was last cleared, since clearing invalidates them.
+
+#define OC_REGION_BITS    16
+#define OC_N_REGION_SLOTS (1 << 14)
+#define OC_REGION_NONE    ((UWord)-1)
+#define OC_REGION_MANY    ((UWord)-2)
+
+static UWord* ocache_regions = NULL;
+
+static void init_ocache_regions ( void )
+{
+   UWord i;
+   tl_assert(!ocache_regions);
+   ocache_regions = VG_(malloc)( "mc.ioR.1",
+                                 OC_N_REGION_SLOTS * sizeof(UWord) );
+   for (i = 0; i < OC_N_REGION_SLOTS; i++)
+      ocache_regions[i] = OC_REGION_NONE;
+}
+
+static INLINE UWord* ocache_region_slot ( UWord region )
+{
+   return &ocache_regions[(region ^ (region >> 14))
+                          & (OC_N_REGION_SLOTS - 1)];
+}
+
+static INLINE void ocache_note_region ( Addr tag )
+{
+   UWord  region = tag >> OC_REGION_BITS;
+   UWord* slot   = ocache_region_slot( region );
+   if (LIKELY(*slot == region))
+      return;
+   *slot = *slot == OC_REGION_NONE ? region : OC_REGION_MANY;
+}
+
+////
+//////////////////////////////////////////////////////////////
+
 __attribute__((noinline))
 static OCacheLine* find_OCacheLine_SLOW ( Addr a )
 {
-   OCacheLine *victim, *inL2;
+   OCacheLine *set, *victim, *inL2;
    UChar c;
    UWord line;
-   UWord setno   = (a >> OC_BITS_PER_LINE) & (OC_N_SETS - 1);
+   UWord setno   = (a >> OC_BITS_PER_LINE) & ocacheL1_set_mask;
    UWord tagmask = ~((1 << OC_BITS_PER_LINE) - 1);
    UWord tag     = a & tagmask;
-   tl_assert(setno >= 0 && setno < OC_N_SETS);
+   tl_assert(setno >= 0 && setno <= ocacheL1_set_mask);
+   set = ocacheL1_set(setno);
 
    /* we already tried line == 0; skip therefore. */
-   for (line = 1; line < OC_LINES_PER_SET; line++) {
-      if (ocacheL1->set[setno].line[line].tag == tag) {
+   for (line = 1; line < ocacheL1_ways; line++) {
+      if (set[line].tag == tag) {
          if (line == 1) {
             stats_ocacheL1_found_at_1++;
          } else {
@@ -2710,22 +3445,21 @@ static OCacheLine* find_OCacheLine_SLOW ( Addr a )
          }
          if (UNLIKELY(0 == (ocacheL1_event_ctr++ 
                             & ((1<<OC_MOVE_FORWARDS_EVERY_BITS)-1)))) {
-            moveLineForwards( &ocacheL1->set[setno], line );
+            moveLineForwards( set, line );
             line--;
          }
-         return &ocacheL1->set[setno].line[line];
+         return &set[line];
       }
    }
 
    /* A miss.  Use the last slot.  Implicitly this means we're
       ejecting the line in the last slot. */
    stats_ocacheL1_misses++;
-   tl_assert(line == OC_LINES_PER_SET);
+   tl_assert(line == ocacheL1_ways);
    line--;
-   tl_assert(line > 0);
 
    /* First, move the to-be-ejected line to the L2 cache. */
-   victim = &ocacheL1->set[setno].line[line];
+   victim = &set[line];
    c = classify_OCacheLine(victim);
    switch (c) {
       case 'e':
@@ -2757,39 +3491,44 @@ static OCacheLine* find_OCacheLine_SLOW ( Addr a )
    /* Now we must reload the L1 cache from the backing tree, if
       possible. */
    tl_assert(tag != victim->tag); /* stay sane */
+   ocache_note_region( tag );
    inL2 = ocacheL2_find_tag( tag );
    if (inL2) {
       /* We're in luck.  It's in the L2. */
-      ocacheL1->set[setno].line[line] = *inL2;
+      set[line] = *inL2;
    } else {
       /* Missed at both levels of the cache hierarchy.  We have to
          declare it as full of zeroes (unknown origins). */
       stats__ocacheL2_misses++;
-      zeroise_OCacheLine( &ocacheL1->set[setno].line[line], tag );
+      zeroise_OCacheLine( &set[line], tag );
    }
 
-   /* Move it one forwards */
-   moveLineForwards( &ocacheL1->set[setno], line );
-   line--;
+   /* Move it one forwards, unless the cache is direct mapped */
+   if (line > 0) {
+      moveLineForwards( set, line );
+      line--;
+   }
 
-   return &ocacheL1->set[setno].line[line];
+   return &set[line];
 }
 
 static INLINE OCacheLine* find_OCacheLine ( Addr a )
 {
-   UWord setno   = (a >> OC_BITS_PER_LINE) & (OC_N_SETS - 1);
+   UWord setno   = (a >> OC_BITS_PER_LINE) & ocacheL1_set_mask;
    UWord tagmask = ~((1 << OC_BITS_PER_LINE) - 1);
    UWord tag     = a & tagmask;
+   OCacheLine* line0;
 
    stats_ocacheL1_find++;
 
    if (OC_ENABLE_ASSERTIONS) {
-      tl_assert(setno >= 0 && setno < OC_N_SETS);
+      tl_assert(setno >= 0 && setno <= ocacheL1_set_mask);
       tl_assert(0 == (tag & (4 * OC_W32S_PER_LINE - 1)));
    }
 
-   if (LIKELY(ocacheL1->set[setno].line[0].tag == tag)) {
-      return &ocacheL1->set[setno].line[0];
+   line0 = ocacheL1_set(setno);
+   if (LIKELY(line0->tag == tag)) {
+      return line0;
    }
 
    return find_OCacheLine_SLOW( a );
@@ -4749,6 +5488,7 @@ static void mc_copy_reg_to_mem ( CorePart part, ThreadId tid,
                                  guest_state_offset+i, 1 );
       set_vbits8( a+i, vbits8 );
    }
+   mark_written(a, size);
 
    if (MC_(clo_mc_level) != 3)
       return;
@@ -5109,6 +5849,28 @@ VG_REGPARM(1) void MC_(helperc_STOREV64le) ( Addr a, ULong vbits64 )
    mc_STOREV64(a, vbits64, False);
 }
 
+/*------------------------------------------------------------*/
+/*--- STOREV256 and STOREV128                              ---*/
+/*------------------------------------------------------------*/
+
+/* Wide vector stores are done 64 bits at a time, as for STOREV64, but
+   with a single helper call per store. */
+VG_REGPARM(1) void MC_(helperc_STOREV256le) ( Addr a,
+                                              ULong vbits64_0, ULong vbits64_1,
+                                              ULong vbits64_2, ULong vbits64_3 )
+{
+   mc_STOREV64(a +  0, vbits64_0, False);
+   mc_STOREV64(a +  8, vbits64_1, False);
+   mc_STOREV64(a + 16, vbits64_2, False);
+   mc_STOREV64(a + 24, vbits64_3, False);
+}
+VG_REGPARM(1) void MC_(helperc_STOREV128le) ( Addr a,
+                                              ULong vbits64_0, ULong vbits64_1 )
+{
+   mc_STOREV64(a + 0, vbits64_0, False);
+   mc_STOREV64(a + 8, vbits64_1, False);
+}
+
 /*------------------------------------------------------------*/
 /*--- LOADV32                                              ---*/
 /*------------------------------------------------------------*/
@@ -5404,19 +6166,6 @@ VG_REGPARM(1) UWord MC_(helperc_LOADV16le) ( Addr a )
 /*--- STOREV16                                             ---*/
 /*------------------------------------------------------------*/
 
-/* True if the vabits4 in vabits8 indicate a and a+1 are accessible. */
-static INLINE
-Bool accessible_vabits4_in_vabits8 ( Addr a, UChar vabits8 )
-{
-   UInt shift;
-   tl_assert(VG_IS_2_ALIGNED(a));      // Must be 2-aligned
-   shift = (a & 2) << 1;               // shift by 0 or 4
-   vabits8 >>= shift;                  // shift the four bits to the bottom
-    // check 2 x vabits2 != VA_BITS2_NOACCESS
-   return ((0x3 & vabits8) != VA_BITS2_NOACCESS)
-      &&  ((0xc & vabits8) != VA_BITS2_NOACCESS << 2);
-}
-
 static INLINE
 void mc_STOREV16 ( Addr a, UWord vbits16, Bool isBigEndian )
 {
@@ -5830,6 +6579,7 @@ static Int mc_get_or_set_vbits_for_client (
          ok = set_vbits8(a + i, ((UChar*)vbits)[i]);
          tl_assert(ok);
       }
+      mark_written(a, szB);
    } else {
       /* getting */
       for (i = 0; i < szB; i++) {
@@ -5915,11 +6665,7 @@ static void init_shadow_memory ( void )
    for (i = 0; i < N_PRIMARY_MAP; i++)
       primary_map[i] = &sm_distinguished[SM_DIST_NOACCESS];
 
-   /* Auxiliary primary maps */
-   init_auxmap_L1_L2();
-
-   /* auxmap_size = auxmap_used = 0; 
-      no ... these are statically initialised */
+   /* The high map is statically initialised to empty. */
 
    /* Secondary V bit table */
    secVBitTable = createSecVBitTable();
@@ -5992,16 +6738,16 @@ static Bool mc_expensive_sanity_check ( void )
          return False;
    }
 
-   /* check the auxiliary maps, very thoroughly */
+   /* check the high map, very thoroughly */
    n_secmaps_found = 0;
-   errmsg = check_auxmap_L1_L2_sanity( &n_secmaps_found );
+   errmsg = check_high_map_sanity( &n_secmaps_found );
    if (errmsg) {
-      VG_(printf)("memcheck expensive sanity, auxmaps:\n\t%s", errmsg);
+      VG_(printf)("memcheck expensive sanity, high map:\n\t%s", errmsg);
       return False;
    }
 
-   /* n_secmaps_found is now the number referred to by the auxiliary
-      primary map.  Now add on the ones referred to by the main
+   /* n_secmaps_found is now the number referred to by the high
+      map.  Now add on the ones referred to by the main
       primary map. */
    for (i = 0; i < N_PRIMARY_MAP; i++) {
       if (primary_map[i] == NULL) {
@@ -6023,9 +6769,40 @@ static Bool mc_expensive_sanity_check ( void )
       return False;
    }
 
+   /* check the reference counts of the shared secmaps */
+   {
+      UInt         refs[N_SHARED_SMS];
+      HighMapLeaf* leaf;
+      VG_(memset)(refs, 0, sizeof(refs));
+      for (i = 0; i < N_PRIMARY_MAP; i++)
+         if (is_shared_sm(primary_map[i]))
+            refs[primary_map[i] - &sm_distinguished[3]]++;
+      for (leaf = high_map_leaves; leaf; leaf = leaf->next)
+         for (i = 0; i < N_HIGH_MAP_LEAF; i++)
+            if (is_shared_sm(leaf->sm[i]))
+               refs[leaf->sm[i] - &sm_distinguished[3]]++;
+      if (VG_(memcmp)(refs, sm_shared_refs, sizeof(refs)) != 0) {
+         VG_(printf)("memcheck expensive sanity: "
+                     "wrong shared secmap reference counts\n");
+         return False;
+      }
+      /* and that the shared secmaps in use have not changed */
+      for (i = 0; i < N_SHARED_SMS; i++) {
+         UInt hash;
+         if (sm_shared_refs[i] == 0)
+            continue;
+         hash_secmap(&sm_distinguished[3 + i], &hash);
+         if (hash != sm_shared_hash[i]) {
+            VG_(printf)("memcheck expensive sanity: "
+                        "shared secmaps have changed\n");
+            return False;
+         }
+      }
+   }
+
    if (bad) {
       VG_(printf)("memcheck expensive sanity: "
-                  "auxmap covers wrong address space\n");
+                  "high map covers wrong address space\n");
       return False;
    }
 
@@ -6044,6 +6821,7 @@ static Bool mc_expensive_sanity_check ( void )
 Bool          MC_(clo_partial_loads_ok)       = True;
 Long          MC_(clo_freelist_vol)           = 20*1000*1000LL;
 Long          MC_(clo_freelist_big_blocks)    =  1*1000*1000LL;
+Long          MC_(clo_freelist_release)       = 0;
 LeakCheckMode MC_(clo_leak_check)             = LC_Summary;
 VgRes         MC_(clo_leak_resolution)        = Vg_HighRes;
 UInt          MC_(clo_show_leak_kinds)        = R2S(Possible) | R2S(Unreached);
@@ -6052,6 +6830,7 @@ UInt          MC_(clo_leak_check_heuristics)  =   H2S(LchStdString)
                                                 | H2S( LchLength64)
                                                 | H2S( LchNewArray)
                                                 | H2S( LchMultipleInheritance);
+Bool          MC_(clo_leak_check_incremental) = False;
 Bool          MC_(clo_xtree_leak)             = False;
 const HChar*  MC_(clo_xtree_leak_file) = "xtleak.kcg.%p";
 Bool          MC_(clo_workaround_gcc296_bugs) = False;
@@ -6059,7 +6838,12 @@ Int           MC_(clo_malloc_fill)            = -1;
 Int           MC_(clo_free_fill)              = -1;
 KeepStacktraces MC_(clo_keep_stacktraces)     = KS_alloc_and_free;
 Int           MC_(clo_mc_level)               = 2;
+Bool          MC_(clo_track_origins_heap_only) = False;
+UInt          MC_(clo_origin_cache_sets)      = OC_DEFAULT_SETS;
+UInt          MC_(clo_origin_cache_ways)      = OC_DEFAULT_WAYS;
 Bool          MC_(clo_show_mismatched_frees)  = True;
+Bool          MC_(clo_share_secmaps)          = True;
+UInt          MC_(clo_sample_rate)            = 1;
 
 ExpensiveDefinednessChecks
               MC_(clo_expensive_definedness_checks) = EdcAUTO;
@@ -6088,7 +6872,7 @@ static Bool mc_process_cmd_line_options(const HChar* arg)
 
       Do this by inspecting --undef-value-errors= and
       --track-origins=.  Reject the case --undef-value-errors=no
-      --track-origins=yes as meaningless.
+      --track-origins=yes|heap as meaningless.
    */
    if VG_BOOL_CLO(arg, "--undef-value-errors", tmp_show) {
       if (tmp_show) {
@@ -6102,7 +6886,16 @@ static Bool mc_process_cmd_line_options(const HChar* arg)
          }
       }
    }
+   else if (VG_STREQ_CLOM(cloP, arg, "--track-origins=heap")) {
+      if (MC_(clo_mc_level) == 1) {
+         goto bad_level;
+      } else {
+         MC_(clo_mc_level) = 3;
+         MC_(clo_track_origins_heap_only) = True;
+      }
+   }
    else if VG_BOOL_CLO(arg, "--track-origins", tmp_show) {
+      MC_(clo_track_origins_heap_only) = False;
       if (tmp_show)  {
          if (MC_(clo_mc_level) == 1) {
             goto bad_level;
@@ -6124,6 +6917,8 @@ static Bool mc_process_cmd_line_options(const HChar* arg)
    else if VG_USET_CLOM(cloPD, arg, "--leak-check-heuristics",
                         MC_(parse_leak_heuristics_tokens),
                         MC_(clo_leak_check_heuristics)) {}
+   else if VG_BOOL_CLO(arg, "--leak-check-incremental",
+                       MC_(clo_leak_check_incremental)) {}
    else if (VG_BOOL_CLOM(cloPD, arg, "--show-reachable", tmp_show)) {
       if (tmp_show) {
          MC_(clo_show_leak_kinds) = MC_(all_Reachedness)();
@@ -6148,6 +6943,10 @@ static Bool mc_process_cmd_line_options(const HChar* arg)
                         MC_(clo_freelist_big_blocks),
                         0, 10*1000*1000*1000LL) {}
 
+   else if VG_BINT_CLOM(cloPD, arg, "--freelist-release",
+                        MC_(clo_freelist_release),
+                        0, 10*1000*1000*1000LL) {}
+
    else if VG_XACT_CLOM(cloPD, arg, "--leak-check=no",
                        MC_(clo_leak_check), LC_Off) {}
    else if VG_XACT_CLOM(cloPD, arg, "--leak-check=summary",
@@ -6253,6 +7052,17 @@ static Bool mc_process_cmd_line_options(const HChar* arg)
    else if VG_BOOL_CLOM(cloPD, arg, "--show-mismatched-frees",
                         MC_(clo_show_mismatched_frees)) {}
 
+   else if VG_BOOL_CLO(arg, "--share-secmaps", MC_(clo_share_secmaps)) {}
+   else if VG_BINT_CLO(arg, "--origin-cache-sets",
+                       MC_(clo_origin_cache_sets), OC_MIN_SETS, OC_MAX_SETS) {
+      if ((MC_(clo_origin_cache_sets) & (MC_(clo_origin_cache_sets) - 1)) != 0)
+         VG_(fmsg_bad_option)(arg, "Value must be a power of 2\n");
+   }
+   else if VG_BINT_CLO(arg, "--origin-cache-ways",
+                       MC_(clo_origin_cache_ways), 1, OC_MAX_WAYS) {}
+   else if VG_BINT_CLO(arg, "--sample-rate",
+                       MC_(clo_sample_rate), 1, 1000000) {}
+
    else if VG_XACT_CLO(arg, "--expensive-definedness-checks=no",
                             MC_(clo_expensive_definedness_checks), EdcNO) {}
    else if VG_XACT_CLO(arg, "--expensive-definedness-checks=auto",
@@ -6273,7 +7083,7 @@ static Bool mc_process_cmd_line_options(const HChar* arg)
 
   bad_level:
    VG_(fmsg_bad_option)(arg,
-      "--track-origins=yes has no effect when --undef-value-errors=no.\n");
+      "--track-origins=yes|heap has no effect when --undef-value-errors=no.\n");
    return False;
 }
 
@@ -6292,6 +7102,8 @@ static void mc_print_usage(void)
 "        improving leak search false positive [all]\n"
 "        where heur is one of:\n"
 "          stdstring length64 newarray multipleinheritance all none\n"
+"    --leak-check-incremental=no|yes  only rescan the memory written since\n"
+"                                     the previous leak search? [no]\n"
 "    --show-reachable=yes             same as --show-leak-kinds=all\n"
 "    --show-reachable=no --show-possibly-lost=yes\n"
 "                                     same as --show-leak-kinds=definite,possible\n"
@@ -6300,12 +7112,20 @@ static void mc_print_usage(void)
 "    --xtree-leak=no|yes              output leak result in xtree format? [no]\n"
 "    --xtree-leak-file=<file>         xtree leak report file [xtleak.kcg.%%p]\n"
 "    --undef-value-errors=no|yes      check for undefined value errors [yes]\n"
-"    --track-origins=no|yes           show origins of undefined values? [no]\n"
+"    --track-origins=no|heap|yes      show origins of undefined values? [no]\n"
+"                                     (heap: only those from heap blocks)\n"
+"    --origin-cache-sets=<number>     nr of sets of the origin tracking\n"
+"                                     cache, a power of 2 [1048576]\n"
+"    --origin-cache-ways=<number>     nr of lines per set of the origin\n"
+"                                     tracking cache, 1 to 8 [2]\n"
 "    --partial-loads-ok=no|yes        too hard to explain here; see manual [yes]\n"
 "    --expensive-definedness-checks=no|auto|yes\n"
 "                                     Use extra-precise definedness tracking [auto]\n"
 "    --freelist-vol=<number>          volume of freed blocks queue     [20000000]\n"
 "    --freelist-big-blocks=<number>   releases first blocks with size>= [1000000]\n"
+"    --freelist-release=<number>      give back memory of queued freed blocks\n"
+"                                     every <number> bytes freed (0: never) [0]\n"
+"                                     (reads after free then give zeros)\n"
 "    --workaround-gcc296-bugs=no|yes  self explanatory [no].  Deprecated.\n"
 "                                     Use --ignore-range-below-sp instead.\n"
 "    --ignore-ranges=0xPP-0xQQ[,0xRR-0xSS]   assume given addresses are OK\n"
@@ -6316,6 +7136,10 @@ static void mc_print_usage(void)
 "    --keep-stacktraces=alloc|free|alloc-and-free|alloc-then-free|none\n"
 "        stack trace(s) to keep for malloc'd/free'd areas       [alloc-and-free]\n"
 "    --show-mismatched-frees=no|yes   show frees that don't match the allocator? [yes]\n"
+"    --share-secmaps=no|yes           share identical parts of the shadow\n"
+"                                     memory to save space? [yes]\n"
+"    --sample-rate=<number>           only check 1 in <number> superblocks,\n"
+"                                     and only for invalid accesses [1]\n"
    );
 }
 
@@ -7340,6 +8164,17 @@ static const HChar* MC_(event_ctr_name)[MCPE_LAST] = {
    [MCPE_COPY_ADDRESS_RANGE_STATE] = "copy_address_range_state",
    [MCPE_COPY_ADDRESS_RANGE_STATE_LOOP1] = "copy_address_range_state(loop1)",
    [MCPE_COPY_ADDRESS_RANGE_STATE_LOOP2] = "copy_address_range_state(loop2)",
+   [MCPE_COPY_ADDRESS_RANGE_STATE_CHUNK] = "copy_address_range_state(chunk)",
+   [MCPE_COPY_ADDRESS_RANGE_STATE_SHARE_SM] =
+        "copy_address_range_state(share-sm)",
+   [MCPE_MOVE_MEM_REMAP] = "move_mem_remap",
+   [MCPE_MOVE_MEM_REMAP_SM] = "move_mem_remap(move-sm)",
+   [MCPE_MAKE_MEM_DEFINED_IF_ADDRESSABLE] = "make_mem_defined_if_addressable",
+   [MCPE_MAKE_MEM_DEFINED_IF_ADDRESSABLE_CHUNK] =
+        "make_mem_defined_if_addressable(chunk)",
+   [MCPE_MAKE_MEM_DEFINED_IF_NOACCESS] = "make_mem_defined_if_noaccess",
+   [MCPE_MAKE_MEM_DEFINED_IF_NOACCESS_CHUNK] =
+        "make_mem_defined_if_noaccess(chunk)",
    [MCPE_CHECK_MEM_IS_NOACCESS] = "check_mem_is_noaccess",
    [MCPE_CHECK_MEM_IS_NOACCESS_LOOP] = "check_mem_is_noaccess(loop)",
    [MCPE_IS_MEM_ADDRESSABLE] = "is_mem_addressable",
@@ -7371,8 +8206,10 @@ static const HChar* MC_(event_ctr_name)[MCPE_LAST] = {
    [MCPE_SET_ADDRESS_RANGE_PERMS_LOOP1A] = "set_address_range_perms(loop1a)",
    [MCPE_SET_ADDRESS_RANGE_PERMS_LOOP1B] = "set_address_range_perms(loop1b)",
    [MCPE_SET_ADDRESS_RANGE_PERMS_LOOP1C] = "set_address_range_perms(loop1c)",
-   [MCPE_SET_ADDRESS_RANGE_PERMS_LOOP8A] = "set_address_range_perms(loop8a)",
-   [MCPE_SET_ADDRESS_RANGE_PERMS_LOOP8B] = "set_address_range_perms(loop8b)",
+   [MCPE_SET_ADDRESS_RANGE_PERMS_FILL_A] = "set_address_range_perms(fill-a)",
+   [MCPE_SET_ADDRESS_RANGE_PERMS_FILL_B] = "set_address_range_perms(fill-b)",
+   [MCPE_SET_ADDRESS_RANGE_PERMS_TO_DIST_SM] =
+        "set_address_range_perms(to-dist-sm)",
    [MCPE_SET_ADDRESS_RANGE_PERMS_LOOP64K] = "set_address_range_perms(loop64K)",
    [MCPE_SET_ADDRESS_RANGE_PERMS_LOOP64K_FREE_DIST_SM] =
         "set_address_range_perms(loop64K-free-dist-sm)",
@@ -7898,6 +8735,49 @@ static void ocache_sarp_Set_Origins ( Addr a, UWord len, UInt otag ) {
    tl_assert(len == 0);
 }
 
+/* Clear the origins of the whole lines in [a, a+len), which must be
+   line aligned.  Unlike helperc_b_store32, this does not load the
+   lines into the L1: a line that is in neither level of the cache has
+   no origins already.  This matters for the very large ranges given
+   by mmap, munmap and mprotect of thread stacks, which would
+   otherwise flush the L1 and make the L2 do a lookup for each line.
+   Regions that the directory says have no lines are skipped. */
+static void ocache_clear_lines ( Addr a, UWord len )
+{
+   UWord       j, region;
+   UWord*      slot;
+   Addr        tag, r_start, r_end, end = a + len;
+   OCacheLine* set;
+
+   tl_assert(0 == (a & ((1 << OC_BITS_PER_LINE) - 1)));
+   tl_assert(0 == (len & ((1 << OC_BITS_PER_LINE) - 1)));
+
+   for (r_start = a; r_start < end; r_start = r_end) {
+      region = r_start >> OC_REGION_BITS;
+      r_end  = (region + 1) << OC_REGION_BITS;
+      if (r_end > end || r_end == 0)
+         r_end = end;
+      slot = ocache_region_slot( region );
+      if (*slot != region && *slot != OC_REGION_MANY)
+         continue;
+      for (tag = r_start; tag < r_end; tag += 1 << OC_BITS_PER_LINE) {
+         set = ocacheL1_set( (tag >> OC_BITS_PER_LINE) & ocacheL1_set_mask );
+         for (j = 0; j < ocacheL1_ways; j++) {
+            if (set[j].tag == tag) {
+               zeroise_OCacheLine( &set[j], 1/*invalid*/ );
+               break;
+            }
+         }
+         if (stats__ocacheL2_n_nodes > 0)
+            ocacheL2_del_tag( tag );
+      }
+      if (*slot == region
+          && r_start == region << OC_REGION_BITS
+          && r_end - r_start == 1 << OC_REGION_BITS)
+         *slot = OC_REGION_NONE;
+   }
+}
+
 __attribute__((noinline))
 static void ocache_sarp_Clear_Origins ( Addr a, UWord len ) {
    if ((a & 1) && len >= 1) {
@@ -7927,11 +8807,9 @@ static void ocache_sarp_Clear_Origins ( Addr a, UWord len ) {
    }
    if (len >= 32) {
       tl_assert(0 == (a & 31));
-      while (len >= 32) {
-         MC_(helperc_b_store32)( a, 0 );
-         a += 32;
-         len -= 32;
-      }
+      ocache_clear_lines( a, len & ~(UWord)31 );
+      a   += len & ~(UWord)31;
+      len &= 31;
    }
    if (len >= 16) {
       MC_(helperc_b_store16)( a, 0 );
@@ -7995,8 +8873,29 @@ static void mc_post_clo_init ( void )
 
    tl_assert( MC_(clo_mc_level) >= 1 && MC_(clo_mc_level) <= 3 );
 
-   if (MC_(clo_mc_level) == 3) {
-      /* We're doing origin tracking. */
+   if (MC_(clo_sample_rate) > 1) {
+      /* Uninstrumented code does not maintain the V bits, see
+         "Sampling" above. */
+      if (MC_(clo_mc_level) == 3)
+         VG_(fmsg_bad_option)("--sample-rate",
+            "--track-origins=yes|heap cannot be used with --sample-rate\n");
+      if (MC_(clo_leak_check_incremental))
+         VG_(fmsg_bad_option)("--sample-rate",
+            "--leak-check-incremental=yes cannot be used with "
+            "--sample-rate\n");
+      MC_(clo_mc_level) = 1;
+   }
+
+   if (MC_(clo_leak_check_incremental))
+      init_written_SMs();
+
+   if (MC_(clo_sample_rate) > 1) {
+      /* Keep the stack handling simple: all of them are the same, as
+         new memory is made defined anyway. */
+      VG_(track_new_mem_stack)        ( mc_new_mem_stack );
+      VG_(track_new_mem_stack_signal) ( mc_new_mem_w_tid_no_ECU );
+   } else if (MC_(clo_mc_level) == 3 && !MC_(clo_track_origins_heap_only)) {
+      /* We're doing origin tracking, including for the stack. */
 #     ifdef PERF_FAST_STACK
       VG_(track_new_mem_stack_4_w_ECU)   ( mc_new_mem_stack_4_w_ECU   );
       VG_(track_new_mem_stack_8_w_ECU)   ( mc_new_mem_stack_8_w_ECU   );
@@ -8011,7 +8910,9 @@ static void mc_post_clo_init ( void )
       VG_(track_new_mem_stack_w_ECU)     ( mc_new_mem_stack_w_ECU     );
       VG_(track_new_mem_stack_signal)    ( mc_new_mem_w_tid_make_ECU );
    } else {
-      /* Not doing origin tracking */
+      /* Not doing origin tracking, or only for heap blocks.  Memory
+         leaving the stack still has its origins cleared, so that none
+         are left behind to be picked up by later stack frames. */
 #     ifdef PERF_FAST_STACK
       VG_(track_new_mem_stack_4)   ( mc_new_mem_stack_4   );
       VG_(track_new_mem_stack_8)   ( mc_new_mem_stack_8   );
@@ -8078,7 +8979,7 @@ static void mc_post_clo_init ( void )
    // just mark all memory it allocates as defined.]
    //
 #  if !defined(VGO_solaris)
-   if (MC_(clo_mc_level) == 3)
+   if (MC_(clo_mc_level) == 3 && !MC_(clo_track_origins_heap_only))
       VG_(track_new_mem_brk)         ( mc_new_mem_w_tid_make_ECU );
    else
       VG_(track_new_mem_brk)         ( mc_new_mem_w_tid_no_ECU );
@@ -8093,14 +8994,10 @@ static void mc_post_clo_init ( void )
    if (MC_(clo_mc_level) >= 3) {
       init_OCache();
       tl_assert(ocacheL1 != NULL);
-      for (UInt i = 0; i < 4096; i++ ) {
-         tl_assert(ocachesL2[i] != NULL);
-      }
+      tl_assert(ocacheL2 != NULL);
    } else {
       tl_assert(ocacheL1 == NULL);
-      for (UInt i = 0; i < 4096; i++ ) {
-         tl_assert(ocachesL2[i] == NULL);
-      }
+      tl_assert(ocacheL2 == NULL);
    }
 
    MC_(chunk_poolalloc) = VG_(newPA)
@@ -8140,26 +9037,17 @@ static void mc_print_stats (void)
 {
    SizeT max_secVBit_szB, max_SMs_szB, max_shmem_szB;
 
-   VG_(message)(Vg_DebugMsg, " memcheck: freelist: vol %lld length %lld\n",
-                VG_(free_queue_volume), VG_(free_queue_length));
+   VG_(message)(Vg_DebugMsg, " memcheck: freelist: vol %lld length %lld,"
+                " released %'llu bytes\n",
+                VG_(free_queue_volume), VG_(free_queue_length),
+                MC_(freelist_released_szB));
    VG_(message)(Vg_DebugMsg,
       " memcheck: sanity checks: %d cheap, %d expensive\n",
       n_sanity_cheap, n_sanity_expensive );
    VG_(message)(Vg_DebugMsg,
-      " memcheck: auxmaps: %llu auxmap entries (%lluk, %lluM) in use\n",
-      n_auxmap_L2_nodes, 
-      n_auxmap_L2_nodes * 64, 
-      n_auxmap_L2_nodes / 16 );
-   VG_(message)(Vg_DebugMsg,
-      " memcheck: auxmaps_L1: %llu searches, %llu cmps, ratio %llu:10\n",
-      n_auxmap_L1_searches, n_auxmap_L1_cmps,
-      (10ULL * n_auxmap_L1_cmps) 
-         / (n_auxmap_L1_searches ? n_auxmap_L1_searches : 1) 
-   );   
-   VG_(message)(Vg_DebugMsg,
-      " memcheck: auxmaps_L2: %llu searches, %llu nodes\n",
-      n_auxmap_L2_searches, n_auxmap_L2_nodes
-   );   
+      " memcheck: high map: %lu middle tables, %lu leaves (%luk) in use\n",
+      n_high_map_mids, n_high_map_leaves,
+      n_high_map_leaves * sizeof(HighMapLeaf) / 1024 );
 
    print_SM_info("n_issued     ", n_issued_SMs);
    print_SM_info("n_deissued   ", n_deissued_SMs);
@@ -8167,9 +9055,17 @@ static void mc_print_stats (void)
    print_SM_info("max_undefined", max_undefined_SMs);
    print_SM_info("max_defined  ", max_defined_SMs);
    print_SM_info("max_non_DSM  ", max_non_DSM_SMs);
-
-   // Three DSMs, plus the non-DSM ones
-   max_SMs_szB = (3 + max_non_DSM_SMs) * sizeof(SecMap);
+   print_SM_info("max_shared   ", max_shared_SMs);
+   VG_(message)(Vg_DebugMsg,
+      " memcheck: SMs shared: %d passes, %llu to DSMs, %llu to shared SMs"
+      " (%lluk, %lluM saved)\n",
+      n_share_passes, n_SMs_to_DSM, n_SMs_to_shared,
+      (n_SMs_to_DSM + n_SMs_to_shared) * (sizeof(SecMap) / 1024),
+      (n_SMs_to_DSM + n_SMs_to_shared) * sizeof(SecMap) / (1024 * 1024));
+
+   // The three DSMs and the N_SHARED_SMS shared ones, which are all
+   // in sm_distinguished, plus the non-DSM ones
+   max_SMs_szB = (N_DIST_SMS + max_non_DSM_SMs) * sizeof(SecMap);
    // The 3*sizeof(Word) bytes is the AVL node metadata size.
    // The VG_ROUNDUP is because the OSet pool allocator will/must align
    // the elements on pointer size.
@@ -8209,9 +9105,10 @@ static void mc_print_stats (void)
                    stats_ocacheL1_found_at_N,
                    stats_ocacheL1_movefwds );
       VG_(message)(Vg_DebugMsg,
-                   " ocacheL1: %'14lu sizeB  %'14d useful\n",
-                   (SizeT)sizeof(OCache),
-                   4 * OC_W32S_PER_LINE * OC_LINES_PER_SET * OC_N_SETS );
+                   " ocacheL1: %'14lu sizeB  %'14lu useful\n",
+                   ocacheL1_szB(),
+                   (SizeT)4 * OC_W32S_PER_LINE * MC_(clo_origin_cache_ways)
+                      * MC_(clo_origin_cache_sets) );
       VG_(message)(Vg_DebugMsg,
                    " ocacheL2: %'14lu finds  %'14lu misses\n",
                    stats__ocacheL2_finds,
@@ -8229,9 +9126,7 @@ static void mc_print_stats (void)
                    stats__nia_cache_queries, stats__nia_cache_misses);
    } else {
       tl_assert(ocacheL1 == NULL);
-      for (UInt i = 0; i < 4096; i++ ) {
-         tl_assert(ocachesL2[1] == NULL);
-      }
+      tl_assert(ocacheL2 == NULL);
    }
 }
 
@@ -8279,6 +9174,9 @@ static void mc_fini ( Int exitcode )
                    "uninitialised values come from\n");
    }
 
+   if (MC_(clo_sample_rate) > 1 && !VG_(clo_xml) && VG_(clo_verbosity) >= 1)
+      print_sampling_summary();
+
    /* Print a warning if any client-request generated ignore-ranges
       still exist.  It would be reasonable to expect that a properly
       written program would remove any such ranges before exiting, and
@@ -8371,7 +9269,8 @@ static void mc_pre_clo_init(void)
                                    MC_(get_error_name),
                                    MC_(get_extra_suppression_info),
                                    MC_(print_extra_suppression_use),
-                                   MC_(update_extra_suppression_use));
+                                   MC_(update_extra_suppression_use),
+                                   MC_(hash_Error));
    VG_(needs_libc_freeres)        ();
    VG_(needs_cxx_freeres)         ();
    VG_(needs_command_line_options)(mc_process_cmd_line_options,
@@ -8400,6 +9299,7 @@ static void mc_pre_clo_init(void)
    MC_(Malloc_Redzone_SzB) = VG_(malloc_effective_client_redzone_size)();
 
    VG_(needs_xml_output)          ();
+   VG_(needs_cacheable_translations) ();
 
    VG_(track_new_mem_startup)     ( mc_new_mem_startup );
 
@@ -8410,6 +9310,8 @@ static void mc_pre_clo_init(void)
    VG_(track_change_mem_mprotect) ( mc_new_mem_mprotect );
    
    VG_(track_copy_mem_remap)      ( MC_(copy_address_range_state) );
+   VG_(track_move_mem_remap)      ( mc_move_mem_remap );
+   VG_(track_discard_mem_madvise) ( mc_discard_mem_madvise );
 
    VG_(track_die_mem_stack_signal)( MC_(make_mem_noaccess) ); 
    VG_(track_die_mem_brk)         ( MC_(make_mem_noaccess) );
@@ -8442,6 +9344,8 @@ static void mc_pre_clo_init(void)
    VG_(track_post_reg_write)                  ( mc_post_reg_write );
    VG_(track_post_reg_write_clientcall_return)( mc_post_reg_write_clientcall );
 
+   VG_(track_start_client_code)   ( mc_start_client_code );
+
    if (MC_(clo_mc_level) >= 2) {
       VG_(track_copy_mem_to_reg)  ( mc_copy_mem_to_reg );
       VG_(track_copy_reg_to_mem)  ( mc_copy_reg_to_mem );
@@ -8473,9 +9377,7 @@ static void mc_pre_clo_init(void)
       if we need to, since the command line args haven't been
       processed yet.  Hence defer it to mc_post_clo_init. */
    tl_assert(ocacheL1 == NULL);
-   for (UInt i = 0; i < 4096; i++ ) {
-      tl_assert(ocachesL2[i] == NULL);
-   }
+   tl_assert(ocacheL2 == NULL);
 
    /* Check some important stuff.  See extensive comments above
       re UNALIGNED_OR_HIGH for background. */
@@ -28,6 +28,7 @@
 */
 
 #include "pub_tool_basics.h"
+#include "pub_tool_aspacemgr.h"
 #include "pub_tool_execontext.h"
 #include "pub_tool_poolalloc.h"
 #include "pub_tool_hashtable.h"
@@ -37,6 +38,7 @@
 #include "pub_tool_libcproc.h"
 #include "pub_tool_mallocfree.h"
 #include "pub_tool_options.h"
+#include "pub_tool_oset.h"
 #include "pub_tool_replacemalloc.h"
 #include "pub_tool_threadstate.h"
 #include "pub_tool_tooliface.h"     // Needed for mc_include.h
@@ -96,12 +98,202 @@ void delete_MC_Chunk (MC_Chunk* mc);
 static MC_Chunk* freed_list_start[2]  = {NULL, NULL};
 static MC_Chunk* freed_list_end[2]    = {NULL, NULL};
 
+/* To find quickly the freed blocks bracketting an address, the blocks
+   on the freed lists are also indexed by the end of their bracketting
+   range (that is, including MC_(Malloc_Redzone_SzB) on each side).
+   There are two indexes:
+   * freed_index_disjoint holds the blocks allocated by the malloc
+     replacement.  As they are not given back to the allocator while
+     they are on a freed list, their ranges without the redzones do not
+     overlap, and so both ends of their bracketting ranges are sorted
+     in the same order.
+   * freed_index_custom holds the blocks of MC_AllocCustom kind (mempool
+     and VALGRIND_MALLOCLIKE_BLOCK blocks), which can overlap anything.
+     A lookup scans the blocks ending at most freed_custom_max_len bytes
+     after the address.
+   When several blocks bracket an address, the one given is the first
+   found when walking freed list 0 then 1, as given by (list, seq). */
+typedef
+   struct {
+      Addr      end;    // data + szB + MC_(Malloc_Redzone_SzB)
+      MC_Chunk* mc;     // end and mc together form the key
+   }
+   FreedKey;
+
+typedef
+   struct {
+      FreedKey  key;
+      Addr      start;  // data - MC_(Malloc_Redzone_SzB)
+      Long      seq;    // position on the freed list
+      UChar     list;   // freed list the block is on
+   }
+   FreedNode;
+
+static OSet* freed_index_disjoint = NULL;
+static OSet* freed_index_custom   = NULL;
+static SizeT freed_custom_max_len = 0;
+
+/* Next seq for a block put at the start/end of each freed list. */
+static Long freed_seq_first[2] = {0, 0};
+static Long freed_seq_last[2]  = {0, 0};
+
+static Word cmp_FreedKey ( const void* key, const void* elem )
+{
+   const FreedKey* k = key;
+   const FreedKey* e = &((const FreedNode*)elem)->key;
+   if (k->end < e->end) return -1;
+   if (k->end > e->end) return 1;
+   if ((Addr)k->mc < (Addr)e->mc) return -1;
+   if ((Addr)k->mc > (Addr)e->mc) return 1;
+   return 0;
+}
+
+static OSet* freed_index_for ( const MC_Chunk* mc )
+{
+   return mc->allockind == MC_AllocCustom
+          ? freed_index_custom : freed_index_disjoint;
+}
+
+static void add_to_freed_index ( MC_Chunk* mc, Int l, Long seq )
+{
+   const SizeT rzB = MC_(Malloc_Redzone_SzB);
+   OSet*       index;
+   FreedNode*  n;
+
+   if (freed_index_disjoint == NULL) {
+      freed_index_disjoint = VG_(OSetGen_Create_With_Pool)
+         ( offsetof(FreedNode, key),
+           cmp_FreedKey,
+           VG_(malloc), "mc.atfi.1 (freed blocks index)",
+           VG_(free),
+           1000,
+           sizeof(FreedNode));
+      freed_index_custom = VG_(OSetGen_EmptyClone)(freed_index_disjoint);
+   }
+
+   index = freed_index_for(mc);
+   n = VG_(OSetGen_AllocNode)(index, sizeof(FreedNode));
+   n->key.end = mc->data + mc->szB + rzB;
+   n->key.mc  = mc;
+   n->start   = mc->data - rzB;
+   n->seq     = seq;
+   n->list    = l;
+   VG_(OSetGen_Insert)(index, n);
+
+   if (index == freed_index_custom && mc->szB + 2 * rzB > freed_custom_max_len)
+      freed_custom_max_len = mc->szB + 2 * rzB;
+}
+
+static void remove_from_freed_index ( MC_Chunk* mc )
+{
+   OSet*      index = freed_index_for(mc);
+   FreedKey   key   = { mc->data + mc->szB + MC_(Malloc_Redzone_SzB), mc };
+   FreedNode* n     = VG_(OSetGen_Remove)(index, &key);
+
+   tl_assert(n != NULL);
+   VG_(OSetGen_FreeNode)(index, n);
+   if (index == freed_index_custom && VG_(OSetGen_Size)(index) == 0)
+      freed_custom_max_len = 0;
+}
+
+/* Updates *best with the first block of index bracketting a. */
+static void lookup_freed_index ( OSet* index, Bool disjoint, Addr a,
+                                 /*MOD*/FreedNode** best )
+{
+   FreedKey   key = { a + 1, NULL };
+   FreedNode* n;
+
+   if (index == NULL || a + 1 == 0)
+      return;
+   VG_(OSetGen_ResetIterAt)(index, &key);
+   while ( (n = VG_(OSetGen_Next)(index)) ) {
+      if (disjoint ? n->start > a : n->key.end - a > freed_custom_max_len)
+         break;
+      if (n->start <= a
+          && (*best == NULL
+              || n->list < (*best)->list
+              || (n->list == (*best)->list && n->seq < (*best)->seq)))
+         *best = n;
+   }
+}
+
+/* With --freelist-release, the memory of the blocks put at the end of
+   the freed lists is given back to the kernel each time their volume
+   reaches MC_(clo_freelist_release).  unreleased_start[l] is the first
+   block of list l whose memory was not yet released, all the blocks
+   after it being in the same case. */
+static MC_Chunk* unreleased_start[2] = {NULL, NULL};
+static Long      unreleased_volume   = 0;
+ULong            MC_(freelist_released_szB) = 0;
+
+/* The whole pages of a block to give back to the kernel. */
+typedef
+   struct {
+      Addr lo;
+      Addr hi;
+   }
+   PageRange;
+
+static Int cmp_PageRange ( const void* v1, const void* v2 )
+{
+   const PageRange* r1 = v1;
+   const PageRange* r2 = v2;
+   if (r1->lo < r2->lo) return -1;
+   if (r1->lo > r2->lo) return 1;
+   return 0;
+}
+
+static void release_freed_blocks_memory ( void )
+{
+   XArray* ranges = VG_(newXA)(VG_(malloc), "mc.rfbm.1 (freed pages)",
+                               VG_(free), sizeof(PageRange));
+   Word    i, n;
+   Int     l;
+
+   for (l = 0; l < 2; l++) {
+      MC_Chunk* mc;
+      for (mc = unreleased_start[l]; mc != NULL; mc = mc->next) {
+         /* Only the whole pages inside the block: the allocator keeps
+            its own data just before and after the block. */
+         PageRange r = { VG_PGROUNDUP(mc->data),
+                         VG_PGROUNDDN(mc->data + mc->szB) };
+         if (mc->allockind == MC_AllocCustom || r.hi <= r.lo)
+            continue;
+         VG_(addToXA)(ranges, &r);
+      }
+      unreleased_start[l] = NULL;
+   }
+   unreleased_volume = 0;
+
+   /* Release the pages in address order, with one call for each run
+      of contiguous pages. */
+   VG_(setCmpFnXA)(ranges, cmp_PageRange);
+   VG_(sortXA)(ranges);
+   n = VG_(sizeXA)(ranges);
+   for (i = 0; i < n; ) {
+      const PageRange* r = VG_(indexXA)(ranges, i);
+      Addr lo = r->lo;
+      Addr hi = r->hi;
+      for (i++; i < n; i++) {
+         r = VG_(indexXA)(ranges, i);
+         if (r->lo > hi)
+            break;
+         if (r->hi > hi)
+            hi = r->hi;
+      }
+      if (!sr_isError(VG_(am_release_pages)(lo, hi - lo)))
+         MC_(freelist_released_szB) += hi - lo;
+   }
+   VG_(deleteXA)(ranges);
+}
+
 /* Put a shadow chunk on the freed blocks queue, possibly freeing up
    some of the oldest blocks in the queue at the same time. */
 static void add_to_freed_queue ( MC_Chunk* mc )
 {
    const Bool show = False;
    const int l = (mc->szB >= MC_(clo_freelist_big_blocks) ? 0 : 1);
+   Bool at_end = True;
 
    /* Put it at the end of the freed list, unless the block
       would be directly released any way : in this case, we
@@ -115,12 +307,27 @@ static void add_to_freed_queue ( MC_Chunk* mc )
       if (mc->szB >= MC_(clo_freelist_vol)) {
          mc->next = freed_list_start[l];
          freed_list_start[l] = mc;
+         at_end = False;
       } else {
          mc->next = NULL;
          freed_list_end[l]->next = mc;
          freed_list_end[l]       = mc;
       }
    }
+   add_to_freed_index(mc, l, at_end ? freed_seq_last[l]++
+                                    : --freed_seq_first[l]);
+
+   /* The memory is not released if it must keep the --free-fill value,
+      nor for blocks released soon anyway. */
+   if (MC_(clo_freelist_release) > 0 && at_end && MC_(clo_free_fill) == -1
+       && mc->allockind != MC_AllocCustom) {
+      if (unreleased_start[l] == NULL)
+         unreleased_start[l] = mc;
+      unreleased_volume += (Long)mc->szB;
+      if (unreleased_volume >= MC_(clo_freelist_release))
+         release_freed_blocks_memory();
+   }
+
    VG_(free_queue_volume) += (Long)mc->szB;
    if (show)
       VG_(printf)("mc_freelist: acquire: volume now %lld\n", 
@@ -160,6 +367,11 @@ static void release_oldest_block(void)
          } else {
             freed_list_start[i] = mc1->next;
          }
+         if (unreleased_start[i] == mc1) {
+            unreleased_start[i] = mc1->next;
+            unreleased_volume -= (Long)mc1->szB;
+         }
+         remove_from_freed_index(mc1);
          mc1->next = NULL; /* just paranoia */
 
          /* free MC_Chunk */
@@ -172,18 +384,14 @@ static void release_oldest_block(void)
 
 MC_Chunk* MC_(get_freed_block_bracketting) (Addr a)
 {
-   int i;
-   for (i = 0; i < 2; i++) {
-      MC_Chunk*  mc;
-      mc = freed_list_start[i];
-      while (mc) {
-         if (VG_(addr_is_in_block)( a, mc->data, mc->szB,
-                                    MC_(Malloc_Redzone_SzB) ))
-            return mc;
-         mc = mc->next;
-      }
-   }
-   return NULL;
+   FreedNode* best = NULL;
+   lookup_freed_index(freed_index_disjoint, /*disjoint*/True,  a, &best);
+   lookup_freed_index(freed_index_custom,   /*disjoint*/False, a, &best);
+   if (best == NULL)
+      return NULL;
+   tl_assert(VG_(addr_is_in_block)( a, best->key.mc->data, best->key.mc->szB,
+                                    MC_(Malloc_Redzone_SzB) ));
+   return best->key.mc;
 }
 
 /* Allocate a shadow chunk, put it on the appropriate list.
@@ -5965,12 +5965,33 @@ void do_shadow_Store ( MCEnv* mce,
       those actions are gated on |guard|. */
    complainIfUndefined( mce, addr, guard );
 
+   /* For incremental leak searches, note that the memory at the
+      address has been written. */
+   if (MC_(clo_leak_check_incremental)) {
+      IRAtom*  addrAct = addr;
+      IRDirty* diMW;
+      if (bias != 0) {
+         IRAtom* eBias = tyAddr==Ity_I32 ? mkU32(bias) : mkU64(bias);
+         addrAct = assignNew('V', mce, tyAddr, binop(mkAdd, addr, eBias));
+      }
+      diMW = unsafeIRDirty_0_N(
+                1/*regparms*/,
+                "MC_(helperc_mark_written)",
+                VG_(fnptr_to_fnentry)( &MC_(helperc_mark_written) ),
+                mkIRExprVec_1( addrAct )
+             );
+      if (guard)
+         diMW->guard = guard;
+      stmt( 'V', mce, IRStmt_Dirty(diMW) );
+   }
+
    /* Now decide which helper function to call to write the data V
       bits into shadow memory. */
    if (end == Iend_LE) {
       switch (ty) {
-         case Ity_V256: /* we'll use the helper four times */
-         case Ity_V128: /* we'll use the helper twice */
+         case Ity_V256: /* we'll use MC_(helperc_STOREV256le) instead */
+         case Ity_V128: /* we'll use the helper twice, or
+                           MC_(helperc_STOREV128le) */
          case Ity_I128: /* we'll use the helper twice */
          case Ity_I64: helper = &MC_(helperc_STOREV64le);
                        hname = "MC_(helperc_STOREV64le)";
@@ -6010,71 +6031,64 @@ void do_shadow_Store ( MCEnv* mce,
    if (UNLIKELY(ty == Ity_V256)) {
 
       /* V256-bit case -- phrased in terms of 64 bit units (Qs), with
-         Q3 being the most significant lane. */
-      /* These are the offsets of the Qs in memory. */
-      Int     offQ0, offQ1, offQ2, offQ3;
-
-      /* Various bits for constructing the 4 lane helper calls */
-      IRDirty *diQ0,    *diQ1,    *diQ2,    *diQ3;
-      IRAtom  *addrQ0,  *addrQ1,  *addrQ2,  *addrQ3;
+         Q3 being the most significant lane.  All four are handed to a
+         single helper call.  Only little-endian 64-bit hosts have
+         256-bit vectors. */
+      IRDirty *di;
+      IRAtom  *addrAct;
       IRAtom  *vdataQ0, *vdataQ1, *vdataQ2, *vdataQ3;
-      IRAtom  *eBiasQ0, *eBiasQ1, *eBiasQ2, *eBiasQ3;
 
-      if (end == Iend_LE) {
-         offQ0 = 0; offQ1 = 8; offQ2 = 16; offQ3 = 24;
+      tl_assert(end == Iend_LE);
+      tl_assert(tyAddr == Ity_I64);
+
+      if (bias == 0) {
+         addrAct = addr;
       } else {
-         offQ3 = 0; offQ2 = 8; offQ1 = 16; offQ0 = 24;
+         addrAct = assignNew('V', mce, tyAddr, binop(mkAdd, addr,
+                                                     mkU64(bias)));
       }
-
-      eBiasQ0 = tyAddr==Ity_I32 ? mkU32(bias+offQ0) : mkU64(bias+offQ0);
-      addrQ0  = assignNew('V', mce, tyAddr, binop(mkAdd, addr, eBiasQ0) );
       vdataQ0 = assignNew('V', mce, Ity_I64, unop(Iop_V256to64_0, vdata));
-      diQ0    = unsafeIRDirty_0_N( 
-                   1/*regparms*/, 
-                   hname, VG_(fnptr_to_fnentry)( helper ), 
-                   mkIRExprVec_2( addrQ0, vdataQ0 )
-                );
-
-      eBiasQ1 = tyAddr==Ity_I32 ? mkU32(bias+offQ1) : mkU64(bias+offQ1);
-      addrQ1  = assignNew('V', mce, tyAddr, binop(mkAdd, addr, eBiasQ1) );
       vdataQ1 = assignNew('V', mce, Ity_I64, unop(Iop_V256to64_1, vdata));
-      diQ1    = unsafeIRDirty_0_N( 
-                   1/*regparms*/, 
-                   hname, VG_(fnptr_to_fnentry)( helper ), 
-                   mkIRExprVec_2( addrQ1, vdataQ1 )
-                );
-
-      eBiasQ2 = tyAddr==Ity_I32 ? mkU32(bias+offQ2) : mkU64(bias+offQ2);
-      addrQ2  = assignNew('V', mce, tyAddr, binop(mkAdd, addr, eBiasQ2) );
       vdataQ2 = assignNew('V', mce, Ity_I64, unop(Iop_V256to64_2, vdata));
-      diQ2    = unsafeIRDirty_0_N( 
-                   1/*regparms*/, 
-                   hname, VG_(fnptr_to_fnentry)( helper ), 
-                   mkIRExprVec_2( addrQ2, vdataQ2 )
-                );
-
-      eBiasQ3 = tyAddr==Ity_I32 ? mkU32(bias+offQ3) : mkU64(bias+offQ3);
-      addrQ3  = assignNew('V', mce, tyAddr, binop(mkAdd, addr, eBiasQ3) );
       vdataQ3 = assignNew('V', mce, Ity_I64, unop(Iop_V256to64_3, vdata));
-      diQ3    = unsafeIRDirty_0_N( 
-                   1/*regparms*/, 
-                   hname, VG_(fnptr_to_fnentry)( helper ), 
-                   mkIRExprVec_2( addrQ3, vdataQ3 )
-                );
+      di = unsafeIRDirty_0_N(
+              1/*regparms*/,
+              "MC_(helperc_STOREV256le)",
+              VG_(fnptr_to_fnentry)( &MC_(helperc_STOREV256le) ),
+              mkIRExprVec_5( addrAct, vdataQ0, vdataQ1, vdataQ2, vdataQ3 )
+           );
+      if (guard) di->guard = guard;
+      setHelperAnns( mce, di );
+      stmt( 'V', mce, IRStmt_Dirty(di) );
 
-      if (guard)
-         diQ0->guard = diQ1->guard = diQ2->guard = diQ3->guard = guard;
-
-      setHelperAnns( mce, diQ0 );
-      setHelperAnns( mce, diQ1 );
-      setHelperAnns( mce, diQ2 );
-      setHelperAnns( mce, diQ3 );
-      stmt( 'V', mce, IRStmt_Dirty(diQ0) );
-      stmt( 'V', mce, IRStmt_Dirty(diQ1) );
-      stmt( 'V', mce, IRStmt_Dirty(diQ2) );
-      stmt( 'V', mce, IRStmt_Dirty(diQ3) );
-
-   } 
+   }
+   else if (ty == Ity_V128 && end == Iend_LE && tyAddr == Ity_I64) {
+
+      /* V128-bit case on a little-endian 64-bit host: the two halves
+         are handed to a single helper call. */
+      IRDirty *di;
+      IRAtom  *addrAct;
+      IRAtom  *vdataLo64, *vdataHi64;
+
+      if (bias == 0) {
+         addrAct = addr;
+      } else {
+         addrAct = assignNew('V', mce, tyAddr, binop(mkAdd, addr,
+                                                     mkU64(bias)));
+      }
+      vdataLo64 = assignNew('V', mce, Ity_I64, unop(Iop_V128to64, vdata));
+      vdataHi64 = assignNew('V', mce, Ity_I64, unop(Iop_V128HIto64, vdata));
+      di = unsafeIRDirty_0_N(
+              1/*regparms*/,
+              "MC_(helperc_STOREV128le)",
+              VG_(fnptr_to_fnentry)( &MC_(helperc_STOREV128le) ),
+              mkIRExprVec_3( addrAct, vdataLo64, vdataHi64 )
+           );
+      if (guard) di->guard = guard;
+      setHelperAnns( mce, di );
+      stmt( 'V', mce, IRStmt_Dirty(di) );
+
+   }
    else if (UNLIKELY(ty == Ity_V128 || ty == Ity_I128)) {
 
       /* V128/I128-bit case */
@@ -6414,7 +6428,7 @@ void do_AbiHint ( MCEnv* mce, IRExpr* base, Int len, IRExpr* nia )
 {
    IRDirty* di;
 
-   if (MC_(clo_mc_level) == 3) {
+   if (MC_(clo_mc_level) == 3 && !MC_(clo_track_origins_heap_only)) {
       di = unsafeIRDirty_0_N(
               3/*regparms*/,
               "MC_(helperc_MAKE_STACK_UNINIT_w_o)",
@@ -6423,7 +6437,8 @@ void do_AbiHint ( MCEnv* mce, IRExpr* base, Int len, IRExpr* nia )
            );
    } else {
       /* We ignore the supplied nia, since it is irrelevant. */
-      tl_assert(MC_(clo_mc_level) == 2 || MC_(clo_mc_level) == 1);
+      tl_assert(MC_(clo_mc_level) == 2 || MC_(clo_mc_level) == 1
+                || MC_(clo_track_origins_heap_only));
       /* Special-case the len==128 case, since that is for amd64-ELF,
          which is a very common target. */
       if (len == 128) {
@@ -8072,6 +8087,8 @@ void MC_(do_instrumentation_startup_checks)( void )
    CHECK(False, "MC_(helperc_STOREV16le)");
    CHECK(False, "MC_(helperc_STOREV32le)");
    CHECK(False, "MC_(helperc_STOREV64le)");
+   CHECK(False, "MC_(helperc_STOREV128le)");
+   CHECK(False, "MC_(helperc_STOREV256le)");
    CHECK(False, "MC_(helperc_STOREV8)");
    CHECK(False, "track_die_mem_stack_8");
    CHECK(False, "track_new_mem_stack_8_w_ECU");
@@ -8594,6 +8611,10 @@ IRSB* MC_(instrument) ( VgCallbackClosure* closure,
 
    tl_assert(MC_(clo_mc_level) >= 1 && MC_(clo_mc_level) <= 3);
 
+   /* With --sample-rate, most superblocks are left alone. */
+   if (MC_(clo_sample_rate) > 1 && !MC_(sample_SB)(closure->nraddr))
+      return sb_in;
+
    /* Set up SB */
    sb_out = deepCopyIRSBExceptStmts(sb_in);
 
@@ -8860,9 +8881,12 @@ IRSB* MC_(instrument) ( VgCallbackClosure* closure,
             break;
 
          case Ist_AbiHint:
-            do_AbiHint( &mce, st->Ist.AbiHint.base,
-                              st->Ist.AbiHint.len,
-                              st->Ist.AbiHint.nia );
+            /* When sampling, the stack is kept defined, see
+               "Sampling" in mc_main.c. */
+            if (MC_(clo_sample_rate) == 1)
+               do_AbiHint( &mce, st->Ist.AbiHint.base,
+                                 st->Ist.AbiHint.len,
+                                 st->Ist.AbiHint.nia );
             break;
 
          case Ist_CAS:
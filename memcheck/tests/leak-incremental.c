@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "../memcheck.h"
+#include "leak.h"
+
+/* Several leak searches, with allocations and frees in between.  Run with
+   and without --leak-check-incremental=yes: the results must be the same.
+   The pointers are spread over several secondary maps (64Kb each), so that
+   most of them are unchanged between two searches. */
+
+#define N_PTRS   (32 * 65536 / sizeof(char*))
+#define N_BLOCKS 100
+#define STRIDE   (N_PTRS / N_BLOCKS)
+
+static char* ptrs[N_PTRS];
+
+DECLARE_LEAK_COUNTERS;
+
+static void check(const char* what)
+{
+   fprintf(stderr, "%s\n", what);
+   CLEAR_CALLER_SAVED_REGS;
+   VALGRIND_DO_LEAK_CHECK;
+   GET_FINAL_LEAK_COUNTS;
+   PRINT_LEAK_COUNTS(stderr);
+}
+
+static void __attribute__((noinline)) alloc_blocks(int from, int to,
+                                                   size_t size)
+{
+   int i;
+   for (i = from; i < to; i++)
+      ptrs[i * STRIDE] = malloc(size);
+}
+
+static void __attribute__((noinline)) free_blocks(int from, int to)
+{
+   int i;
+   for (i = from; i < to; i++) {
+      free(ptrs[i * STRIDE]);
+      ptrs[i * STRIDE] = NULL;
+   }
+}
+
+int main(void)
+{
+   GET_INITIAL_LEAK_COUNTS;
+
+   alloc_blocks(0, N_BLOCKS, 16);
+   check("expecting 1600 bytes reachable");
+
+   ptrs[10 * STRIDE] = NULL;
+   ptrs[20 * STRIDE] = NULL;
+   ptrs[30 * STRIDE] = NULL;
+   free_blocks(40, 45);
+   check("expecting 48 bytes lost, 1472 bytes reachable");
+
+   alloc_blocks(40, 45, 32);
+   check("expecting 48 bytes lost, 1632 bytes reachable");
+
+   check("expecting no change");
+
+   free_blocks(0, N_BLOCKS);
+   check("expecting 48 bytes lost, 0 bytes reachable");
+
+   return 0;
+}
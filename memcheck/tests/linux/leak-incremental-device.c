@@ -0,0 +1,56 @@
+/* The leak search does not read the read-only and device mappings of
+   the client.  Check that --leak-check-incremental=yes does not read
+   them either when they share a secondary map (64Kb) with a root
+   segment: a read-only /dev/zero page just after a writable mapping
+   holding the only pointer to a block must not become resident. */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../../memcheck.h"
+
+#define SM_SIZE 65536
+
+int main (void)
+{
+   long  pg = sysconf(_SC_PAGESIZE);
+   int   fd = open("/dev/zero", O_RDONLY);
+   char  *area, *base, *dev;
+   char  **root;
+   size_t root_szB = pg < SM_SIZE ? SM_SIZE - pg : pg;
+   unsigned char vec;
+
+   /* A root segment at the start of a secondary map, the device page
+      right after it. */
+   area = mmap(NULL, 2 * SM_SIZE + pg, PROT_NONE,
+               MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   base = (char*)(((uintptr_t)area + SM_SIZE - 1) & ~(uintptr_t)(SM_SIZE - 1));
+   root = mmap(base, root_szB, PROT_READ|PROT_WRITE,
+               MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED, -1, 0);
+   dev = mmap(base + root_szB, pg, PROT_READ, MAP_PRIVATE|MAP_FIXED, fd, 0);
+   if (fd < 0 || area == MAP_FAILED || root == MAP_FAILED
+       || dev == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+   }
+
+   root[0] = malloc(100);
+
+   VALGRIND_DO_LEAK_CHECK;
+   VALGRIND_DO_ADDED_LEAK_CHECK;
+
+   if (mincore(dev, pg, &vec) != 0) {
+      perror("mincore");
+      return 1;
+   }
+   fprintf(stderr, "device page read: %s\n", (vec & 1) ? "yes" : "no");
+
+   free(root[0]);
+   return 0;
+}
@@ -0,0 +1,51 @@
+/* Check that making a large mapping accessible again with mprotect,
+   as glibc does for each new thread stack, turns only its noaccess
+   bytes into defined ones, and that it does not leave stale origins
+   behind for them. */
+
+#include <stdio.h>
+#include <sys/mman.h>
+
+#include "../../memcheck.h"
+
+#define SZ (8 << 20)
+
+int main (void)
+{
+   unsigned char vb[8], half = 0x0f, undef = 0xff;
+   char *p = mmap(NULL, SZ, PROT_READ|PROT_WRITE,
+                  MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+
+   /* A whole secondary's worth of noaccess, one of undefined, one
+      byte partly defined and a small noaccess hole. */
+   VALGRIND_MAKE_MEM_NOACCESS(p, 65536);
+   VALGRIND_MAKE_MEM_UNDEFINED(p + 65536, 65536);
+   (void)VALGRIND_SET_VBITS(p + 131072 + 100, &half, 1);
+   VALGRIND_MAKE_MEM_NOACCESS(p + 131072 + 1001, 999);
+   /* These bytes get an origin, then lose it as they become
+      noaccess. */
+   VALGRIND_MAKE_MEM_UNDEFINED(p + 200000, 64);
+   VALGRIND_MAKE_MEM_NOACCESS(p + 200000, 64);
+
+   mprotect(p, SZ, PROT_NONE);
+   mprotect(p, SZ, PROT_READ|PROT_WRITE);
+
+   printf("noaccess secondary: %d\n",
+          VALGRIND_CHECK_MEM_IS_DEFINED(p, 65536) == 0);
+   printf("undefined secondary: %d\n",
+          VALGRIND_GET_VBITS(p + 65536 + 8, vb, 8) == 1
+          && vb[0] == 0xff && vb[7] == 0xff);
+   printf("partly defined: %d\n",
+          VALGRIND_GET_VBITS(p + 131072 + 100, vb, 1) == 1
+          && vb[0] == 0x0f);
+   printf("noaccess hole: %d\n",
+          VALGRIND_CHECK_MEM_IS_DEFINED(p + 131072 + 1001, 999) == 0);
+   printf("rest: %d\n",
+          VALGRIND_CHECK_MEM_IS_DEFINED(p + 196608, SZ - 196608) == 0);
+
+   /* No origin should be given for this. */
+   (void)VALGRIND_SET_VBITS(p + 200000, &undef, 1);
+   if (p[200000])
+      printf("nonzero\n");
+   return 0;
+}
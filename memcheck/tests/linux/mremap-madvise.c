@@ -0,0 +1,89 @@
+/* Check that memcheck carries the A and V bits of a mapping across
+   mremap moves, both when the old and new addresses have the same
+   offset within a secondary map (the secondaries are moved) and when
+   they do not (the bits are copied), and that madvise(MADV_DONTNEED)
+   makes the discarded pages defined while leaving no-access parts
+   alone. */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "../../memcheck.h"
+
+#define SZ (4 << 20)
+
+/* p[0 .. SZ/2) is defined, except p[100] which is half defined,
+   p[SZ/2 .. SZ-4096) is undefined and the last page is no-access. */
+static char *setup (void)
+{
+   unsigned char vb = 0x0f;
+   char *p = mmap(NULL, SZ, PROT_READ|PROT_WRITE,
+                  MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   memset(p, 1, SZ);
+   VALGRIND_MAKE_MEM_UNDEFINED(p + SZ/2, SZ/2);
+   (void)VALGRIND_SET_VBITS(p + 100, &vb, 1);
+   VALGRIND_MAKE_MEM_NOACCESS(p + SZ - 4096, 4096);
+   return p;
+}
+
+static void check (const char *what, char *p)
+{
+   unsigned char vb[8];
+   int r;
+
+   r = VALGRIND_GET_VBITS(p + 96, vb, 8);
+   printf("%s: partly defined: %d %02x %02x %02x\n",
+          what, r, vb[3], vb[4], vb[5]);
+   r = VALGRIND_GET_VBITS(p + SZ/2 + 8, vb, 8);
+   printf("%s: undefined: %d %02x %02x\n", what, r, vb[0], vb[7]);
+   printf("%s: defined: %d\n", what,
+          VALGRIND_CHECK_MEM_IS_DEFINED(p + 1000, SZ/2 - 1000) == 0);
+   printf("%s: noaccess: %d\n", what,
+          VALGRIND_GET_VBITS(p + SZ - 4096, vb, 8));
+}
+
+/* Returns an unmapped address whose offset modulo 64KB is that of
+   p plus delta. */
+static char *target (char *p, unsigned long delta)
+{
+   char *area = mmap(NULL, 4 * SZ, PROT_NONE,
+                     MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+   char *r = (char *)(((unsigned long)area + SZ + 0xffff) & ~0xffffUL)
+             + (((unsigned long)p + delta) & 0xffff);
+   munmap(area, 4 * SZ);
+   return r;
+}
+
+int main (void)
+{
+   unsigned char vb[8];
+   char *p = setup(), *q, *r;
+
+   check("original", p);
+
+   r = target(p, 0);
+   q = mremap(p, SZ, SZ, MREMAP_MAYMOVE|MREMAP_FIXED, r);
+   printf("same offset: moved %d\n", q == r);
+   check("same offset", q);
+   printf("same offset: old noaccess: %d\n",
+          VALGRIND_GET_VBITS(p, vb, 8));
+
+   p = q;
+   r = target(p, 0x3000);
+   q = mremap(p, SZ, SZ + 8192, MREMAP_MAYMOVE|MREMAP_FIXED, r);
+   printf("other offset: moved %d\n", q == r);
+   check("other offset", q);
+   printf("other offset: old noaccess: %d\n",
+          VALGRIND_GET_VBITS(p, vb, 8));
+
+   madvise(q, SZ, MADV_DONTNEED);
+   printf("madvise: defined: %d\n",
+          VALGRIND_CHECK_MEM_IS_DEFINED(q, SZ - 4096) == 0);
+   printf("madvise: noaccess: %d\n",
+          VALGRIND_GET_VBITS(q + SZ - 4096, vb, 8));
+   printf("madvise: zeroed: %d\n", q[SZ/2 + 5] == 0);
+   return 0;
+}
@@ -0,0 +1,17 @@
+#include <stdlib.h>
+
+/* With --sample-rate, errors found by the malloc replacement functions
+   are still reported, but uninitialised values are not checked. */
+int main ( void )
+{
+   volatile int n = 0;
+   int i;
+   int* u = malloc(sizeof(int));
+   void* p = malloc(177);
+   if (*u == 42)   // Not reported: uninitialised values are not checked
+      n++;
+   free(u);
+   for (i = 0; i < 2; i++)
+     free(p);      // Reported: invalid free
+   return 0;
+}
@@ -0,0 +1,56 @@
+/* realloc copies the V+A bits of the old block with
+   MC_(copy_address_range_state), which installs the secondary map of
+   the old block at the new one when it covers a whole 64 KB chunk of
+   both, and is read-only.  With --share-secmaps=yes, such a secondary
+   can be a shared one with partially defined bytes, whose V bits are
+   kept per address: they must be copied as well, otherwise reading
+   the new block asserts in get_sec_vbits8. */
+#include <malloc.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK     65536
+#define N_CHUNKS  1100   // More than SHARE_SECMAPS_MIN
+#define PARTDEF   100    // Offset of the partially defined byte
+
+int main(void)
+{
+   static char* chunk[N_CHUNKS];
+   char* undef = malloc(1);
+   char* p = NULL;
+   int   i;
+   volatile int n = 0;
+
+   /* Chunks with identical contents: all defined, except for the
+      high nibble of one byte. */
+   for (i = 0; i < N_CHUNKS; i++) {
+      chunk[i] = memalign(CHUNK, CHUNK);
+      memset(chunk[i], 0, CHUNK);
+      chunk[i][PARTDEF] = (undef[0] & 0xf0) | 1;
+   }
+
+   /* Let Memcheck share their secondaries. */
+   sched_yield();
+
+   /* Move them until one lands at the same offset in its 64 KB chunk,
+      the realloc'ed blocks being page aligned (--alignment=4096). */
+   for (i = 0; i < N_CHUNKS; i++) {
+      p = realloc(chunk[i], CHUNK + 4096);
+      if (((uintptr_t)p & (CHUNK - 1)) == 0)
+         break;
+   }
+   if (i == N_CHUNKS) {
+      fprintf(stderr, "no realloc'ed block is 64 KB aligned\n");
+      return 1;
+   }
+
+   if (p[PARTDEF] & 1)
+      fprintf(stderr, "low bit is set\n");
+   if (p[PARTDEF] & 0x10)   // Error: uninitialised
+      n++;
+
+   return 0;
+}
@@ -0,0 +1,88 @@
+/* Many 64 KB chunks with a few different mixes of defined, undefined
+   and partially defined bytes, so that --share-secmaps=yes replaces
+   their secondary maps by distinguished or shared ones.  Writing to
+   some of them afterwards must not change the others, and errors must
+   be the same as with --share-secmaps=no. */
+#include <malloc.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include "../memcheck.h"
+
+#define CHUNK     65536
+#define N_CHUNKS  1100   // More than SHARE_SECMAPS_MIN
+#define N_CHECKED 8192   // Bytes whose V bits are checked in each chunk
+
+static char* chunk[N_CHUNKS];
+static unsigned char pattern_vbits[4][CHUNK];
+static unsigned char vbits[N_CHECKED];
+
+/* The V bits set at offset off of the chunks using pattern pat. */
+static unsigned char pattern ( int pat, int off )
+{
+   switch (pat) {
+   case 1:  return off == 1000 ? 0xff : 0;
+   case 2:  return off == 2000 ? 0x0f : off == 2001 ? 0xf0 : 0;
+   case 3:  return off >= 4096 ? 0xff : 0;
+   default: return 0;
+   }
+}
+
+/* The V bits chunk i should have at offset off, once the bytes of
+   chunks 1 and 2 which were not defined have been written. */
+static unsigned char expected ( int i, int off )
+{
+   if (i == 1 || i == 2)
+      return 0;
+   return pattern(i % 4, off);
+}
+
+int main ( void )
+{
+   volatile int n = 0;
+   int i, off, n_wrong = 0;
+
+   for (i = 0; i < 4; i++)
+      for (off = 0; off < CHUNK; off++)
+         pattern_vbits[i][off] = pattern(i, off);
+
+   for (i = 0; i < N_CHUNKS; i++) {
+      chunk[i] = memalign(CHUNK, CHUNK);
+      memset(chunk[i], 0, CHUNK);
+      (void)VALGRIND_SET_VBITS(chunk[i], pattern_vbits[i % 4], CHUNK);
+   }
+
+   /* Let Memcheck share their secondaries. */
+   sched_yield();
+
+   /* Chunks 1 and 2 get their own copies again. */
+   chunk[1][1000] = 7;
+   chunk[2][2000] = 0x33;
+   chunk[2][2001] = 0x33;
+
+   for (i = 0; i < N_CHUNKS; i++) {
+      (void)VALGRIND_GET_VBITS(chunk[i], vbits, N_CHECKED);
+      for (off = 0; off < N_CHECKED; off++) {
+         if (vbits[off] != expected(i, off)) {
+            n_wrong++;
+            break;
+         }
+      }
+   }
+   fprintf(stderr, "chunks with wrong V bits: %d\n", n_wrong);
+
+   if (chunk[5][1000] == 1)     // Error: undefined
+      n++;
+   if (chunk[1][1000] == 1)
+      n++;
+   if (chunk[6][2000] & 0x0f)   // Error: undefined low bits
+      n++;
+   if (chunk[6][2000] & 0xf0)
+      n++;
+   if (chunk[2][2000] & 0x0f)
+      n++;
+   if (chunk[7][5000])          // Error: undefined
+      n++;
+
+   return 0;
+}
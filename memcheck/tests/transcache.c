@@ -0,0 +1,19 @@
+#include <stdlib.h>
+
+/* Run twice by transcache.vgtest, the second time with the translations
+   saved by the first run: the error must still be reported. */
+
+static int is_answer(const int* p)
+{
+   if (*p == 42)
+      return 1;
+   return 0;
+}
+
+int main(void)
+{
+   int* p = malloc(sizeof(*p));
+   int  r = is_answer(p);
+   free(p);
+   return r;
+}
@@ -63,7 +63,11 @@ static void nl_pre_clo_init(void)
                                  nl_instrument,
                                  nl_fini);
 
-   /* No needs, no core events to track */
+   /* Instrumentation is the identity, so translations can always
+      be reused by later runs. */
+   VG_(needs_cacheable_translations) ();
+
+   /* No other needs, no core events to track */
 }
 
 VG_DETERMINE_INTERFACE_VERSION(nl_pre_clo_init)
@@ -0,0 +1,21 @@
+#include <stdio.h>
+
+/* A loop with a branch which is nearly always taken the same way, so
+   that --hot-trace-threshold makes a trace following it. */
+static unsigned long long loop ( unsigned long long n )
+{
+   unsigned long long i, common = 0, rare = 0;
+   for (i = 0; i < n; i++) {
+      if ((i & 255) == 0)
+         rare += i;
+      else
+         common ^= i * 3;
+   }
+   return common + rare;
+}
+
+int main ( void )
+{
+   printf("%llu\n", loop(20000000));
+   return 0;
+}
@@ -0,0 +1,52 @@
+// A loop of 256-bit integer SIMD operations, for measuring how well
+// the tools cope with AVX2 code.  The kernel mixes multiplies,
+// min/max and 64-bit compares, and stores full 256-bit vectors, so
+// the shadow computations and the wide shadow stores both matter.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <immintrin.h>
+
+#define N_WORDS (1 << 14)   /* 32-bit words per array, 64KB */
+
+static int a[N_WORDS] __attribute__((aligned(32)));
+static int b[N_WORDS] __attribute__((aligned(32)));
+static int c[N_WORDS] __attribute__((aligned(32)));
+
+__attribute__((noinline))
+static void kernel ( void )
+{
+   int i;
+   const __m256i lo = _mm256_set1_epi32(-1000000);
+   const __m256i hi = _mm256_set1_epi32( 1000000);
+   for (i = 0; i < N_WORDS; i += 8) {
+      __m256i x = _mm256_load_si256((__m256i*)&a[i]);
+      __m256i y = _mm256_load_si256((__m256i*)&b[i]);
+      __m256i p = _mm256_mullo_epi32(x, y);
+      __m256i m = _mm256_max_epi32(_mm256_min_epi32(p, hi), lo);
+      __m256i u = _mm256_max_epu32(x, y);
+      __m256i g = _mm256_cmpgt_epi64(m, u);
+      __m256i e = _mm256_cmpeq_epi64(x, y);
+      __m256i r = _mm256_add_epi32(_mm256_xor_si256(m, g),
+                                   _mm256_and_si256(u, e));
+      _mm256_store_si256((__m256i*)&c[i], r);
+      _mm256_store_si256((__m256i*)&a[i], _mm256_add_epi32(x, r));
+   }
+}
+
+int main ( int argc, char** argv )
+{
+   int i, iters = argc > 1 ? atoi(argv[1]) : 1500;
+   unsigned int sum = 0;
+
+   for (i = 0; i < N_WORDS; i++) {
+      a[i] = i * 2654435761u;
+      b[i] = (N_WORDS - i) * 40503u;
+   }
+   for (i = 0; i < iters; i++)
+      kernel();
+   for (i = 0; i < N_WORDS; i++)
+      sum = sum * 31 + c[i];
+   printf("%u\n", sum);
+   return 0;
+}